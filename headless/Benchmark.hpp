@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cpu/CpuRenderer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace raymond::benchmark {
+
+/** @returns value of the first command line argument if there is one, `fallback` otherwise */
+inline long argument(int argc, char **argv, long fallback) {
+    return argc > 1 ? std::atol(argv[1]) : fallback;
+}
+
+/**
+ * Calls `body` once to warm up caches and page in memory, then `runs` more times
+ * @returns shortest of the timed runs in seconds, which is the least noisy estimate on a busy machine
+ */
+template<typename Body>
+double bestTime(int runs, const Body &body) {
+    body();
+    double best = INFINITY;
+    for (int run = 0; run < runs; run++) {
+        const auto startTime = std::chrono::steady_clock::now();
+        body();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+    }
+    return best;
+}
+
+/// Mean time per frame of a renderer, total and per stage (summed over all depths, and per section of the report)
+struct FrameTimes {
+    double total = 0;
+    std::map<std::string, double> stages;
+    std::map<std::string, std::map<std::string, double>> sections;
+    
+    double stage(const std::string &name) const {
+        const auto it = stages.find(name);
+        return it == stages.end() ? 0 : it->second;
+    }
+    
+    /** @returns time of a stage within one section, such as `stage("Depth 1", "ctrace")` */
+    double stage(const std::string &section, const std::string &name) const {
+        const auto it = sections.find(section);
+        if (it == sections.end()) return 0;
+        const auto entry = it->second.find(name);
+        return entry == it->second.end() ? 0 : entry->second;
+    }
+};
+
+/// Renders one frame to warm up caches, then averages the reports of `frameCount` more frames
+inline FrameTimes renderFrames(cpu::Renderer &renderer, int frameCount) {
+    renderer.execute();
+    FrameTimes times;
+    for (int frame = 0; frame < frameCount; frame++) {
+        renderer.execute();
+        const cpu::Report &report = renderer.report();
+        times.total += report.totalTime / frameCount;
+        for (const cpu::Report::Section &section : report.sections) {
+            for (const cpu::Report::Entry &entry : section.entries) {
+                times.stages[entry.name] += entry.time / frameCount;
+                times.sections[section.name][entry.name] += entry.time / frameCount;
+            }
+        }
+    }
+    return times;
+}
+
+/**
+ * Like `renderFrames`, but takes turns between the renderers frame by frame, so that all of them see the same load
+ * of the machine and drifts in clock speed do not favor one of them
+ */
+inline std::vector<FrameTimes> renderFramesInterleaved(const std::vector<cpu::Renderer *> &renderers, int frameCount) {
+    std::vector<FrameTimes> times(renderers.size());
+    for (cpu::Renderer *renderer : renderers) renderer->execute();
+    for (int frame = 0; frame < frameCount; frame++) {
+        for (size_t i = 0; i < renderers.size(); i++) {
+            renderers[i]->execute();
+            const cpu::Report &report = renderers[i]->report();
+            times[i].total += report.totalTime / frameCount;
+            for (const cpu::Report::Section &section : report.sections) {
+                for (const cpu::Report::Entry &entry : section.entries) {
+                    times[i].stages[entry.name] += entry.time / frameCount;
+                    times[i].sections[section.name][entry.name] += entry.time / frameCount;
+                }
+            }
+        }
+    }
+    return times;
+}
+
+}
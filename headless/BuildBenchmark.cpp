@@ -0,0 +1,61 @@
+#include "Benchmark.hpp"
+#include "Scenes.hpp"
+
+#include <bvh/Bvh.hpp>
+
+#include <cstdio>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr int RunCount = 3;
+
+struct Builder {
+    const char *name;
+    bvh::BuildQuality quality;
+};
+
+}
+
+/**
+ * Measures the bottom level builders on the shapes of the synthetic scenes: build time (best of three, on
+ * `ThreadPool::shared()`), time per million triangles and the SAH cost and shape of the resulting trees. The optional
+ * argument is the terrain resolution (default 1024, which gives 2.1M triangles).
+ */
+int main(int argc, char **argv) {
+    const uint32_t resolution = uint32_t(benchmark::argument(argc, argv, 1024));
+    
+    const Builder builders[] = {
+        { "binned SAH", bvh::BuildQuality::High },
+        { "LBVH", bvh::BuildQuality::Fast },
+    };
+    
+    std::vector<benchmark::SyntheticScene> scenes;
+    scenes.push_back(benchmark::terrain(resolution));
+    scenes.push_back(benchmark::sphere(256));
+    
+    std::printf("%-10s %-12s %9s %10s %10s %9s %9s %6s\n",
+                "shape", "builder", "triangles", "build", "per Mtri", "SAH cost", "nodes", "depth");
+    for (const benchmark::SyntheticScene &scene : scenes) {
+        /// only the first shape, the dome that the terrain scene adds is small in comparison
+        const benchmark::SyntheticScene::Shape &shape = scene.shapes[0];
+        const bvh::Mesh mesh {
+            scene.vertices.data() + shape.vertexOffset, scene.indices.data() + shape.faceOffset, shape.faceCount };
+        const double megaTriangles = shape.faceCount / 1e6;
+        
+        for (const Builder &builder : builders) {
+            bvh::BuildSettings settings;
+            settings.quality = builder.quality;
+            bvh::BuildStats stats;
+            const double buildTime = benchmark::bestTime(RunCount, [&]() {
+                bvh::buildBlas(mesh, settings, &stats);
+            });
+            std::printf("%-10s %-12s %9u %7.1f ms %7.1f ms %9.1f %9zu %6u\n",
+                        scene.name.c_str(), builder.name, shape.faceCount, buildTime * 1e3,
+                        buildTime * 1e3 / megaTriangles, stats.sahCost, stats.nodeCount, stats.maxDepth);
+        }
+    }
+    return 0;
+}
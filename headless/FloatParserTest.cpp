@@ -0,0 +1,114 @@
+#include <io/FloatParser.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace raymond;
+
+namespace {
+
+constexpr int RandomCount = 1 << 20;
+
+uint32_t bitsOf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/**
+ * Parses `text` with `parseFloat` and `strtof` and compares the results bit for bit (all NaNs count as equal),
+ * as well as how many characters both of them consumed. The text is copied without a terminator so that reads
+ * past the end would show up under sanitizers.
+ */
+bool check(const std::string &text) {
+    char *expectedEnd;
+    const float expected = std::strtof(text.c_str(), &expectedEnd);
+    const size_t expectedLength = expectedEnd - text.c_str();
+    
+    const std::unique_ptr<char[]> buffer(new char[text.size()]);
+    std::memcpy(buffer.get(), text.data(), text.size());
+    float value = 0;
+    const char *end = parseFloat(buffer.get(), buffer.get() + text.size(), value);
+    const size_t length = end ? end - buffer.get() : 0;
+    
+    const bool sameValue = (std::isnan(value) && std::isnan(expected)) || bitsOf(value) == bitsOf(expected);
+    if (length == expectedLength && (length == 0 || sameValue)) return true;
+    std::printf("FAIL '%s': parsed %.9g (0x%08x, %zu chars), strtof %.9g (0x%08x, %zu chars)\n", text.c_str(),
+                value, bitsOf(value), length, expected, bitsOf(expected), expectedLength);
+    return false;
+}
+
+std::string format(const char *format, float value) {
+    char text[64];
+    std::snprintf(text, sizeof(text), format, double(value));
+    return text;
+}
+
+}
+
+/// Round-trips edge cases and random floats through `parseFloat`, exits with a nonzero status on any mismatch
+int main() {
+    const char *edgeCases[] = {
+        "0", "-0", "+0", "0.0", ".0", "0.", "00000000000000000000000001", "1", "-1", ".25", "6.02e23", "6.02E+23",
+        "1e-3", "1e", "1e+", "1.5e-", "-", "+", ".", "e5", "",
+        /// largest float, the halfway point to the next power of two and just beyond it
+        "3.4028235e38", "3.40282347e+38", "3.40282356779733661637539395458142568448e38",
+        "3.40282356779733661637539395458142568447e38", "3.4028236e38", "1e39", "-1e39", "1e4000",
+        /// smallest normal, largest subnormal, smallest subnormal and halfway below it
+        "1.17549435e-38", "1.17549421e-38", "1.4e-45", "1.401298464e-45", "7.006492321624085e-46",
+        "7.006492321624086e-46", "7e-46", "1e-46", "1e-50", "1e-4000",
+        /// ties between floats, which round to even
+        "16777216", "16777217", "16777218", "16777219", "33554434", "33554435", "33554436",
+        "0.1", "0.2", "0.3", "0.1000000000000000055511151231257827021181583404541015625",
+        "1.00000005960464477539062500000000000000000000001", "1.000000059604644775390625",
+        "0.000000000000000000000000000000000000000000000000000000000000000000000000000001e80",
+        "12345678901234567890123456789e-20", "18446744073709551615", "18446744073709551616",
+        "inf", "-inf", "infinity", "INF", "nan", "-nan", "NaN",
+        "1.5,", "2.5 3.5", "4.5\n", "-7.25e2x",
+    };
+    
+    int failures = 0;
+    int checks = 0;
+    for (const char *text : edgeCases) {
+        failures += !check(text);
+        checks++;
+    }
+    
+    std::mt19937 random(0x5eed);
+    std::uniform_int_distribution<uint32_t> bitPattern;
+    const char *formats[] = { "%.9g", "%.6g", "%.12e", "%.25g", "%f" };
+    for (int i = 0; i < RandomCount; i++) {
+        float value;
+        const uint32_t bits = bitPattern(random);
+        std::memcpy(&value, &bits, sizeof(value));
+        if (!std::isfinite(value)) continue;
+        failures += !check(format(formats[i % 5], value));
+        checks++;
+    }
+    
+    /// random digit strings hit the fast path, the Eisel-Lemire path and the fallback
+    std::uniform_int_distribution<int> digitCount(1, 24);
+    std::uniform_int_distribution<int> digit(0, 9);
+    std::uniform_int_distribution<int> exponent(-60, 45);
+    for (int i = 0; i < RandomCount; i++) {
+        std::string text = i % 2 ? "-" : "";
+        const int digits = digitCount(random);
+        const int point = std::uniform_int_distribution<int>(0, digits)(random);
+        for (int d = 0; d < digits; d++) {
+            if (d == point) text += '.';
+            text += char('0' + digit(random));
+        }
+        if (i % 3) text += "e" + std::to_string(exponent(random));
+        failures += !check(text);
+        checks++;
+    }
+    
+    std::printf("%s %d of %d numbers parsed like strtof\n", failures ? "FAIL" : "pass", checks - failures, checks);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+#include <cpu/CpuRenderer.hpp>
+#include <cpu/SceneBuilder.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr uint32_t ImageSize = 128;
+constexpr int FrameCount = 32;
+
+/// Unit sphere around the origin, with normals for smooth shading
+struct Sphere {
+    std::vector<Vertex> vertices;
+    std::vector<Normal> normals;
+    std::vector<IndexTriplet> indices;
+    std::vector<MaterialIndex> materials;
+    
+    explicit Sphere(int segments) {
+        for (int i = 0; i <= segments; i++) {
+            for (int j = 0; j <= 2 * segments; j++) {
+                const float theta = float(M_PI) * float(i) / float(segments);
+                const float phi = float(M_PI) * float(j) / float(segments);
+                Vertex vertex;
+                vertex.x = std::sin(theta) * std::cos(phi);
+                vertex.y = std::cos(theta);
+                vertex.z = std::sin(theta) * std::sin(phi);
+                vertices.push_back(vertex);
+                
+                Normal normal;
+                normal.x = vertex.x;
+                normal.y = vertex.y;
+                normal.z = vertex.z;
+                normals.push_back(normal);
+            }
+        }
+        
+        const uint32_t stride = uint32_t(2 * segments + 1);
+        for (int i = 0; i < segments; i++) {
+            for (int j = 0; j < 2 * segments; j++) {
+                const uint32_t a = uint32_t(i) * stride + uint32_t(j);
+                const uint32_t b = a + 1;
+                const uint32_t c = a + stride;
+                const uint32_t d = c + 1;
+                IndexTriplet triangle;
+                triangle.x = a; triangle.y = c; triangle.z = b;
+                indices.push_back(triangle);
+                triangle.x = b; triangle.y = c; triangle.z = d;
+                indices.push_back(triangle);
+            }
+        }
+        materials.assign(indices.size(), 0);
+    }
+};
+
+struct Result {
+    /// mean of the red channel over a disk in the center and over the corners of the image
+    double center = 0;
+    double corners = 0;
+};
+
+/**
+ * Renders a diffuse sphere with an albedo of one half under a white environment. Seen from outside, every path
+ * escapes after a single bounce, so the sphere has to converge to one half. Seen from inside with an emission of
+ * one, the radiance is the geometric series `1 + 1/2 + 1/4 + ...` truncated at the maximum depth.
+ */
+Result render(SamplingMode samplingMode, bvh::NodeLayout nodeLayout, cpu::Renderer::ExecutionMode executionMode,
+              bool inside) {
+    Sphere sphere(32);
+    
+    cpu::SceneBuilder::Buffers buffers;
+    buffers.vertices = sphere.vertices.data();
+    buffers.normals = sphere.normals.data();
+    buffers.indices = sphere.indices.data();
+    buffers.materials = sphere.materials.data();
+    
+    DevicePerInstanceData instance = {};
+    instance.pointTransform.columns[0].x = 1;
+    instance.pointTransform.columns[1].y = 1;
+    instance.pointTransform.columns[2].z = 1;
+    instance.pointTransform.columns[3].w = 1;
+    instance.normalTransform.columns[0].x = 1;
+    instance.normalTransform.columns[1].y = 1;
+    instance.normalTransform.columns[2].z = 1;
+    instance.visibility = RayFlags(0xff);
+    
+    cpu::SceneBuilder builder(buffers);
+    builder.addInstance(builder.addShape(0, 0, FaceIndex(sphere.indices.size())), instance);
+    cpu::SceneBuilder::Settings settings;
+    settings.nodeLayout = nodeLayout;
+    builder.build(settings);
+    
+    cpu::MaterialTable materialTable;
+    cpu::Material material;
+    material.diffuse = cpu::Vec3(0.5f);
+    if (inside) material.emission = cpu::Vec3(1);
+    materialTable.materials.push_back(material);
+    materialTable.environment = cpu::Vec3(1);
+    
+    DeviceCamera camera = {};
+    camera.transform.columns[0].x = 1;
+    camera.transform.columns[1].y = 1;
+    camera.transform.columns[2].z = 1;
+    camera.transform.columns[3].z = inside ? 0 : 3;
+    camera.transform.columns[3].w = 1;
+    camera.nearClip = 0;
+    camera.farClip = INFINITY;
+    camera.focalLength = 1.5f;
+    
+    cpu::Renderer renderer(builder.scene(camera, materialTable));
+    renderer.uniforms.samplingMode = samplingMode;
+    renderer.options.executionMode = executionMode;
+    renderer.resize(ImageSize, ImageSize);
+    for (int frame = 0; frame < FrameCount; frame++) {
+        renderer.execute();
+    }
+    
+    Result result;
+    int centerCount = 0, cornerCount = 0;
+    const float half = float(ImageSize) / 2;
+    for (uint32_t y = 0; y < ImageSize; y++) {
+        for (uint32_t x = 0; x < ImageSize; x++) {
+            const float dx = float(x) + 0.5f - half;
+            const float dy = float(y) + 0.5f - half;
+            const float distance = std::sqrt(dx * dx + dy * dy) / half;
+            const float value = renderer.normalizedImage()[y * ImageSize + x].x;
+            if (distance < 0.25f) {
+                result.center += value;
+                centerCount++;
+            } else if (distance > 1.05f) {
+                result.corners += value;
+                cornerCount++;
+            }
+        }
+    }
+    result.center /= centerCount;
+    result.corners /= cornerCount;
+    return result;
+}
+
+bool check(const char *name, double value, double expected, double tolerance) {
+    const bool passed = std::fabs(value - expected) <= tolerance;
+    std::printf("%s %-48s %.4f (expected %.2f)\n", passed ? "pass" : "FAIL", name, value, expected);
+    return passed;
+}
+
+}
+
+/// White furnace test of the CPU renderer, exits with a nonzero status if any configuration does not converge
+int main() {
+    const struct {
+        const char *name;
+        SamplingMode mode;
+        /// next event estimation only finds emission through lights, and the sphere is not one
+        bool hitsEmission;
+    } samplingModes[] = {
+        { "bsdf", SamplingModeBsdf, true },
+        { "nee", SamplingModeNee, false },
+        { "mis", SamplingModeMis, true },
+    };
+    const struct {
+        const char *name;
+        bvh::NodeLayout layout;
+    } nodeLayouts[] = {
+        { "wide", bvh::NodeLayout::Wide },
+        { "compressed", bvh::NodeLayout::Compressed },
+    };
+    const struct {
+        const char *name;
+        cpu::Renderer::ExecutionMode mode;
+    } executionModes[] = {
+        { "wavefront", cpu::Renderer::ExecutionMode::Wavefront },
+        { "megakernel", cpu::Renderer::ExecutionMode::Megakernel },
+    };
+    
+    /// the geometric series up to the default maximum depth
+    double insideExpected = 0;
+    for (int depth = 0; depth < cpu::Renderer::DefaultMaxDepth; depth++) insideExpected += std::pow(0.5, depth);
+    
+    bool passed = true;
+    char name[128];
+    for (const auto &samplingMode : samplingModes) {
+        for (const auto &nodeLayout : nodeLayouts) {
+            for (const auto &executionMode : executionModes) {
+                const Result outside = render(samplingMode.mode, nodeLayout.layout, executionMode.mode, false);
+                std::snprintf(name, sizeof(name), "%s/%s/%s sphere", samplingMode.name, nodeLayout.name,
+                              executionMode.name);
+                passed &= check(name, outside.center, 0.5, 0.02);
+                std::snprintf(name, sizeof(name), "%s/%s/%s environment", samplingMode.name, nodeLayout.name,
+                              executionMode.name);
+                passed &= check(name, outside.corners, 1.0, 1e-3);
+                
+                if (!samplingMode.hitsEmission) continue;
+                const Result inside = render(samplingMode.mode, nodeLayout.layout, executionMode.mode, true);
+                std::snprintf(name, sizeof(name), "%s/%s/%s inside emitter", samplingMode.name, nodeLayout.name,
+                              executionMode.name);
+                passed &= check(name, inside.center, insideExpected, 0.03);
+            }
+        }
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include "Benchmark.hpp"
+#include "Scenes.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr int FrameCount = 4;
+
+/// Everything that both execution modes have to agree on
+struct Result {
+    std::vector<simd_float4> image;
+    std::vector<uint32_t> rayCounts;
+    std::vector<uint32_t> shadowRayCounts;
+    
+    explicit Result(const cpu::Renderer &renderer)
+    : image(renderer.image()), rayCounts(renderer.rayCounts()), shadowRayCounts(renderer.shadowRayCounts()) {}
+    
+    bool operator==(const Result &other) const {
+        return image.size() == other.image.size() &&
+            std::memcmp(image.data(), other.image.data(), image.size() * sizeof(simd_float4)) == 0 &&
+            rayCounts == other.rayCounts && shadowRayCounts == other.shadowRayCounts;
+    }
+};
+
+}
+
+/**
+ * Compares `ExecutionMode::Wavefront` against `ExecutionMode::Megakernel` on the sphere, the room and the terrain at
+ * two resolutions, with the renderers taking turns frame by frame. Also checks that both modes give the same image
+ * and ray counts. The optional argument is the terrain resolution (default 700, which gives 980k triangles).
+ */
+int main(int argc, char **argv) {
+    const uint32_t resolution = uint32_t(benchmark::argument(argc, argv, 700));
+    
+    std::vector<benchmark::SyntheticScene> scenes;
+    scenes.push_back(benchmark::sphere(64));
+    scenes.push_back(benchmark::room());
+    scenes.push_back(benchmark::terrain(resolution));
+    
+    std::printf("%-10s %6s %12s %12s %8s\n", "scene", "size", "wavefront", "megakernel", "speedup");
+    bool passed = true;
+    for (benchmark::SyntheticScene &scene : scenes) {
+        const auto builder = scene.build(cpu::SceneBuilder::Settings());
+        for (uint32_t imageSize : { 256, 512 }) {
+            cpu::Renderer wavefront(scene.scene(*builder));
+            cpu::Renderer megakernel(scene.scene(*builder));
+            megakernel.options.executionMode = cpu::Renderer::ExecutionMode::Megakernel;
+            for (cpu::Renderer *renderer : { &wavefront, &megakernel }) renderer->resize(imageSize, imageSize);
+            
+            const std::vector<benchmark::FrameTimes> times =
+                benchmark::renderFramesInterleaved({ &wavefront, &megakernel }, FrameCount);
+            std::printf("%-10s %6u %9.1f ms %9.1f ms %7.2fx\n", scene.name.c_str(), imageSize,
+                        times[0].total * 1e3, times[1].total * 1e3, times[0].total / times[1].total);
+            passed &= Result(wavefront) == Result(megakernel);
+        }
+    }
+    
+    std::printf("\n%s images and ray counts are identical in both execution modes\n", passed ? "pass" : "FAIL");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include "Benchmark.hpp"
+#include "Scenes.hpp"
+
+extern "C" {
+#include <mesh/optimize.h>
+}
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr uint32_t ImageSize = 512;
+constexpr int FrameCount = 4;
+
+/**
+ * Brings the first shape into the order that `ply_save` of our Blender exporter writes: faces in the arbitrary
+ * order of the bmesh (shuffled here), vertices in the order in which those faces first use them.
+ */
+void applyExporterOrder(benchmark::SyntheticScene &scene) {
+    const benchmark::SyntheticScene::Shape &shape = scene.shapes[0];
+    IndexTriplet *indices = scene.indices.data() + shape.faceOffset;
+    MaterialIndex *materials = scene.materials.data() + shape.faceOffset;
+    
+    std::vector<uint32_t> order(shape.faceCount);
+    for (uint32_t i = 0; i < shape.faceCount; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+    
+    const std::vector<IndexTriplet> oldIndices(indices, indices + shape.faceCount);
+    const std::vector<MaterialIndex> oldMaterials(materials, materials + shape.faceCount);
+    const uint32_t vertexCount = uint32_t(
+        (scene.shapes.size() > 1 ? scene.shapes[1].vertexOffset : scene.vertices.size()) - shape.vertexOffset);
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> inverse;
+    for (uint32_t face = 0; face < shape.faceCount; face++) {
+        IndexTriplet triangle = oldIndices[order[face]];
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t &index = remap[triangle.elements[corner]];
+            if (index == UINT32_MAX) {
+                index = uint32_t(inverse.size());
+                inverse.push_back(triangle.elements[corner]);
+            }
+            triangle.elements[corner] = index;
+        }
+        indices[face] = triangle;
+        materials[face] = oldMaterials[order[face]];
+    }
+    
+    const auto permute = [&](auto *attributes) {
+        using Attribute = std::remove_pointer_t<decltype(attributes)>;
+        const std::vector<Attribute> old(attributes, attributes + inverse.size());
+        for (size_t i = 0; i < inverse.size(); i++) attributes[i] = old[inverse[i]];
+    };
+    permute(scene.vertices.data() + shape.vertexOffset);
+    permute(scene.normals.data() + shape.vertexOffset);
+    permute(scene.texCoords.data() + shape.vertexOffset);
+}
+
+void optimizeFirstShape(benchmark::SyntheticScene &scene) {
+    const benchmark::SyntheticScene::Shape &shape = scene.shapes[0];
+    const uint32_t vertexCount = uint32_t(scene.shapes[1].vertexOffset - shape.vertexOffset);
+    /// every vertex is unique, so welding leaves no slack that would need to be compacted
+    optimize_mesh(
+        scene.vertices.data() + shape.vertexOffset, scene.normals.data() + shape.vertexOffset,
+        scene.texCoords.data() + shape.vertexOffset, vertexCount,
+        scene.indices.data() + shape.faceOffset, scene.materials.data() + shape.faceOffset, shape.faceCount);
+}
+
+}
+
+/**
+ * Measures what `optimize_mesh` buys the shading stage: renders a terrain whose faces and vertices are in the order of
+ * the exporter, and the same terrain after optimization, and compares the time spent in `chit` (which gathers the
+ * vertices of every hit in `buildShadingContext`) and `ctrace`. The optional argument is the terrain resolution
+ * (default 1024, which gives 2.1M triangles).
+ */
+int main(int argc, char **argv) {
+    const uint32_t resolution = uint32_t(benchmark::argument(argc, argv, 1024));
+    
+    std::printf("%-12s %10s %10s %10s\n", "mesh order", "chit", "ctrace", "frame");
+    double shadingTimes[2];
+    for (int optimized = 0; optimized < 2; optimized++) {
+        benchmark::SyntheticScene scene = benchmark::terrain(resolution);
+        applyExporterOrder(scene);
+        if (optimized) optimizeFirstShape(scene);
+        
+        const auto builder = scene.build(cpu::SceneBuilder::Settings());
+        cpu::Renderer renderer(scene.scene(*builder));
+        renderer.resize(ImageSize, ImageSize);
+        const benchmark::FrameTimes times = benchmark::renderFrames(renderer, FrameCount);
+        shadingTimes[optimized] = times.stage("chit");
+        std::printf("%-12s %7.1f ms %7.1f ms %7.1f ms\n", optimized ? "optimized" : "exporter",
+                    times.stage("chit") * 1e3, times.stage("ctrace") * 1e3, times.total * 1e3);
+    }
+    std::printf("\nshading speedup %.2fx\n", shadingTimes[0] / shadingTimes[1]);
+    return 0;
+}
@@ -0,0 +1,251 @@
+#include <cpu/CpuRenderer.hpp>
+#include <cpu/SceneBuilder.hpp>
+#include <io/rmesh/RMesh.hpp>
+
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr uint32_t ImageSize = 128;
+constexpr int FrameCount = 4;
+/// far less than the meshes below, so that pages are evicted and loaded again while rendering
+constexpr size_t MemoryBudget = 256 << 10;
+
+/// Contents of one mesh cache, material indices are those of the cache and resolved through the palette of the shape
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<Normal> normals;
+    std::vector<TexCoord> texCoords;
+    std::vector<IndexTriplet> indices;
+    std::vector<MaterialIndex> materials;
+    MaterialIndex cachedMaterial = 0;
+    
+    void addVertex(float x, float y, float z, float nx, float ny, float nz) {
+        Vertex vertex;
+        vertex.x = x; vertex.y = y; vertex.z = z;
+        vertices.push_back(vertex);
+        Normal normal;
+        normal.x = nx; normal.y = ny; normal.z = nz;
+        normals.push_back(normal);
+        TexCoord texCoord;
+        texCoord.x = x; texCoord.y = z;
+        texCoords.push_back(texCoord);
+    }
+    
+    /// Triangulates a grid of `(columns + 1) * (rows + 1)` vertices that starts at `base`
+    void addGrid(uint32_t base, uint32_t columns, uint32_t rows) {
+        const uint32_t stride = columns + 1;
+        for (uint32_t row = 0; row < rows; row++) {
+            for (uint32_t column = 0; column < columns; column++) {
+                const uint32_t a = base + row * stride + column;
+                IndexTriplet triangle;
+                triangle.x = a; triangle.y = a + stride; triangle.z = a + 1;
+                indices.push_back(triangle);
+                triangle.x = a + 1; triangle.y = a + stride; triangle.z = a + stride + 1;
+                indices.push_back(triangle);
+            }
+        }
+        materials.assign(indices.size(), cachedMaterial);
+    }
+};
+
+/// Rolling hills around the origin, facing up
+Mesh terrain(uint32_t resolution) {
+    Mesh mesh;
+    for (uint32_t row = 0; row <= resolution; row++) {
+        for (uint32_t column = 0; column <= resolution; column++) {
+            const float x = 8 * float(column) / float(resolution) - 4;
+            const float z = 8 * float(row) / float(resolution) - 4;
+            mesh.addVertex(x, 0.2f * std::sin(3 * x) * std::cos(2 * z) - 1, z, 0, 1, 0);
+        }
+    }
+    mesh.addGrid(0, resolution, resolution);
+    return mesh;
+}
+
+/// Unit sphere resting on the terrain, stored with a different material index than the scene assigns to it
+Mesh sphere(uint32_t segments) {
+    Mesh mesh;
+    mesh.cachedMaterial = 7;
+    for (uint32_t i = 0; i <= segments; i++) {
+        for (uint32_t j = 0; j <= 2 * segments; j++) {
+            const float theta = float(M_PI) * float(i) / float(segments);
+            const float phi = float(M_PI) * float(j) / float(segments);
+            const float x = std::sin(theta) * std::cos(phi);
+            const float y = std::cos(theta);
+            const float z = std::sin(theta) * std::sin(phi);
+            mesh.addVertex(x, y - 0.5f, z, x, y, z);
+        }
+    }
+    mesh.addGrid(0, 2 * segments, segments);
+    return mesh;
+}
+
+bool writeCache(const Mesh &mesh, const std::string &sourcePath, const std::string &cachePath) {
+    /// the cache records the size, modification time and hash of its source, which therefore needs to exist
+    FILE *source = std::fopen(sourcePath.c_str(), "w");
+    if (!source) return false;
+    std::fputs(sourcePath.c_str(), source);
+    std::fclose(source);
+    
+    rmesh::MeshView view;
+    view.vertices = mesh.vertices.data();
+    view.normals = mesh.normals.data();
+    view.texCoords = mesh.texCoords.data();
+    view.vertexCount = mesh.vertices.size();
+    view.indices = mesh.indices.data();
+    view.materials = mesh.materials.data();
+    view.faceCount = mesh.indices.size();
+    view.palette = &mesh.cachedMaterial;
+    view.paletteSize = 1;
+    for (int axis = 0; axis < 3; axis++) {
+        view.boundsMin[axis] = -4;
+        view.boundsMax[axis] = 4;
+    }
+    return rmesh::write(cachePath, sourcePath, view);
+}
+
+}
+
+/**
+ * Renders a scene from resident buffers and once more paged in from its mesh caches with a budget that is far smaller
+ * than the meshes, and checks that both images are identical. Exits with a nonzero status otherwise.
+ */
+int main() {
+    char directory[] = "/tmp/raymond-paged-XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::printf("FAIL could not create a temporary directory\n");
+        return 1;
+    }
+    
+    const Mesh meshes[] = { terrain(256), sphere(64) };
+    /// scene material of every mesh, which the palettes map the cached material indices to
+    const MaterialIndex sceneMaterials[] = { 0, 1 };
+    std::string sourcePaths[2];
+    bool passed = true;
+    for (int i = 0; i < 2; i++) {
+        sourcePaths[i] = std::string(directory) + "/mesh" + std::to_string(i) + ".ply";
+        passed &= writeCache(meshes[i], sourcePaths[i], rmesh::cachePath(sourcePaths[i]));
+    }
+    if (!passed) std::printf("FAIL could not write the mesh caches to %s\n", directory);
+    
+    /// the buffers of the resident scene, with materials as `ShapeBuilder` resolves them
+    std::vector<Vertex> vertices;
+    std::vector<Normal> normals;
+    std::vector<TexCoord> texCoords;
+    std::vector<IndexTriplet> indices;
+    std::vector<MaterialIndex> materials;
+    std::vector<DevicePerInstanceData> instances;
+    for (int i = 0; i < 2; i++) {
+        DevicePerInstanceData instance = {};
+        instance.vertexOffset = VertexIndex(vertices.size());
+        instance.faceOffset = FaceIndex(indices.size());
+        instance.pointTransform.columns[0].x = 1;
+        instance.pointTransform.columns[1].y = 1;
+        instance.pointTransform.columns[2].z = 1;
+        instance.pointTransform.columns[3].w = 1;
+        instance.normalTransform.columns[0].x = 1;
+        instance.normalTransform.columns[1].y = 1;
+        instance.normalTransform.columns[2].z = 1;
+        instance.visibility = RayFlags(0xff);
+        instances.push_back(instance);
+        
+        const Mesh &mesh = meshes[i];
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        normals.insert(normals.end(), mesh.normals.begin(), mesh.normals.end());
+        texCoords.insert(texCoords.end(), mesh.texCoords.begin(), mesh.texCoords.end());
+        indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+        materials.insert(materials.end(), mesh.indices.size(), sceneMaterials[i]);
+    }
+    const auto pages = [](size_t count) {
+        return (count + PagedGeometry::PageElements - 1) / PagedGeometry::PageElements;
+    };
+    /// three vertex streams and two face streams
+    const size_t pageCount = 3 * pages(vertices.size()) + 2 * pages(indices.size());
+    
+    cpu::MaterialTable materialTable;
+    cpu::Material ground;
+    ground.diffuse = cpu::Vec3(0.8f);
+    cpu::Material ball;
+    ball.diffuse = cpu::Vec3(0.3f);
+    materialTable.materials = { ground, ball };
+    materialTable.environment = cpu::Vec3(1);
+    
+    DeviceCamera camera = {};
+    const float tilt = 0.5f;
+    camera.transform.columns[0].x = 1;
+    camera.transform.columns[1].y = std::cos(tilt);
+    camera.transform.columns[1].z = -std::sin(tilt);
+    camera.transform.columns[2].y = std::sin(tilt);
+    camera.transform.columns[2].z = std::cos(tilt);
+    camera.transform.columns[3].y = 2;
+    camera.transform.columns[3].z = 5;
+    camera.transform.columns[3].w = 1;
+    camera.nearClip = 0;
+    camera.farClip = INFINITY;
+    camera.focalLength = 1.5f;
+    
+    std::vector<simd_float4> images[2];
+    for (int paged = 0; paged < 2 && passed; paged++) {
+        cpu::SceneBuilder::Buffers buffers;
+        if (!paged) {
+            buffers.vertices = vertices.data();
+            buffers.normals = normals.data();
+            buffers.texCoords = texCoords.data();
+            buffers.indices = indices.data();
+            buffers.materials = materials.data();
+        }
+        
+        cpu::SceneBuilder builder(buffers);
+        for (int i = 0; i < 2; i++) {
+            const uint32_t shape = builder.addShape(
+                instances[i].vertexOffset, instances[i].faceOffset, FaceIndex(meshes[i].indices.size()));
+            builder.setMeshCache(shape, rmesh::cachePath(sourcePaths[i]), &sceneMaterials[i], 1);
+            builder.addInstance(shape, instances[i]);
+        }
+        cpu::SceneBuilder::Settings settings;
+        settings.memoryBudget = paged ? MemoryBudget : 0;
+        if (!builder.build(settings)) {
+            std::printf("FAIL could not page in the mesh caches\n");
+            passed = false;
+            break;
+        }
+        
+        cpu::Renderer renderer(builder.scene(camera, materialTable));
+        renderer.resize(ImageSize, ImageSize);
+        for (int frame = 0; frame < FrameCount; frame++) {
+            renderer.execute();
+        }
+        images[paged] = renderer.normalizedImage();
+        
+        if (const PagedGeometry *geometry = builder.geometry()) {
+            /// every page is needed at least once, so more faults than pages means that pages were evicted
+            const bool evicted = geometry->pageFaults() > pageCount;
+            std::printf("%s paged geometry evicts pages (%zu faults for %zu pages)\n", evicted ? "pass" : "FAIL",
+                        geometry->pageFaults(), pageCount);
+            passed &= evicted;
+        }
+    }
+    
+    if (passed) {
+        const bool identical = std::memcmp(
+            images[0].data(), images[1].data(), images[0].size() * sizeof(simd_float4)) == 0;
+        std::printf("%s paged image matches resident image\n", identical ? "pass" : "FAIL");
+        passed &= identical;
+    }
+    
+    for (const std::string &sourcePath : sourcePaths) {
+        unlink(rmesh::cachePath(sourcePath).c_str());
+        unlink(sourcePath.c_str());
+    }
+    rmdir(directory);
+    return passed ? 0 : 1;
+}
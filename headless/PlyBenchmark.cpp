@@ -0,0 +1,280 @@
+#include "Benchmark.hpp"
+
+#include <io/MappedFile.hpp>
+#include <io/ply/PlyAscii.hpp>
+#include <io/ply/PlyHeader.hpp>
+#include <utils/ThreadPool.hpp>
+
+#include <unistd.h>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr int RunCount = 3;
+
+/**
+ * Writes a height field of `resolution * resolution` quads in the layout of our Blender exporter:
+ * `x y z nx ny nz s t` vertices and triangles with a material index.
+ */
+bool writeAsciiPly(const std::string &path, uint32_t resolution) {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file) return false;
+    
+    const uint32_t stride = resolution + 1;
+    std::fprintf(file,
+        "ply\nformat ascii 1.0\ncomment written by PlyBenchmark\n"
+        "element vertex %u\n"
+        "property float x\nproperty float y\nproperty float z\n"
+        "property float nx\nproperty float ny\nproperty float nz\n"
+        "property float s\nproperty float t\n"
+        "element face %u\n"
+        "property list uchar uint vertex_indices\nproperty uchar material_index\n"
+        "end_header\n", stride * stride, 2 * resolution * resolution);
+    
+    for (uint32_t row = 0; row <= resolution; row++) {
+        for (uint32_t column = 0; column <= resolution; column++) {
+            const float s = float(column) / float(resolution);
+            const float t = float(row) / float(resolution);
+            const float x = 8 * s - 4;
+            const float z = 8 * t - 4;
+            const float y = 0.2f * std::sin(3 * x) * std::cos(2 * z);
+            const float slope = 0.6f * std::cos(3 * x) * std::cos(2 * z);
+            const float length = std::sqrt(1 + slope * slope);
+            std::fprintf(file, "%.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f\n",
+                         x, y, z, -slope / length, 1 / length, 0.0f, s, t);
+        }
+    }
+    
+    for (uint32_t row = 0; row < resolution; row++) {
+        for (uint32_t column = 0; column < resolution; column++) {
+            const uint32_t a = row * stride + column;
+            const unsigned int material = (row / 16 + column / 16) % 4;
+            std::fprintf(file, "3 %u %u %u %u\n", a, a + stride, a + 1, material);
+            std::fprintf(file, "3 %u %u %u %u\n", a + 1, a + stride, a + stride + 1, material);
+        }
+    }
+    
+    const bool written = !std::ferror(file);
+    return std::fclose(file) == 0 && written;
+}
+
+/// Output buffers for one shape, like `ShapeBuilder.build` hands them to `PLYReader`
+struct Buffers {
+    std::vector<Vertex> vertices;
+    std::vector<Normal> normals;
+    std::vector<TexCoord> texCoords;
+    std::vector<IndexTriplet> indices;
+    std::vector<MaterialIndex> materials;
+    ply::Bounds bounds;
+    
+    Buffers(size_t vertexCount, size_t faceCount)
+    : vertices(vertexCount), normals(vertexCount), texCoords(vertexCount), indices(faceCount), materials(faceCount) {}
+};
+
+/// Number parser of the reader that `readAsciiVertices` replaced, kept here as the baseline
+float strtofBaseline(char *head, char **endPtr) {
+    while (*head == ' ') ++head;
+    
+    const bool isNegative = *head == '-';
+    if (isNegative) head++;
+    
+    long decimal = 0;
+    int baseExp = 0;
+    bool hasSeenPoint = false;
+    
+    while (true) {
+        const char chr = *(head++);
+        if (chr >= '0' && chr <= '9') {
+            decimal *= 10;
+            decimal += chr - '0';
+            baseExp -= hasSeenPoint ? 1 : 0;
+        } else if (chr == '.') {
+            hasSeenPoint = true;
+        } else {
+            break;
+        }
+    }
+    
+    *endPtr = head - 1;
+    if (isNegative) decimal *= -1;
+    return float(decimal) * std::pow(10.0f, float(baseExp));
+}
+
+/**
+ * Element loops of the reader that `readAsciiVertices` and `readAsciiFaces` replaced: a single thread walks the
+ * file through a 16 KB `fread` window and seeks back whenever the window runs low.
+ * Only handles the exporter layout, and only numbers without exponents.
+ */
+struct BaselineReader {
+    FILE *file;
+    
+    void readVertices(size_t count, Buffers &buffers) {
+        char buffer[16384];
+        long n = sizeof(buffer);
+        char *threshold = buffer + sizeof(buffer) - 256;
+        char *head = buffer + n;
+        
+        for (size_t i = 0; i < count; ++i) {
+            if (head >= threshold) {
+                std::fseek(file, (head - buffer) - n, SEEK_CUR);
+                n = long(std::fread(buffer, 1, sizeof(buffer), file));
+                head = buffer;
+            }
+            
+            Vertex &vertex = buffers.vertices[i];
+            for (int j = 0; j < 3; ++j) vertex.elements[j] = strtofBaseline(head, &head);
+            buffers.bounds.extend(vertex);
+            for (int j = 0; j < 3; ++j) buffers.normals[i].elements[j] = strtofBaseline(head, &head);
+            buffers.texCoords[i].x = strtofBaseline(head, &head);
+            buffers.texCoords[i].y = strtofBaseline(head, &head);
+            
+            assert(*head == '\n');
+            head++;
+        }
+        
+        std::fseek(file, (head - buffer) - n, SEEK_CUR);
+    }
+    
+    void readFaces(size_t count, Buffers &buffers, const MaterialIndex *palette) {
+        char buffer[16384];
+        long n = sizeof(buffer);
+        char *threshold = buffer + sizeof(buffer) - 256;
+        char *head = buffer + n;
+        
+        for (size_t i = 0; i < count; ++i) {
+            if (head >= threshold) {
+                std::fseek(file, (head - buffer) - n, SEEK_CUR);
+                n = long(std::fread(buffer, 1, sizeof(buffer), file));
+                head = buffer;
+            }
+            
+            const int indexCount = int(std::strtol(head, &head, 10));
+            assert(indexCount == 3);
+            (void)indexCount;
+            
+            for (int j = 0; j < 3; ++j) buffers.indices[i].elements[j] = uint32_t(std::strtol(head, &head, 10));
+            buffers.materials[i] = palette[std::strtol(head, &head, 10)];
+        }
+        
+        std::fseek(file, (head - buffer) - n, SEEK_CUR);
+    }
+};
+
+/** @returns the largest difference between the positions of both buffers relative to the extent of the mesh */
+float positionError(const Buffers &a, const Buffers &b) {
+    float error = 0;
+    for (size_t i = 0; i < a.vertices.size(); i++) {
+        for (int dim = 0; dim < 3; dim++) {
+            error = std::max(error, std::fabs(a.vertices[i].elements[dim] - b.vertices[i].elements[dim]));
+        }
+    }
+    return error / 8;
+}
+
+bool sameFaces(const Buffers &a, const Buffers &b) {
+    return std::memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(IndexTriplet)) == 0 &&
+        std::memcmp(a.materials.data(), b.materials.data(), a.materials.size() * sizeof(MaterialIndex)) == 0;
+}
+
+}
+
+/**
+ * Measures the throughput of the ASCII PLY element decoders on a generated height field, in MB/s of the vertex and
+ * face sections. The chunked decoders run on a pool of one thread and on `ThreadPool::shared()`, and are compared
+ * against the serial `fread` loop they replaced. The optional argument is the grid resolution (default 1024).
+ */
+int main(int argc, char **argv) {
+    const uint32_t resolution = uint32_t(benchmark::argument(argc, argv, 1024));
+    
+    char path[] = "/tmp/raymond-ply-XXXXXX";
+    const int descriptor = mkstemp(path);
+    if (descriptor < 0) {
+        std::printf("could not create a temporary file\n");
+        return 1;
+    }
+    close(descriptor);
+    
+    ply::Header header;
+    MappedFile mapping;
+    if (!writeAsciiPly(path, resolution) || !mapping.open(path) ||
+        !ply::parseHeader(mapping.data(), mapping.end(), header)) {
+        std::printf("could not write %s\n", path);
+        unlink(path);
+        return 1;
+    }
+    
+    const ply::Element &vertexElement = header.elements[header.find("vertex")];
+    const ply::Element &faceElement = header.elements[header.find("face")];
+    ply::VertexLayout vertexLayout;
+    ply::FaceLayout faceLayout;
+    ply::resolveVertexLayout(vertexElement, vertexLayout);
+    ply::resolveFaceLayout(faceElement, faceLayout);
+    
+    const MaterialIndex palette[] = { 3, 2, 1, 0 };
+    const char *vertexData = mapping.data() + header.dataOffset;
+    const char *faceData = ply::skipAsciiElement(vertexData, mapping.end(), vertexElement);
+    const double vertexMegabytes = double(faceData - vertexData) / (1 << 20);
+    const double faceMegabytes = double(mapping.end() - faceData) / (1 << 20);
+    std::printf("%zu vertices (%.1f MB), %zu faces (%.1f MB)\n\n",
+                vertexElement.count, vertexMegabytes, faceElement.count, faceMegabytes);
+    std::printf("%-24s %10s %10s %10s %10s\n", "reader", "vertices", "MB/s", "faces", "MB/s");
+    
+    const auto print = [&](const char *name, double vertexTime, double faceTime) {
+        std::printf("%-24s %7.1f ms %10.1f %7.1f ms %10.1f\n", name, vertexTime * 1e3, vertexMegabytes / vertexTime,
+                    faceTime * 1e3, faceMegabytes / faceTime);
+    };
+    
+    Buffers baseline(vertexElement.count, faceElement.count);
+    {
+        FILE *file = std::fopen(path, "r");
+        BaselineReader reader { file };
+        const double vertexTime = benchmark::bestTime(RunCount, [&]() {
+            std::fseek(file, long(header.dataOffset), SEEK_SET);
+            reader.readVertices(vertexElement.count, baseline);
+        });
+        const double faceTime = benchmark::bestTime(RunCount, [&]() {
+            std::fseek(file, long(faceData - mapping.data()), SEEK_SET);
+            reader.readFaces(faceElement.count, baseline, palette);
+        });
+        std::fclose(file);
+        print("fread window, serial", vertexTime, faceTime);
+    }
+    
+    bool passed = true;
+    ThreadPool serialPool(1);
+    ThreadPool *pools[] = { &serialPool, &ThreadPool::shared() };
+    for (ThreadPool *pool : pools) {
+        Buffers buffers(vertexElement.count, faceElement.count);
+        const double vertexTime = benchmark::bestTime(RunCount, [&]() {
+            ply::VertexOutput output {
+                buffers.vertices.data(), buffers.normals.data(), buffers.texCoords.data(), ply::Bounds() };
+            passed &= ply::readAsciiVertices(
+                vertexData, mapping.end(), vertexElement, vertexLayout, output, *pool) == faceData;
+        });
+        const double faceTime = benchmark::bestTime(RunCount, [&]() {
+            ply::FaceOutput output { buffers.indices.data(), buffers.materials.data(), palette, 4, vertexElement.count };
+            passed &= ply::readAsciiFaces(
+                faceData, mapping.end(), faceElement, faceLayout, output, *pool) == mapping.end();
+        });
+        
+        const std::string name = "chunked, " + std::to_string(pool->concurrency()) + " thread" +
+            (pool->concurrency() > 1 ? "s" : "");
+        print(name.c_str(), vertexTime, faceTime);
+        
+        /// the baseline rounds its decimal mantissa once more, so positions only agree approximately
+        passed &= positionError(baseline, buffers) < 1e-6f && sameFaces(baseline, buffers);
+    }
+    
+    mapping.close();
+    unlink(path);
+    if (!passed) std::printf("FAIL decoded elements differ from the baseline\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#include "Benchmark.hpp"
+#include "Scenes.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr uint32_t ImageSize = 512;
+constexpr int FrameCount = 8;
+
+}
+
+/**
+ * Ablation of `Options::reorderRays` per depth: renders the terrain with and without reordering and compares the
+ * `ctrace` stage of every depth against the `reorder` stage plus `ctrace` with reordering. Also checks that reordering
+ * leaves the image unchanged. The two renderers take turns frame by frame, the differences are small enough that
+ * measuring them one after the other mostly measures drift of the machine. The optional argument is the terrain
+ * resolution (default 700, which gives 980k triangles).
+ */
+int main(int argc, char **argv) {
+    const uint32_t resolution = uint32_t(benchmark::argument(argc, argv, 700));
+    benchmark::SyntheticScene scene = benchmark::terrain(resolution);
+    const auto builder = scene.build(cpu::SceneBuilder::Settings());
+    
+    cpu::Renderer plain(scene.scene(*builder));
+    cpu::Renderer reordered(scene.scene(*builder));
+    reordered.options.reorderRays = true;
+    for (cpu::Renderer *renderer : { &plain, &reordered }) renderer->resize(ImageSize, ImageSize);
+    const std::vector<benchmark::FrameTimes> times =
+        benchmark::renderFramesInterleaved({ &plain, &reordered }, FrameCount);
+    const std::vector<simd_float4> images[2] = { plain.image(), reordered.image() };
+    const int maxDepth = plain.maxDepth();
+    
+    /// camera rays are traced in tile order by `generateRays` and never reordered
+    std::printf("%-6s %12s %24s %8s\n", "depth", "ctrace off", "reorder + ctrace on", "change");
+    for (int depth = 1; depth < maxDepth; depth++) {
+        const std::string section = "Depth " + std::to_string(depth);
+        const double off = times[0].stage(section, "ctrace");
+        const double reorder = times[1].stage(section, "reorder");
+        const double on = times[1].stage(section, "ctrace");
+        std::printf("%-6d %9.1f ms %9.1f + %9.1f ms %7.1f%%\n",
+                    depth, off * 1e3, reorder * 1e3, on * 1e3, 100 * ((reorder + on) / off - 1));
+    }
+    std::printf("%-6s %9.1f ms %21.1f ms %7.1f%%\n",
+                "frame", times[0].total * 1e3, times[1].total * 1e3, 100 * (times[1].total / times[0].total - 1));
+    
+    const bool identical =
+        std::memcmp(images[0].data(), images[1].data(), images[0].size() * sizeof(simd_float4)) == 0;
+    std::printf("\n%s images are identical with and without reordering\n", identical ? "pass" : "FAIL");
+    return identical ? 0 : 1;
+}
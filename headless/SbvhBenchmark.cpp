@@ -0,0 +1,106 @@
+#include "Benchmark.hpp"
+#include "Scenes.hpp"
+
+#include <bvh/Traversal.hpp>
+#include <bvh/WideBvh.hpp>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr size_t RayCount = 1 << 17;
+constexpr int RunCount = 3;
+
+/// Steps that traversal took, summed over all rays
+struct Counters {
+    size_t leaves = 0;
+    size_t triangles = 0;
+};
+
+/// Nearest hit query through `bvh::traverse` like `intersectBlas`, but counting the leaves and triangles it visits
+template<bool Count>
+bvh::Hit trace(const bvh::WideBvh &bvh, const bvh::Mesh &mesh, const bvh::Ray &ray, Counters &counters) {
+    const bvh::TraversalRay traversalRay(ray);
+    bvh::Hit hit;
+    hit.distance = ray.maxDistance;
+    bvh::traverse<false>(bvh, traversalRay, hit, [&](uint32_t first, uint32_t count) {
+        if (Count) {
+            counters.leaves++;
+            counters.triangles += count;
+        }
+        bool found = false;
+        for (uint32_t offset = 0; offset < count; offset += bvh::WideArity) {
+            bvh::TriangleBatch batch;
+            bvh::gatherTriangles(bvh, mesh, first + offset, std::min<uint32_t>(bvh::WideArity, count - offset), batch);
+            found |= bvh::intersectTriangles(traversalRay, batch, hit) >= 0;
+        }
+        return found;
+    });
+    return hit;
+}
+
+}
+
+/**
+ * Measures what spatial splits buy on the beams scene: builds the shape with binned SAH and with SBVH, then traces
+ * random rays through both on the calling thread and compares the leaves and triangles visited per ray, the trace
+ * speed and the references added. The optional argument is the number of beams (default 20000).
+ */
+int main(int argc, char **argv) {
+    const uint32_t beamCount = uint32_t(benchmark::argument(argc, argv, 20000));
+    const benchmark::SyntheticScene scene = benchmark::beams(beamCount);
+    const bvh::Mesh mesh { scene.vertices.data(), scene.indices.data(), FaceIndex(scene.indices.size()) };
+    
+    /// rays from all over the volume of the beams, in random directions
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform;
+    std::vector<bvh::Ray> rays(RayCount);
+    for (bvh::Ray &ray : rays) {
+        ray.origin = bvh::Vec3(120 * uniform(random) - 10, 60 * uniform(random) + 1, 120 * uniform(random) - 10);
+        ray.direction = bvh::Vec3(uniform(random) - 0.5f, uniform(random) - 0.5f, uniform(random) - 0.5f);
+        ray.minDistance = 0;
+        ray.maxDistance = INFINITY;
+    }
+    
+    const struct {
+        const char *name;
+        bvh::BuildQuality quality;
+    } builders[] = {
+        { "binned SAH", bvh::BuildQuality::High },
+        { "SBVH", bvh::BuildQuality::Spatial },
+    };
+    
+    std::printf("%u triangles, %zu rays\n\n", mesh.faceCount, rays.size());
+    std::printf("%-12s %9s %10s %9s %10s %10s %9s\n",
+                "builder", "build", "references", "SAH cost", "leaves/ray", "tris/ray", "Mrays/s");
+    std::vector<bvh::Hit> hits[2];
+    for (int i = 0; i < 2; i++) {
+        bvh::BuildSettings settings;
+        settings.quality = builders[i].quality;
+        bvh::BuildStats stats;
+        const bvh::Bvh binary = bvh::buildBlas(mesh, settings, &stats);
+        const bvh::WideBvh wide = bvh::collapse(binary);
+        
+        Counters counters;
+        for (const bvh::Ray &ray : rays) hits[i].push_back(trace<true>(wide, mesh, ray, counters));
+        const double traceTime = benchmark::bestTime(RunCount, [&]() {
+            for (const bvh::Ray &ray : rays) trace<false>(wide, mesh, ray, counters);
+        });
+        
+        std::printf("%-12s %6.0f ms %10zu %9.1f %10.1f %10.1f %9.3f\n", builders[i].name, stats.buildTime * 1e3,
+                    binary.primitives.size(), stats.sahCost, double(counters.leaves) / rays.size(),
+                    double(counters.triangles) / rays.size(), rays.size() / traceTime / 1e6);
+    }
+    
+    size_t mismatches = 0;
+    for (size_t i = 0; i < rays.size(); i++) {
+        mismatches += hits[0][i].primitive != hits[1][i].primitive || hits[0][i].distance != hits[1][i].distance;
+    }
+    std::printf("\n%s %zu of %zu rays hit the same triangle at the same distance\n", mismatches ? "FAIL" : "pass",
+                rays.size() - mismatches, rays.size());
+    return mismatches ? 1 : 0;
+}
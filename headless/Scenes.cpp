@@ -0,0 +1,231 @@
+#include "Scenes.hpp"
+
+#include <cmath>
+#include <random>
+
+namespace raymond::benchmark {
+
+void SyntheticScene::beginShape() {
+    shapes.push_back({ VertexIndex(vertices.size()), FaceIndex(indices.size()), 0 });
+}
+
+void SyntheticScene::addVertex(float x, float y, float z, float nx, float ny, float nz, float s, float t) {
+    Vertex vertex;
+    vertex.x = x; vertex.y = y; vertex.z = z;
+    vertices.push_back(vertex);
+    Normal normal;
+    normal.x = nx; normal.y = ny; normal.z = nz;
+    normals.push_back(normal);
+    TexCoord texCoord;
+    texCoord.x = s; texCoord.y = t;
+    texCoords.push_back(texCoord);
+}
+
+void SyntheticScene::addTriangle(uint32_t a, uint32_t b, uint32_t c, MaterialIndex material) {
+    IndexTriplet triangle;
+    triangle.x = a; triangle.y = b; triangle.z = c;
+    indices.push_back(triangle);
+    materials.push_back(material);
+    shapes.back().faceCount++;
+}
+
+void SyntheticScene::addGrid(uint32_t base, uint32_t columns, uint32_t rows, MaterialIndex material) {
+    const uint32_t stride = columns + 1;
+    for (uint32_t row = 0; row < rows; row++) {
+        for (uint32_t column = 0; column < columns; column++) {
+            const uint32_t a = base + row * stride + column;
+            addTriangle(a, a + stride, a + 1, material);
+            addTriangle(a + 1, a + stride, a + stride + 1, material);
+        }
+    }
+}
+
+void SyntheticScene::addSphere(
+    float radius, float x, float y, float z, uint32_t segments, MaterialIndex material, bool inward
+) {
+    beginShape();
+    const float sign = inward ? -1 : 1;
+    for (uint32_t i = 0; i <= segments; i++) {
+        for (uint32_t j = 0; j <= 2 * segments; j++) {
+            const float theta = float(M_PI) * float(i) / float(segments);
+            const float phi = float(M_PI) * float(j) / float(segments);
+            const float nx = std::sin(theta) * std::cos(phi);
+            const float ny = std::cos(theta);
+            const float nz = std::sin(theta) * std::sin(phi);
+            addVertex(x + radius * nx, y + radius * ny, z + radius * nz, sign * nx, sign * ny, sign * nz,
+                      float(j) / float(2 * segments), float(i) / float(segments));
+        }
+    }
+    addGrid(0, 2 * segments, segments, material);
+}
+
+MaterialIndex SyntheticScene::addMaterial(const cpu::Vec3 &diffuse, const cpu::Vec3 &emission) {
+    cpu::Material material;
+    material.diffuse = diffuse;
+    material.emission = emission;
+    materialTable.materials.push_back(material);
+    return MaterialIndex(materialTable.materials.size() - 1);
+}
+
+void SyntheticScene::placeCamera(float x, float y, float z, float tilt, float focalLength) {
+    camera = {};
+    camera.transform.columns[0].x = 1;
+    camera.transform.columns[1].y = std::cos(tilt);
+    camera.transform.columns[1].z = -std::sin(tilt);
+    camera.transform.columns[2].y = std::sin(tilt);
+    camera.transform.columns[2].z = std::cos(tilt);
+    camera.transform.columns[3].x = x;
+    camera.transform.columns[3].y = y;
+    camera.transform.columns[3].z = z;
+    camera.transform.columns[3].w = 1;
+    camera.nearClip = 0;
+    camera.farClip = INFINITY;
+    camera.focalLength = focalLength;
+}
+
+std::unique_ptr<cpu::SceneBuilder> SyntheticScene::build(const cpu::SceneBuilder::Settings &settings) {
+    cpu::SceneBuilder::Buffers buffers;
+    buffers.vertices = vertices.data();
+    buffers.normals = normals.data();
+    buffers.texCoords = texCoords.data();
+    buffers.indices = indices.data();
+    buffers.materials = materials.data();
+    
+    DevicePerInstanceData instance = {};
+    instance.pointTransform.columns[0].x = 1;
+    instance.pointTransform.columns[1].y = 1;
+    instance.pointTransform.columns[2].z = 1;
+    instance.pointTransform.columns[3].w = 1;
+    instance.normalTransform.columns[0].x = 1;
+    instance.normalTransform.columns[1].y = 1;
+    instance.normalTransform.columns[2].z = 1;
+    instance.visibility = RayFlags(0xff);
+    
+    auto builder = std::make_unique<cpu::SceneBuilder>(buffers);
+    for (const Shape &shape : shapes) {
+        instance.vertexOffset = shape.vertexOffset;
+        instance.faceOffset = shape.faceOffset;
+        builder->addInstance(builder->addShape(shape.vertexOffset, shape.faceOffset, shape.faceCount), instance);
+    }
+    builder->build(settings);
+    return builder;
+}
+
+SyntheticScene terrain(uint32_t resolution) {
+    SyntheticScene scene;
+    scene.name = "terrain";
+    const MaterialIndex ground = scene.addMaterial(cpu::Vec3(0.8f));
+    const MaterialIndex dome = scene.addMaterial(cpu::Vec3(0.5f), cpu::Vec3(1));
+    
+    const float extent = 20;
+    scene.beginShape();
+    for (uint32_t row = 0; row <= resolution; row++) {
+        for (uint32_t column = 0; column <= resolution; column++) {
+            const float s = float(column) / float(resolution);
+            const float t = float(row) / float(resolution);
+            const float x = extent * (2 * s - 1);
+            const float z = extent * (2 * t - 1);
+            const float y = 0.3f * std::sin(3 * x) * std::cos(2.5f * z) - 1;
+            scene.addVertex(x, y, z, 0, 1, 0, s, t);
+        }
+    }
+    scene.addGrid(0, resolution, resolution, ground);
+    scene.addSphere(extent + 5, 0, 0, 0, 128, dome, true);
+    
+    scene.placeCamera(0, 2, 6, 0.6f, 1.2f);
+    return scene;
+}
+
+SyntheticScene beams(uint32_t beamCount) {
+    SyntheticScene scene;
+    scene.name = "beams";
+    const MaterialIndex material = scene.addMaterial(cpu::Vec3(0.5f));
+    scene.materialTable.environment = cpu::Vec3(1);
+    
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform;
+    scene.beginShape();
+    for (uint32_t beam = 0; beam < beamCount; beam++) {
+        const cpu::Vec3 start(100 * uniform(random), 100 * uniform(random), 100 * uniform(random));
+        const cpu::Vec3 direction(uniform(random) - 0.5f, uniform(random) - 0.5f, uniform(random) - 0.5f);
+        const cpu::Vec3 end = start + direction * 40;
+        const cpu::Vec3 width(0.05f * uniform(random), 0.05f, 0.05f * uniform(random));
+        const cpu::Vec3 normal = cpu::normalize(cpu::cross(direction, width));
+        const uint32_t base = uint32_t(scene.vertices.size() - scene.shapes.back().vertexOffset);
+        for (const cpu::Vec3 &corner : { start, end, end + width, start + width }) {
+            scene.addVertex(corner.x, corner.y, corner.z, normal.x, normal.y, normal.z, 0, 0);
+        }
+        scene.addTriangle(base, base + 1, base + 2, material);
+        scene.addTriangle(base, base + 2, base + 3, material);
+    }
+    
+    const uint32_t floorBase = uint32_t(scene.vertices.size() - scene.shapes.back().vertexOffset);
+    for (uint32_t row = 0; row <= 100; row++) {
+        for (uint32_t column = 0; column <= 100; column++) {
+            scene.addVertex(float(column), 0, float(row), 0, 1, 0, float(column) / 100, float(row) / 100);
+        }
+    }
+    scene.addGrid(floorBase, 100, 100, material);
+    
+    scene.placeCamera(50, 60, 160, 0.4f, 1);
+    return scene;
+}
+
+SyntheticScene sphere(uint32_t segments) {
+    SyntheticScene scene;
+    scene.name = "sphere";
+    scene.addSphere(1, 0, 0, 0, segments, scene.addMaterial(cpu::Vec3(0.5f)), false);
+    scene.materialTable.environment = cpu::Vec3(1);
+    scene.placeCamera(0, 0, 3, 0, 1.5f);
+    return scene;
+}
+
+SyntheticScene room() {
+    SyntheticScene scene;
+    scene.name = "room";
+    const MaterialIndex white = scene.addMaterial(cpu::Vec3(0.8f));
+    const MaterialIndex light = scene.addMaterial(cpu::Vec3(0.8f), cpu::Vec3(2));
+    const MaterialIndex red = scene.addMaterial(cpu::Vec3(0.8f, 0.1f, 0.1f));
+    const MaterialIndex green = scene.addMaterial(cpu::Vec3(0.1f, 0.8f, 0.1f));
+    
+    /// walls of the unit cube facing inwards, given by their normal and material
+    const struct {
+        int axis;
+        float side;
+        MaterialIndex material;
+    } walls[] = {
+        { 1, -1, white }, { 1, +1, light }, { 2, -1, white }, { 2, +1, white }, { 0, -1, red }, { 0, +1, green },
+    };
+    
+    scene.beginShape();
+    for (const auto &wall : walls) {
+        const int u = (wall.axis + 1) % 3;
+        const int v = (wall.axis + 2) % 3;
+        const uint32_t base = uint32_t(scene.vertices.size() - scene.shapes.back().vertexOffset);
+        for (int corner = 0; corner < 4; corner++) {
+            float position[3];
+            float normal[3] = { 0, 0, 0 };
+            position[wall.axis] = wall.side;
+            position[u] = corner & 1 ? 1 : -1;
+            position[v] = corner & 2 ? 1 : -1;
+            normal[wall.axis] = -wall.side;
+            scene.addVertex(position[0], position[1], position[2], normal[0], normal[1], normal[2],
+                            float(corner & 1), float(corner >> 1));
+        }
+        /// wind the triangles so that their geometric normal faces into the room
+        if (wall.side > 0) {
+            scene.addTriangle(base, base + 1, base + 2, wall.material);
+            scene.addTriangle(base + 1, base + 3, base + 2, wall.material);
+        } else {
+            scene.addTriangle(base, base + 2, base + 1, wall.material);
+            scene.addTriangle(base + 1, base + 2, base + 3, wall.material);
+        }
+    }
+    scene.addSphere(0.4f, -0.4f, -0.6f, -0.2f, 32, white, false);
+    scene.addSphere(0.3f, 0.45f, -0.7f, 0.3f, 32, white, false);
+    
+    scene.placeCamera(0, 0, 0.95f, 0, 0.9f);
+    return scene;
+}
+
+}
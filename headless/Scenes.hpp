@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cpu/SceneBuilder.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace raymond::benchmark {
+
+/**
+ * Generated scene for the benchmarks, with its meshes laid out in global buffers like `ShapeBuilder` fills them
+ * and one instance with an identity transform per shape.
+ */
+struct SyntheticScene {
+    /// Range of a shape within the buffers
+    struct Shape {
+        VertexIndex vertexOffset;
+        FaceIndex faceOffset;
+        FaceIndex faceCount;
+    };
+    
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<Normal> normals;
+    std::vector<TexCoord> texCoords;
+    std::vector<IndexTriplet> indices;
+    std::vector<MaterialIndex> materials;
+    std::vector<Shape> shapes;
+    
+    cpu::MaterialTable materialTable;
+    DeviceCamera camera = {};
+    
+    /// Starts a new shape at the end of the buffers, vertex indices of the following triangles are relative to it
+    void beginShape();
+    void addVertex(float x, float y, float z, float nx, float ny, float nz, float s, float t);
+    void addTriangle(uint32_t a, uint32_t b, uint32_t c, MaterialIndex material);
+    /// Triangulates a grid of `(columns + 1) * (rows + 1)` vertices that starts at the shape relative index `base`
+    void addGrid(uint32_t base, uint32_t columns, uint32_t rows, MaterialIndex material);
+    /// Adds a shape with a sphere of `segments` rings, with normals pointing inwards if `inward` is set
+    void addSphere(float radius, float x, float y, float z, uint32_t segments, MaterialIndex material, bool inward);
+    MaterialIndex addMaterial(const cpu::Vec3 &diffuse, const cpu::Vec3 &emission = cpu::Vec3(0));
+    
+    /// Pinhole camera at the given position, tilted downwards by `tilt` radians and looking along negative z
+    void placeCamera(float x, float y, float z, float tilt, float focalLength);
+    
+    /**
+     * Builds the hierarchies of all shapes, the builder reads from the buffers of this scene
+     * @returns builder whose `scene` renders this scene
+     */
+    std::unique_ptr<cpu::SceneBuilder> build(const cpu::SceneBuilder::Settings &settings);
+    cpu::Scene scene(const cpu::SceneBuilder &builder) const { return builder.scene(camera, materialTable); }
+};
+
+/// Rolling hills of `2 * resolution^2` triangles under an emissive dome, seen from above at an angle
+SyntheticScene terrain(uint32_t resolution);
+
+/**
+ * Long, thin beams (40 units long, at most 0.05 wide) in random orientations over a floor grid of 100 by 100 units,
+ * the worst case for builders that only split objects
+ */
+SyntheticScene beams(uint32_t beamCount);
+
+/// Diffuse sphere of `segments` rings under a uniform environment, seen from the front
+SyntheticScene sphere(uint32_t segments);
+
+/// Closed box with an emissive ceiling and two spheres, which gives deep paths over little geometry
+SyntheticScene room();
+
+}
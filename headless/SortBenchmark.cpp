@@ -0,0 +1,60 @@
+#include "Benchmark.hpp"
+#include "Scenes.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr uint32_t ImageSize = 512;
+constexpr int FrameCount = 4;
+
+/// Assigns one of `count` gray materials to every face of the scene in a pattern that neighboring rays do not share
+void scatterMaterials(benchmark::SyntheticScene &scene, uint32_t count) {
+    scene.materialTable.materials.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        scene.addMaterial(cpu::Vec3(0.2f + 0.6f * float(i) / float(count)));
+    }
+    for (size_t face = 0; face < scene.materials.size(); face++) {
+        scene.materials[face] = MaterialIndex(uint32_t(face * 2654435761u) % count);
+    }
+}
+
+}
+
+/**
+ * Measures the `sort` stage of `Options::sortByMaterial` against the change it brings to the shading stage (`chit`),
+ * on a sphere whose faces use 200 materials and on the terrain. Also checks that sorting leaves the image unchanged.
+ * The optional argument is the number of materials of the sphere (default 200).
+ */
+int main(int argc, char **argv) {
+    const uint32_t materialCount = uint32_t(benchmark::argument(argc, argv, 200));
+    
+    std::vector<benchmark::SyntheticScene> scenes;
+    scenes.push_back(benchmark::sphere(128));
+    scatterMaterials(scenes.back(), materialCount);
+    scenes.push_back(benchmark::terrain(512));
+    
+    std::printf("%-10s %-8s %10s %10s %10s\n", "scene", "sorting", "sort", "chit", "frame");
+    bool passed = true;
+    for (benchmark::SyntheticScene &scene : scenes) {
+        const auto builder = scene.build(cpu::SceneBuilder::Settings());
+        std::vector<simd_float4> images[2];
+        for (int sorted = 0; sorted < 2; sorted++) {
+            cpu::Renderer renderer(scene.scene(*builder));
+            renderer.options.sortByMaterial = sorted;
+            renderer.resize(ImageSize, ImageSize);
+            const benchmark::FrameTimes times = benchmark::renderFrames(renderer, FrameCount);
+            images[sorted] = renderer.image();
+            std::printf("%-10s %-8s %7.1f ms %7.1f ms %7.1f ms\n", scene.name.c_str(), sorted ? "on" : "off",
+                        times.stage("sort") * 1e3, times.stage("chit") * 1e3, times.total * 1e3);
+        }
+        passed &= std::memcmp(images[0].data(), images[1].data(), images[0].size() * sizeof(simd_float4)) == 0;
+    }
+    
+    std::printf("\n%s images are identical with and without sorting\n", passed ? "pass" : "FAIL");
+    return passed ? 0 : 1;
+}
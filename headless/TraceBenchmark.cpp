@@ -0,0 +1,164 @@
+#include "Benchmark.hpp"
+#include "Scenes.hpp"
+
+#include <cpu/Math.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+constexpr uint32_t ImageSize = 1024;
+constexpr int RunCount = 3;
+
+DeviceRay makeRay(const cpu::Vec3 &origin, const cpu::Vec3 &direction, float maxDistance) {
+    DeviceRay ray = {};
+    ray.origin = cpu::pack(origin);
+    ray.direction = cpu::pack(direction);
+    ray.minDistance = 0;
+    ray.maxDistance = maxDistance;
+    return ray;
+}
+
+/// Ray buffers of one scene in the three distributions that a frame traces
+struct Workload {
+    /// one ray through the center of every pixel, in scanline order
+    std::vector<DeviceRay> primary;
+    /// one cosine distributed bounce for every camera ray that hit, in the order of the camera rays
+    std::vector<DeviceRay> diffuse;
+    /// one ray from every hit point towards a point light above the camera, in the order of the camera rays
+    std::vector<DeviceShadowRay> shadow;
+};
+
+Workload makeWorkload(const benchmark::SyntheticScene &scene, const bvh::Tlas &tlas) {
+    Workload workload;
+    const DeviceCamera &camera = scene.camera;
+    const cpu::Vec3 eye = cpu::transformPoint(camera.transform, cpu::Vec3(0));
+    for (uint32_t y = 0; y < ImageSize; y++) {
+        for (uint32_t x = 0; x < ImageSize; x++) {
+            const float u = (x + 0.5f) / ImageSize * 2 - 1;
+            const float v = 1 - (y + 0.5f) / ImageSize * 2;
+            const cpu::Vec3 direction = cpu::normalize(
+                cpu::transformDirection(camera.transform, cpu::Vec3(u, v, -camera.focalLength)));
+            workload.primary.push_back(makeRay(eye, direction, INFINITY));
+        }
+    }
+    
+    std::vector<DeviceIntersection> intersections(workload.primary.size());
+    tlas.intersect(workload.primary.data(), intersections.data(), workload.primary.size());
+    
+    const bvh::Bounds bounds = tlas.bounds();
+    const cpu::Vec3 light = eye + cpu::Vec3(0, 0.1f * cpu::length(bounds.max - bounds.min), 0);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform;
+    for (size_t i = 0; i < intersections.size(); i++) {
+        const DeviceIntersection &intersection = intersections[i];
+        if (intersection.distance == bvh::MissDistance) continue;
+        
+        /// instances have identity transforms, so object and world space coincide
+        const benchmark::SyntheticScene::Shape &shape = scene.shapes[intersection.instanceIndex];
+        const IndexTriplet &triangle = scene.indices[shape.faceOffset + intersection.primitiveIndex];
+        const Vertex *vertices = scene.vertices.data() + shape.vertexOffset;
+        const cpu::Vec3 v0(vertices[triangle.x].x, vertices[triangle.x].y, vertices[triangle.x].z);
+        const cpu::Vec3 v1(vertices[triangle.y].x, vertices[triangle.y].y, vertices[triangle.y].z);
+        const cpu::Vec3 v2(vertices[triangle.z].x, vertices[triangle.z].y, vertices[triangle.z].z);
+        const DeviceRay &ray = workload.primary[i];
+        const cpu::Vec3 direction(ray.direction.x, ray.direction.y, ray.direction.z);
+        cpu::Vec3 normal = cpu::normalize(cpu::cross(v1 - v0, v2 - v0));
+        if (cpu::dot(normal, direction) > 0) normal = normal * -1;
+        const cpu::Vec3 position = eye + direction * intersection.distance + normal * cpu::Epsilon;
+        
+        const float phi = 2 * cpu::Pi * uniform(random);
+        const float radius = std::sqrt(uniform(random));
+        const cpu::Vec3 local(radius * std::cos(phi), radius * std::sin(phi), std::sqrt(1 - radius * radius));
+        workload.diffuse.push_back(makeRay(position, cpu::Frame(normal).toWorld(local), INFINITY));
+        
+        const float distance = cpu::length(light - position);
+        DeviceShadowRay shadowRay = {};
+        shadowRay.origin = cpu::pack(position);
+        shadowRay.direction = cpu::pack((light - position) * (1 / distance));
+        shadowRay.minDistance = 0;
+        shadowRay.maxDistance = distance * (1 - cpu::Epsilon);
+        workload.shadow.push_back(shadowRay);
+    }
+    return workload;
+}
+
+void printRow(const std::string &scene, const char *layout, const char *distribution, size_t rayCount, double time,
+              const std::vector<DeviceIntersection> &intersections) {
+    size_t hits = 0;
+    for (size_t i = 0; i < rayCount; i++) hits += intersections[i].distance != bvh::MissDistance;
+    std::printf("%-10s %-12s %-10s %9zu %7.1f ms %9.2f %7.1f%%\n", scene.c_str(), layout, distribution,
+                rayCount, time * 1e3, rayCount / time / 1e6, 100.0 * hits / rayCount);
+}
+
+}
+
+/**
+ * Measures nearest-hit and any-hit traversal in Mrays/s for camera rays, diffuse bounces and shadow rays, traced as
+ * whole buffers with `Tlas::intersect` and `Tlas::intersectAny` on `ThreadPool::shared()` (best of three), and the
+ * memory of the hierarchies, for both node layouts. The optional argument is the terrain resolution (default 1024,
+ * which gives 2.1M triangles).
+ */
+int main(int argc, char **argv) {
+    const uint32_t resolution = uint32_t(benchmark::argument(argc, argv, 1024));
+    
+    const struct {
+        const char *name;
+        bvh::NodeLayout nodeLayout;
+    } layouts[] = {
+        { "wide", bvh::NodeLayout::Wide },
+        { "compressed", bvh::NodeLayout::Compressed },
+    };
+    
+    std::vector<benchmark::SyntheticScene> scenes;
+    scenes.push_back(benchmark::terrain(resolution));
+    scenes.push_back(benchmark::sphere(256));
+    
+    std::printf("%-10s %-12s %-10s %9s %10s %9s %8s\n", "scene", "layout", "rays", "count", "time", "Mrays/s", "hits");
+    std::vector<std::string> memoryUsage;
+    for (benchmark::SyntheticScene &scene : scenes) {
+        /// the same rays for all layouts, the compressed layout reorders the faces of the scene when it is built
+        const Workload workload = makeWorkload(
+            scene, scene.build(cpu::SceneBuilder::Settings())->accelerationStructure());
+        std::vector<DeviceIntersection> intersections(workload.primary.size());
+        
+        for (const auto &layout : layouts) {
+            cpu::SceneBuilder::Settings settings;
+            settings.nodeLayout = layout.nodeLayout;
+            const auto builder = scene.build(settings);
+            const bvh::Tlas &tlas = builder->accelerationStructure();
+            
+            const double primaryTime = benchmark::bestTime(RunCount, [&]() {
+                tlas.intersect(workload.primary.data(), intersections.data(), workload.primary.size());
+            });
+            printRow(scene.name, layout.name, "primary", workload.primary.size(), primaryTime, intersections);
+            
+            const double diffuseTime = benchmark::bestTime(RunCount, [&]() {
+                tlas.intersect(workload.diffuse.data(), intersections.data(), workload.diffuse.size());
+            });
+            printRow(scene.name, layout.name, "diffuse", workload.diffuse.size(), diffuseTime, intersections);
+            
+            const double shadowTime = benchmark::bestTime(RunCount, [&]() {
+                tlas.intersectAny(workload.shadow.data(), intersections.data(), workload.shadow.size());
+            });
+            printRow(scene.name, layout.name, "shadow", workload.shadow.size(), shadowTime, intersections);
+            
+            char line[128];
+            std::snprintf(line, sizeof(line), "%-10s %-12s %7.2f MB hierarchies, %7.2f MB triangles\n",
+                          scene.name.c_str(), layout.name, tlas.memoryUsage() / double(1 << 20),
+                          (scene.vertices.size() * sizeof(Vertex) + scene.indices.size() * sizeof(IndexTriplet)) /
+                          double(1 << 20));
+            memoryUsage.push_back(line);
+        }
+    }
+    
+    std::printf("\n");
+    for (const std::string &line : memoryUsage) std::printf("%s", line.c_str());
+    return 0;
+}
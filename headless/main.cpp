@@ -0,0 +1,212 @@
+#include <cpu/CpuRenderer.hpp>
+#include <cpu/SceneBuilder.hpp>
+#include <io/MappedFile.hpp>
+#include <io/rbvh/RBvh.hpp>
+#include <io/rmesh/RMesh.hpp>
+#include <io/tinyexr.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace raymond;
+
+namespace {
+
+void printUsage(const char *program) {
+    std::fprintf(stderr,
+        "usage: %s [-frames N] [-width W] [-height H] [-megakernel] [-compressed] [-budget MB] [-output image.exr] "
+        "mesh.rmesh...\n"
+        "Renders the given mesh caches with the CPU renderer under a white environment, all materials are gray clay.\n"
+        "With a budget, the meshes are paged in from the caches instead of being loaded as a whole.\n",
+        program);
+}
+
+/// Camera on the positive z axis that looks at the center of the bounds and sees all of them
+DeviceCamera frameBounds(const float (&boundsMin)[3], const float (&boundsMax)[3]) {
+    float center[3];
+    float radius = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        center[axis] = (boundsMin[axis] + boundsMax[axis]) / 2;
+        radius = std::max(radius, (boundsMax[axis] - boundsMin[axis]) / 2);
+    }
+    
+    DeviceCamera camera = {};
+    camera.focalLength = 2.5f;
+    camera.nearClip = 0;
+    camera.farClip = INFINITY;
+    camera.transform.columns[0].x = 1;
+    camera.transform.columns[1].y = 1;
+    camera.transform.columns[2].z = 1;
+    camera.transform.columns[3].x = center[0];
+    camera.transform.columns[3].y = center[1];
+    camera.transform.columns[3].z = center[2] + radius * (1 + camera.focalLength);
+    camera.transform.columns[3].w = 1;
+    return camera;
+}
+
+}
+
+/**
+ * Renders mesh caches (see `rmesh::write`) without a window or a Metal device, so that the CPU renderer can be
+ * profiled and compared between machines. Every mesh becomes one instance with an identity transform.
+ */
+int main(int argc, char **argv) {
+    unsigned int frameCount = 16;
+    unsigned int width = 512;
+    unsigned int height = 512;
+    std::string outputPath = "headless.exr";
+    cpu::SceneBuilder::Settings settings;
+    cpu::Renderer::Options options;
+    std::vector<std::string> paths;
+    
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "-frames") && hasValue) {
+            frameCount = unsigned(std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "-width") && hasValue) {
+            width = unsigned(std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "-height") && hasValue) {
+            height = unsigned(std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "-output") && hasValue) {
+            outputPath = argv[++i];
+        } else if (!std::strcmp(argv[i], "-megakernel")) {
+            options.executionMode = cpu::Renderer::ExecutionMode::Megakernel;
+        } else if (!std::strcmp(argv[i], "-compressed")) {
+            settings.nodeLayout = bvh::NodeLayout::Compressed;
+        } else if (!std::strcmp(argv[i], "-budget") && hasValue) {
+            settings.memoryBudget = size_t(std::atof(argv[++i]) * (1 << 20));
+        } else if (argv[i][0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || width == 0 || height == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    /**
+     * The global buffers are laid out like the ones of `ShapeBuilder`, one range of vertices and faces per shape.
+     * With a budget they stay empty, and the mesh caches are only mapped to read their sizes, palettes and materials.
+     */
+    std::vector<Vertex> vertices;
+    std::vector<Normal> normals;
+    std::vector<TexCoord> texCoords;
+    std::vector<IndexTriplet> indices;
+    std::vector<MaterialIndex> materials;
+    std::vector<DevicePerInstanceData> instances;
+    std::vector<FaceIndex> faceCounts;
+    std::vector<std::vector<MaterialIndex>> palettes;
+    size_t vertexCount = 0;
+    size_t faceCount = 0;
+    MaterialIndex materialCount = 0;
+    float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+    float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+    
+    for (const std::string &path : paths) {
+        MappedFile file;
+        rmesh::MeshView view;
+        if (!rmesh::map(path, file, view)) {
+            std::fprintf(stderr, "could not read mesh cache '%s'\n", path.c_str());
+            return 1;
+        }
+        
+        DevicePerInstanceData instance = {};
+        instance.vertexOffset = VertexIndex(vertexCount);
+        instance.faceOffset = FaceIndex(faceCount);
+        instance.pointTransform.columns[0].x = 1;
+        instance.pointTransform.columns[1].y = 1;
+        instance.pointTransform.columns[2].z = 1;
+        instance.pointTransform.columns[3].w = 1;
+        instance.normalTransform.columns[0].x = 1;
+        instance.normalTransform.columns[1].y = 1;
+        instance.normalTransform.columns[2].z = 1;
+        instance.visibility = RayFlags(0xff);
+        instances.push_back(instance);
+        
+        vertexCount += view.vertexCount;
+        faceCount += view.faceCount;
+        faceCounts.push_back(FaceIndex(view.faceCount));
+        
+        /// the palette of the cache resolves material indices to themselves, as if the buffers had been copied
+        palettes.emplace_back(view.palette, view.palette + view.paletteSize);
+        for (size_t face = 0; face < view.faceCount; face++) {
+            materialCount = std::max(materialCount, MaterialIndex(view.materials[face] + 1));
+        }
+        
+        if (!settings.memoryBudget) {
+            vertices.insert(vertices.end(), view.vertices, view.vertices + view.vertexCount);
+            normals.insert(normals.end(), view.normals, view.normals + view.vertexCount);
+            texCoords.insert(texCoords.end(), view.texCoords, view.texCoords + view.vertexCount);
+            indices.insert(indices.end(), view.indices, view.indices + view.faceCount);
+            materials.insert(materials.end(), view.materials, view.materials + view.faceCount);
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            boundsMin[axis] = std::min(boundsMin[axis], view.boundsMin[axis]);
+            boundsMax[axis] = std::max(boundsMax[axis], view.boundsMax[axis]);
+        }
+    }
+    
+    cpu::SceneBuilder::Buffers buffers;
+    buffers.vertices = vertices.data();
+    buffers.normals = normals.data();
+    buffers.texCoords = texCoords.data();
+    buffers.indices = indices.data();
+    buffers.materials = materials.data();
+    
+    /// hierarchies are cached next to the mesh caches, like `ShapeBuilder` caches them next to the source files
+    cpu::SceneBuilder builder(buffers);
+    for (size_t i = 0; i < instances.size(); i++) {
+        const uint32_t shape = builder.addShape(
+            instances[i].vertexOffset, instances[i].faceOffset, faceCounts[i], rbvh::cachePath(paths[i]));
+        builder.setMeshCache(shape, paths[i], palettes[i].data(), palettes[i].size());
+        builder.addInstance(shape, instances[i]);
+    }
+    if (!builder.build(settings)) {
+        std::fprintf(stderr, "could not page in the mesh caches\n");
+        return 1;
+    }
+    
+    cpu::MaterialTable materialTable;
+    cpu::Material clay;
+    clay.diffuse = cpu::Vec3(0.8f);
+    materialTable.materials.assign(materialCount, clay);
+    materialTable.environment = cpu::Vec3(1);
+    
+    cpu::Renderer renderer(builder.scene(frameBounds(boundsMin, boundsMax), materialTable));
+    renderer.options = options;
+    renderer.resize(width, height);
+    for (unsigned int frame = 0; frame < frameCount; frame++) {
+        renderer.execute();
+    }
+    renderer.report().print();
+    
+    const std::vector<uint32_t> rayCounts = renderer.rayCounts();
+    const std::vector<uint32_t> shadowRayCounts = renderer.shadowRayCounts();
+    std::printf("rays per depth:");
+    for (uint32_t count : rayCounts) std::printf(" %u", count);
+    std::printf("\nshadow rays per depth:");
+    for (uint32_t count : shadowRayCounts) std::printf(" %u", count);
+    std::printf("\n");
+    if (const PagedGeometry *geometry = builder.geometry()) {
+        std::printf("paged geometry: %.1f MB resident, budget %.1f MB, %zu page faults\n",
+                    double(geometry->residentBytes()) / (1 << 20), double(geometry->memoryBudget()) / (1 << 20),
+                    geometry->pageFaults());
+    }
+    
+    const char *error = nullptr;
+    if (SaveEXR(&renderer.normalizedImage()[0].x, int(width), int(height), 4, 0, outputPath.c_str(), &error) !=
+        TINYEXR_SUCCESS) {
+        std::fprintf(stderr, "could not write '%s': %s\n", outputPath.c_str(), error ? error : "unknown error");
+        FreeEXRErrorMessage(error);
+        return 1;
+    }
+    return 0;
+}
@@ -1,9 +1,15 @@
 #include "tinyexr.h"
 #include "io/PLYReader.h"
+#include "io/MeshCache.h"
+#include "cpu/CpuScene.h"
 #include "io/LensLoader.h"
 #include "host/sky/SkyLoader.h"
 #include "host/lights/distribution.h"
 #include "host/printf_buffer.h"
+#include "mesh/compression.h"
+#include "mesh/optimize.h"
+#include "mesh/hashing.h"
+#include "utils/parallel.h"
 
 #include "bridge/common.hpp"
 #include "bridge/ResourceIds.hpp"
@@ -16,6 +16,43 @@ struct Raymond: ParsableCommand {
     ))
     var externalCompile = false
     
+    @Flag(help: ArgumentHelp(
+        "Store vertex normals and texture coordinates in compact form",
+        discussion: "Uses 32-bit octahedral normals and half precision texture coordinates, saving 12 bytes per vertex"
+    ))
+    var compactVertexAttributes = false
+    
+    @Flag(inversion: .prefixedNo, help: ArgumentHelp(
+        "Weld and reorder meshes for memory locality",
+        discussion: "Triangles are sorted along a Morton curve and vertices by first use, results are kept in the mesh cache"
+    ))
+    var optimizeMeshes = true
+    
+    @Flag(help: ArgumentHelp(
+        "Build acceleration structures for latency instead of trace speed",
+        discussion: "Useful for previews, structures are built with the fast build preference and are not compacted"
+    ))
+    var fastBuild = false
+    
+    @Option(help: ArgumentHelp(
+        "Render this many samples per pixel with the CPU renderer instead of opening a window",
+        discussion: "Prints the report of the last frame and writes the image to cpu.exr, see CpuScene"
+    ))
+    var cpuFrames: Int?
+    
+    @Option(help: "Image width of the CPU renderer")
+    var cpuWidth = 1024
+    
+    @Option(help: "Image height of the CPU renderer")
+    var cpuHeight = 1024
+    
+    func validate() throws {
+        if cpuFrames != nil && compactVertexAttributes {
+            throw ValidationError(
+                "--cpu-frames needs full precision vertex attributes and cannot be combined with --compact-vertex-attributes")
+        }
+    }
+    
     mutating func run() throws {
         log.info("Welcome to raymond")
         
@@ -24,12 +61,27 @@ struct Raymond: ParsableCommand {
         
         var sceneLoader = SceneLoader()
         sceneLoader.externalCompile = externalCompile
+        sceneLoader.compactVertexAttributes = compactVertexAttributes
+        sceneLoader.optimizeMeshes = optimizeMeshes
+        sceneLoader.accelerationQuality = fastBuild ? .fast : .high
+        sceneLoader.buildCpuScene = cpuFrames != nil
         
         let sceneURL = URL(filePath: scenePath)
         let scene = try sceneLoader.loadScene(
             fromURL: sceneURL,
             onDevice: MTLCreateSystemDefaultDevice()!,
             constants: printfBuffer.constants)
+        
+        if let cpuFrames = cpuFrames {
+            scene.cpuScene!.renderFrames(
+                UInt32(cpuFrames),
+                camera: scene.camera,
+                width: UInt32(cpuWidth),
+                height: UInt32(cpuHeight),
+                toEXR: URL(filePath: "cpu.exr"))
+            return
+        }
+        
         let renderer = Renderer(device: device, printfBuffer: printfBuffer, scene: scene)!
         
         //let glassURLs = Bundle.main.urls(forResourcesWithExtension: "glc", subdirectory: "data/glass")!
@@ -17,8 +17,31 @@ typedef packed_float3 MPSPackedFloat3;
 
 // MARK: - Swift/Obj-C
 
+#ifdef __APPLE__
 #include <simd/simd.h>
+#else
+#include <cstdint>
+
+/// Minimal stand-ins for the Apple SIMD types, so that the CPU code can be built on Linux.
+/// Sizes and alignments match <simd/simd.h>, so structs shared with Metal keep their layout.
+typedef struct alignas(8) { float x, y; } simd_float2;
+typedef struct alignas(16) { float x, y, z; } simd_float3;
+typedef struct alignas(16) { float x, y, z, w; } simd_float4;
+typedef struct { simd_float3 columns[3]; } simd_float3x3;
+typedef struct { simd_float4 columns[3]; } simd_float3x4;
+typedef struct { simd_float4 columns[4]; } simd_float4x4;
+typedef simd_float2 vector_float2;
+#endif
+
+#ifdef __OBJC__
 #import <Foundation/Foundation.h>
+#else
+/// Plain C++ translation units (e.g. the CPU renderer) do not have access to Foundation.
+/// The leading `typedef` of `typedef NS_ENUM(...) { ... };` names the underlying type as `<name>RawValue`, since GCC
+/// rejects the `enum _name : _type _name;` redeclaration that clang and Metal accept.
+#define NS_ENUM(_type, _name) _type _name##RawValue; enum _name : _type
+typedef long NSInteger;
+#endif
 
 /// Avoid cluttering the global namespace by prefix names of structs with `Device` on the host
 #define DEVICE_STRUCT(name) struct Device##name
@@ -33,9 +56,11 @@ typedef simd_float4x4 float4x4;
 
 typedef uint32_t atomic_uint;
 
+#ifdef __APPLE__
 /// Support half type on the host using clang extensions
 typedef __fp16 half;
 typedef __attribute__((__ext_vector_type__(3))) half half3;
+#endif
 
 /// Support packed float3 on the host
 typedef struct _MPSPackedFloat3 {
@@ -56,6 +81,14 @@ typedef struct _MPSPackedFloat3 {
 typedef MPSPackedFloat3 Vertex;
 typedef MPSPackedFloat3 Normal;
 typedef simd_float2 TexCoord;
+
+/// Compact vertex attributes, used instead of `Normal` and `TexCoord` when `COMPACT_VERTEX_ATTRIBUTES` is defined
+typedef uint32_t PackedNormal; // octahedral encoding as two snorm16 values
+#ifdef __METAL_VERSION__
+typedef half2 PackedTexCoord;
+#else
+typedef struct { uint16_t x, y; } PackedTexCoord; // binary16 bit patterns
+#endif
 typedef uint32_t VertexIndex;
 typedef uint32_t FaceIndex;
 typedef uint32_t LightIndex;
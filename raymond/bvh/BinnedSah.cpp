@@ -0,0 +1,138 @@
+#include "Binning.hpp"
+
+#include <utils/ThreadPool.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+
+namespace raymond::bvh {
+
+namespace {
+
+using namespace binning;
+
+class Builder {
+public:
+    Builder(const Bounds *primitiveBounds, size_t count, const BuildSettings &settings, Bvh &bvh)
+    : m_settings(settings), m_bvh(bvh) {
+        m_settings.binCount = std::min(std::max(settings.binCount, 2), MaxBinCount);
+        m_settings.maxLeafSize = std::max(settings.maxLeafSize, 1u);
+        
+        m_references.resize(count);
+        parallelChunks(count, [&](size_t i) {
+            m_references[i] = { primitiveBounds[i], uint32_t(i) };
+        });
+        
+        m_bvh.nodes.resize(2 * count - 1);
+    }
+    
+    void build() {
+        build(0, 0, uint32_t(m_references.size()), 1);
+        m_bvh.nodes.resize(m_nodeCount);
+        
+        m_bvh.primitives.resize(m_references.size());
+        parallelChunks(m_references.size(), [&](size_t i) {
+            m_bvh.primitives[i] = m_references[i].primitive;
+        });
+    }
+    
+    size_t leafCount() const { return m_leafCount; }
+    uint32_t maxDepth() const { return m_maxDepth; }
+
+private:
+    /// Kept out of line so that the bins do not occupy stack space during recursion, worker threads have small stacks
+    [[gnu::noinline]] Split findSplit(uint32_t begin, uint32_t end, const Binning &binning, const Bounds &bounds) const {
+        Bins bins;
+        binCentroids(m_references.data() + begin, end - begin, binning, bins);
+        return sweep(bins, binning.binCount, bounds, m_settings, false);
+    }
+    
+    void makeLeaf(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth) {
+        Node &node = m_bvh.nodes[nodeIndex];
+        node.first = begin;
+        node.count = end - begin;
+        m_leafCount++;
+        updateMaximum(m_maxDepth, depth);
+    }
+    
+    void build(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth) {
+        Bounds bounds, centroidBounds;
+        computeBounds(m_references.data() + begin, end - begin, bounds, centroidBounds);
+        m_bvh.nodes[nodeIndex].bounds = bounds;
+        
+        const uint32_t count = end - begin;
+        if (count == 1) return makeLeaf(nodeIndex, begin, end, depth);
+        
+        uint32_t mid;
+        /// small nodes gain nothing from more bins than they have primitives
+        const Binning binning(centroidBounds, std::min(m_settings.binCount, int(count) + 1));
+        const Split split = findSplit(begin, end, binning, bounds);
+        
+        /// median splits add at most 32 levels, which keeps degenerate trees within `MaxDepth`
+        const bool isTooDeep = depth + 32 >= MaxDepth;
+        const float leafCost = m_settings.intersectionCost * float(count);
+        if (split.axis >= 0 && !isTooDeep && (split.cost < leafCost || count > m_settings.maxLeafSize)) {
+            auto it = std::partition(
+                m_references.begin() + begin,
+                m_references.begin() + end,
+                [&](const Reference &reference) { return binning.bin(reference.centroid()[split.axis], split.axis) < split.bin; });
+            mid = uint32_t(it - m_references.begin());
+        } else if (count > m_settings.maxLeafSize) {
+            /// all centroids coincide (or the tree is too deep), split in the middle instead
+            mid = begin + count / 2;
+        } else {
+            return makeLeaf(nodeIndex, begin, end, depth);
+        }
+        assert(mid > begin && mid < end);
+        
+        const uint32_t left = m_nodeCount.fetch_add(2);
+        m_bvh.nodes[nodeIndex].first = left;
+        m_bvh.nodes[nodeIndex].count = 0;
+        
+        if (mid - begin >= ParallelSubtreeThreshold && end - mid >= ParallelSubtreeThreshold) {
+            ThreadPool::shared().parallelFor(2, [&](size_t child) {
+                if (child == 0) build(left, begin, mid, depth + 1);
+                else build(left + 1, mid, end, depth + 1);
+            });
+        } else {
+            build(left, begin, mid, depth + 1);
+            build(left + 1, mid, end, depth + 1);
+        }
+    }
+    
+    BuildSettings m_settings;
+    Bvh &m_bvh;
+    std::vector<Reference> m_references;
+    
+    std::atomic<uint32_t> m_nodeCount { 1 };
+    std::atomic<size_t> m_leafCount { 0 };
+    std::atomic<uint32_t> m_maxDepth { 0 };
+};
+
+}
+
+Bvh buildBinnedSah(const Bounds *primitiveBounds, size_t count, const BuildSettings &settings, BuildStats *stats) {
+    const auto startTime = std::chrono::steady_clock::now();
+    
+    Bvh bvh;
+    if (count > 0) {
+        assert(count <= UINT32_MAX / 2 && "too many primitives");
+        Builder builder(primitiveBounds, count, settings, bvh);
+        builder.build();
+        
+        if (stats) {
+            stats->leafCount = builder.leafCount();
+            stats->maxDepth = builder.maxDepth();
+        }
+    }
+    
+    if (stats) {
+        stats->buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        stats->nodeCount = bvh.nodes.size();
+        stats->sahCost = sahCost(bvh, settings);
+    }
+    return bvh;
+}
+
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "Bvh.hpp"
+
+#include <utils/ThreadPool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <new>
+#include <vector>
+
+/// Binned SAH building blocks shared by `buildBinnedSah` and `buildSbvh`, not meant to be used outside of the builders
+namespace raymond::bvh::binning {
+
+constexpr int MaxBinCount = 64;
+/// nodes with more references than this are binned in parallel chunks
+constexpr size_t ParallelBinningThreshold = 1 << 16;
+constexpr size_t ChunkSize = 1 << 14;
+/// both children need at least this many references to be built as separate tasks
+constexpr size_t ParallelSubtreeThreshold = 1 << 12;
+
+/// Primitives are partitioned together with their bounds, so that binning streams through memory
+struct Reference {
+    Bounds bounds;
+    uint32_t primitive;
+    
+    Vec3 centroid() const { return bounds.center(); }
+};
+
+struct Bin {
+    Bounds bounds;
+    /// references whose centroid falls into the bin for object splits, references that start (`count`) and end
+    /// (`exitCount`) in the bin for spatial splits
+    uint32_t count;
+    uint32_t exitCount;
+};
+
+/// Left uninitialized on construction, since small nodes only use a fraction of `MaxBinCount`
+struct Bins {
+    union {
+        Bin bins[3][MaxBinCount];
+    };
+    
+    Bins() {}
+    
+    void reset(int binCount) {
+        for (int axis = 0; axis < 3; axis++) {
+            for (int b = 0; b < binCount; b++) {
+                new (&bins[axis][b]) Bin { Bounds(), 0, 0 };
+            }
+        }
+    }
+    
+    void merge(const Bins &other, int binCount) {
+        for (int axis = 0; axis < 3; axis++) {
+            for (int b = 0; b < binCount; b++) {
+                bins[axis][b].bounds.extend(other.bins[axis][b].bounds);
+                bins[axis][b].count += other.bins[axis][b].count;
+                bins[axis][b].exitCount += other.bins[axis][b].exitCount;
+            }
+        }
+    }
+};
+
+/// Maps positions to bins along each axis of some bounds
+struct Binning {
+    Vec3 origin;
+    Vec3 scale;
+    Vec3 width;
+    int binCount;
+    
+    Binning(const Bounds &bounds, int binCount) : origin(bounds.min), binCount(binCount) {
+        const Vec3 extent = bounds.extent();
+        for (int axis = 0; axis < 3; axis++) {
+            scale[axis] = extent[axis] > 0 ? float(binCount) * 0.99999f / extent[axis] : 0;
+            width[axis] = extent[axis] / float(binCount);
+        }
+    }
+    
+    int bin(float position, int axis) const {
+        return clamp(int((position - origin[axis]) * scale[axis]));
+    }
+    
+    int clamp(int bin) const {
+        return std::min(std::max(bin, 0), binCount - 1);
+    }
+    
+    /** @returns position of the plane between bins `bin - 1` and `bin` */
+    float plane(int bin, int axis) const {
+        return origin[axis] + float(bin) * width[axis];
+    }
+};
+
+struct Split {
+    int axis = -1;
+    int bin = 0;
+    float cost = std::numeric_limits<float>::infinity();
+    /// bounds of both children, which tell how much they overlap
+    Bounds left, right;
+};
+
+/// Calls `function(i)` for every index in `[0, count)`, in parallel chunks of `ChunkSize`
+template<typename Function>
+void parallelChunks(size_t count, Function function) {
+    ThreadPool::shared().parallelFor((count + ChunkSize - 1) / ChunkSize, [&](size_t chunk) {
+        const size_t end = std::min(count, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++) function(i);
+    });
+}
+
+/// Bounds of the references and of their centroids, in parallel chunks for large nodes
+inline void computeBounds(const Reference *references, size_t count, Bounds &bounds, Bounds &centroidBounds) {
+    auto range = [&](size_t first, size_t last, Bounds &b, Bounds &c) {
+        for (size_t i = first; i < last; i++) {
+            b.extend(references[i].bounds);
+            c.extend(references[i].centroid());
+        }
+    };
+    
+    if (count < ParallelBinningThreshold) {
+        range(0, count, bounds, centroidBounds);
+        return;
+    }
+    
+    const size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    std::vector<Bounds> chunkBounds(chunkCount), chunkCentroids(chunkCount);
+    ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        const size_t first = chunk * ChunkSize;
+        range(first, std::min(count, first + ChunkSize), chunkBounds[chunk], chunkCentroids[chunk]);
+    });
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+        bounds.extend(chunkBounds[chunk]);
+        centroidBounds.extend(chunkCentroids[chunk]);
+    }
+}
+
+/// Runs `range(first, last, bins)` over `count` references, in parallel chunks for large nodes
+template<typename Range>
+void bin(size_t count, int binCount, Bins &bins, Range range) {
+    bins.reset(binCount);
+    if (count < ParallelBinningThreshold) {
+        range(0, count, bins);
+        return;
+    }
+    
+    const size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    std::vector<Bins> chunkBins(chunkCount);
+    ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        chunkBins[chunk].reset(binCount);
+        range(chunk * ChunkSize, std::min(count, (chunk + 1) * ChunkSize), chunkBins[chunk]);
+    });
+    for (const Bins &local : chunkBins) bins.merge(local, binCount);
+}
+
+/// Bins references by their centroid, which is what object splits partition by
+inline void binCentroids(const Reference *references, size_t count, const Binning &binning, Bins &bins) {
+    bin(count, binning.binCount, bins, [&](size_t first, size_t last, Bins &output) {
+        for (size_t i = first; i < last; i++) {
+            const Reference &reference = references[i];
+            const Vec3 position = (reference.centroid() - binning.origin) * binning.scale;
+            const int indices[3] = {
+                binning.clamp(int(position.x)),
+                binning.clamp(int(position.y)),
+                binning.clamp(int(position.z)),
+            };
+            for (int axis = 0; axis < 3; axis++) {
+                Bin &bin = output.bins[axis][indices[axis]];
+                bin.bounds.extend(reference.bounds);
+                bin.count++;
+            }
+        }
+    });
+}
+
+/**
+ * Sweeps over the bins of every axis and returns the split with the lowest SAH cost. Spatial splits count the
+ * references that end in a bin for the right side, since references can be on both sides of the plane.
+ */
+inline Split sweep(const Bins &bins, int binCount, const Bounds &bounds, const BuildSettings &settings, bool isSpatial) {
+    const float inverseArea = 1 / std::max(bounds.halfArea(), std::numeric_limits<float>::min());
+    
+    Split best;
+    for (int axis = 0; axis < 3; axis++) {
+        /// sweep from the right to collect the bounds of all right partitions
+        Bounds rightBounds[MaxBinCount];
+        uint32_t rightCount[MaxBinCount];
+        Bounds accumulated;
+        uint32_t count = 0;
+        for (int b = binCount - 1; b > 0; b--) {
+            accumulated.extend(bins.bins[axis][b].bounds);
+            count += isSpatial ? bins.bins[axis][b].exitCount : bins.bins[axis][b].count;
+            rightBounds[b] = accumulated;
+            rightCount[b] = count;
+        }
+        
+        accumulated = Bounds();
+        count = 0;
+        for (int b = 1; b < binCount; b++) {
+            accumulated.extend(bins.bins[axis][b - 1].bounds);
+            count += bins.bins[axis][b - 1].count;
+            if (count == 0 || rightCount[b] == 0) continue;
+            
+            const float cost = settings.traversalCost + settings.intersectionCost * inverseArea *
+                (accumulated.halfArea() * float(count) + rightBounds[b].halfArea() * float(rightCount[b]));
+            if (cost < best.cost) {
+                best.axis = axis;
+                best.bin = b;
+                best.cost = cost;
+                best.left = accumulated;
+                best.right = rightBounds[b];
+            }
+        }
+    }
+    return best;
+}
+
+/// Raises `maximum` to `value`, for the depth statistics that subtree tasks update concurrently
+inline void updateMaximum(std::atomic<uint32_t> &maximum, uint32_t value) {
+    uint32_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value));
+}
+
+}
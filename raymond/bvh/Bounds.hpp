@@ -0,0 +1,81 @@
+#pragma once
+
+#include <bridge/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace raymond::bvh {
+
+/// Small vector type for the CPU intersection path, which cannot rely on <simd/simd.h> being available
+struct Vec3 {
+    float x, y, z;
+    
+    Vec3() = default;
+    constexpr Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+    explicit constexpr Vec3(float value) : x(value), y(value), z(value) {}
+    Vec3(const MPSPackedFloat3 &v) : x(v.x), y(v.y), z(v.z) {}
+    
+    float operator[](int dim) const { return dim == 0 ? x : dim == 1 ? y : z; }
+    float &operator[](int dim) { return dim == 0 ? x : dim == 1 ? y : z; }
+    
+    Vec3 operator+(const Vec3 &o) const { return { x + o.x, y + o.y, z + o.z }; }
+    Vec3 operator-(const Vec3 &o) const { return { x - o.x, y - o.y, z - o.z }; }
+    Vec3 operator*(const Vec3 &o) const { return { x * o.x, y * o.y, z * o.z }; }
+    Vec3 operator*(float s) const { return { x * s, y * s, z * s }; }
+    Vec3 operator-() const { return { -x, -y, -z }; }
+};
+
+inline Vec3 min(const Vec3 &a, const Vec3 &b) {
+    return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) };
+}
+
+inline Vec3 max(const Vec3 &a, const Vec3 &b) {
+    return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) };
+}
+
+inline float dot(const Vec3 &a, const Vec3 &b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 cross(const Vec3 &a, const Vec3 &b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+/// Axis aligned bounding box, empty boxes have `min > max`
+struct Bounds {
+    Vec3 min { +std::numeric_limits<float>::infinity() };
+    Vec3 max { -std::numeric_limits<float>::infinity() };
+    
+    Bounds() = default;
+    Bounds(const Vec3 &min, const Vec3 &max) : min(min), max(max) {}
+    
+    void extend(const Vec3 &point) {
+        min = bvh::min(min, point);
+        max = bvh::max(max, point);
+    }
+    
+    void extend(const Bounds &other) {
+        min = bvh::min(min, other.min);
+        max = bvh::max(max, other.max);
+    }
+    
+    bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    Vec3 extent() const { return max - min; }
+    Vec3 center() const { return (min + max) * 0.5f; }
+    
+    /** @returns half the surface area, which is all the surface area heuristic needs */
+    float halfArea() const {
+        if (isEmpty()) return 0;
+        const Vec3 e = extent();
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+    
+    int largestAxis() const {
+        const Vec3 e = extent();
+        return e.x >= e.y && e.x >= e.z ? 0 : e.y >= e.z ? 1 : 2;
+    }
+};
+
+}
@@ -0,0 +1,57 @@
+#include "Bvh.hpp"
+
+#include <utils/ThreadPool.hpp>
+
+namespace raymond::bvh {
+
+float sahCost(const Bvh &bvh, const BuildSettings &settings) {
+    if (bvh.nodes.empty()) return 0;
+    
+    const float rootArea = bvh.nodes[0].bounds.halfArea();
+    if (rootArea <= 0) return settings.intersectionCost * float(bvh.primitives.size());
+    
+    double cost = 0;
+    for (const Node &node : bvh.nodes) {
+        const double area = node.bounds.halfArea() / rootArea;
+        cost += node.isLeaf() ?
+            area * settings.intersectionCost * node.count :
+            area * settings.traversalCost;
+    }
+    return float(cost);
+}
+
+Bvh buildBvh(const Bounds *primitiveBounds, size_t count, const BuildSettings &settings, BuildStats *stats) {
+    return settings.quality == BuildQuality::Fast ?
+        buildLbvh(primitiveBounds, count, settings, stats) :
+        buildBinnedSah(primitiveBounds, count, settings, stats);
+}
+
+std::vector<Bounds> triangleBounds(const Mesh &mesh) {
+    constexpr size_t ChunkSize = 1 << 14;
+    std::vector<Bounds> bounds(mesh.faceCount);
+    ThreadPool::shared().parallelFor((mesh.faceCount + ChunkSize - 1) / ChunkSize, [&](size_t chunk) {
+        const size_t end = std::min<size_t>(mesh.faceCount, (chunk + 1) * ChunkSize);
+        for (size_t face = chunk * ChunkSize; face < end; face++) {
+            Vertex v0, v1, v2;
+            mesh.corners(FaceIndex(face), v0, v1, v2);
+            
+            Bounds &b = bounds[face];
+            b.extend(Vec3(v0));
+            b.extend(Vec3(v1));
+            b.extend(Vec3(v2));
+            
+            /// triangles with non-finite vertices cannot be hit, park them at the origin so they do not spoil the tree
+            const Vec3 extent = b.extent();
+            if (!std::isfinite(extent.x + extent.y + extent.z)) b = Bounds(Vec3(0), Vec3(0));
+        }
+    });
+    return bounds;
+}
+
+Bvh buildBlas(const Mesh &mesh, const BuildSettings &settings, BuildStats *stats) {
+    const std::vector<Bounds> bounds = triangleBounds(mesh);
+    if (settings.quality == BuildQuality::Spatial) return buildSbvh(mesh, bounds.data(), settings, stats);
+    return buildBvh(bounds.data(), bounds.size(), settings, stats);
+}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Bounds.hpp"
+
+#include <mesh/PagedGeometry.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace raymond::bvh {
+
+/// Upper bound on the depth of trees produced by the builders, which bounds the traversal stacks
+constexpr uint32_t MaxDepth = 128;
+
+/// Binary BVH node, children of inner nodes are stored next to each other
+struct Node {
+    Bounds bounds;
+    /// index of the left child for inner nodes (the right child follows it), first entry in `primitives` for leaves
+    uint32_t first;
+    /// number of primitives of a leaf, zero for inner nodes
+    uint32_t count;
+    
+    bool isLeaf() const { return count > 0; }
+};
+
+/// Bounding volume hierarchy over a set of primitives (triangles of a shape or instances of a scene), the root is node 0
+struct Bvh {
+    std::vector<Node> nodes;
+    /// indices of the primitives referenced by leaves
+    std::vector<uint32_t> primitives;
+    
+    Bounds bounds() const { return nodes.empty() ? Bounds() : nodes[0].bounds; }
+};
+
+enum class BuildQuality {
+    /// linear BVH from sorted Morton codes, builds several times faster but traces slower, meant for previews
+    Fast,
+    /// binned surface area heuristic, meant for final frames
+    High,
+    /// binned surface area heuristic that may also split triangles, for scenes with long, thin or diagonal triangles
+    Spatial,
+};
+
+struct BuildSettings {
+    BuildQuality quality = BuildQuality::High;
+    /// number of candidate split planes per axis
+    int binCount = 16;
+    /// leaves are split until they contain at most this many primitives
+    uint32_t maxLeafSize = 8;
+    /// cost of traversing a node relative to intersecting a primitive
+    float traversalCost = 1.f;
+    float intersectionCost = 1.f;
+    /// references that spatial splits may add, relative to the number of triangles (only used by `BuildQuality::Spatial`)
+    float spatialSplitBudget = 0.3f;
+};
+
+struct BuildStats {
+    double buildTime = 0; // seconds
+    /// expected cost of a random ray in units of `intersectionCost`, see `sahCost`
+    float sahCost = 0;
+    size_t nodeCount = 0;
+    size_t leafCount = 0;
+    uint32_t maxDepth = 0;
+};
+
+/** @returns the expected cost of a random ray traversing the tree according to the surface area heuristic */
+float sahCost(const Bvh &bvh, const BuildSettings &settings);
+
+/**
+ * Builds a BVH with binned SAH over arbitrary primitive bounds. Binning of large nodes and construction of
+ * independent subtrees are spread over `ThreadPool::shared()`.
+ */
+Bvh buildBinnedSah(const Bounds *primitiveBounds, size_t count, const BuildSettings &settings, BuildStats *stats = nullptr);
+
+/**
+ * Builds a linear BVH (Lauterbach et al. 2009): centroids are sorted along a 30-bit Morton curve with a parallel radix
+ * sort and split at the highest differing bit. Only `maxLeafSize` of the settings is used.
+ */
+Bvh buildLbvh(const Bounds *primitiveBounds, size_t count, const BuildSettings &settings, BuildStats *stats = nullptr);
+
+/// Builds with the builder that `settings.quality` selects, `BuildQuality::Spatial` falls back to binned SAH
+Bvh buildBvh(const Bounds *primitiveBounds, size_t count, const BuildSettings &settings, BuildStats *stats = nullptr);
+
+/// Triangles of a shape, as stored in the scene buffers at the `vertexOffset` and `faceOffset` of the shape
+struct Mesh {
+    const Vertex *vertices;
+    const IndexTriplet *indices;
+    FaceIndex faceCount;
+    
+    /// if set, triangles are read from the pages of the geometry at the offsets below instead of `vertices` and `indices`
+    PagedGeometry *geometry = nullptr;
+    VertexIndex vertexOffset = 0;
+    FaceIndex faceOffset = 0;
+    
+    /** @returns a mesh that reads the given shape of the geometry through the page cache of each thread */
+    static Mesh paged(PagedGeometry &geometry, size_t shape) {
+        const PagedGeometry::ShapeRange &range = geometry.shape(shape);
+        return { nullptr, nullptr, range.faceCount, &geometry, range.vertexOffset, range.faceOffset };
+    }
+    
+    IndexTriplet triangle(FaceIndex face) const {
+        return geometry ? geometry->threadReader().indices(faceOffset + face) : indices[face];
+    }
+    
+    /// Corners of a triangle, with a single lookup of the reader for paged geometry
+    void corners(FaceIndex face, Vertex &v0, Vertex &v1, Vertex &v2) const {
+        if (geometry) {
+            PagedGeometry::Reader &reader = geometry->threadReader();
+            const IndexTriplet triangle = reader.indices(faceOffset + face);
+            v0 = reader.vertex(vertexOffset + triangle.x);
+            v1 = reader.vertex(vertexOffset + triangle.y);
+            v2 = reader.vertex(vertexOffset + triangle.z);
+        } else {
+            const IndexTriplet &triangle = indices[face];
+            v0 = vertices[triangle.x];
+            v1 = vertices[triangle.y];
+            v2 = vertices[triangle.z];
+        }
+    }
+};
+
+/** @returns the bounds of every triangle of the mesh, computed in parallel */
+std::vector<Bounds> triangleBounds(const Mesh &mesh);
+
+/**
+ * Builds a split BVH (Stich et al. 2009) over the triangles of a mesh: besides binned object splits, nodes whose
+ * children overlap are also split by planes that clip the triangles crossing them. Leaves then reference the clipped
+ * triangles on both sides, so the same face index may appear several times in `primitives`, at most
+ * `spatialSplitBudget` times the face count more often in total.
+ */
+Bvh buildSbvh(const Mesh &mesh, const Bounds *triangleBounds, const BuildSettings &settings, BuildStats *stats = nullptr);
+
+/// Builds the bottom level hierarchy of a shape, primitives are face indices relative to the shape
+Bvh buildBlas(const Mesh &mesh, const BuildSettings &settings, BuildStats *stats = nullptr);
+
+}
@@ -0,0 +1,136 @@
+#include "CompressedBvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace raymond::bvh {
+
+namespace {
+
+/// decoded bounds need to enclose the exact ones even if the traversal rounds differently (e.g. by fusing operations)
+float slack(float value) {
+    return std::abs(value) * 0x1p-20f;
+}
+
+void quantize(CompressedNode &node, int child, const Bounds &bounds) {
+    for (int axis = 0; axis < 3; axis++) {
+        const float origin = node.origin[axis];
+        const float scale = exp2i(node.exponent[axis]);
+        auto decode = [&](int q) { return origin + float(q) * scale; };
+        
+        int lower = std::clamp(int(std::floor((bounds.min[axis] - origin) / scale)), 0, 255);
+        while (lower > 0 && decode(lower) > bounds.min[axis] - slack(bounds.min[axis])) lower--;
+        
+        int upper = std::clamp(int(std::ceil((bounds.max[axis] - origin) / scale)), 0, 255);
+        while (upper < 255 && decode(upper) < bounds.max[axis] + slack(bounds.max[axis])) upper++;
+        
+        node.min[axis][child] = uint8_t(lower);
+        node.max[axis][child] = uint8_t(upper);
+    }
+}
+
+}
+
+bool isCompressible(const WideBvh &bvh) {
+    for (const WideNode &node : bvh.nodes) {
+        uint32_t offset = 0;
+        for (int i = 0; i < WideArity; i++) {
+            if (node.count[i] == 0) continue;
+            if (offset > 255 || node.count[i] > 255) return false;
+            offset += node.count[i];
+        }
+    }
+    return true;
+}
+
+CompressedBvh compress(const WideBvh &bvh) {
+    CompressedBvh result;
+    result.bounds = bvh.bounds;
+    if (bvh.nodes.empty()) return result;
+    
+    result.primitives.reserve(bvh.primitives.size());
+    
+    /// nodes are laid out breadth first, so that the inner children of every node end up next to each other
+    std::vector<uint32_t> source = { 0 };
+    for (size_t index = 0; index < source.size(); index++) {
+        const WideNode &node = bvh.nodes[source[index]];
+        
+        Bounds bounds;
+        for (int i = 0; i < WideArity; i++) bounds.extend(node.childBounds(i));
+        
+        CompressedNode compressed = {};
+        for (int axis = 0; axis < 3; axis++) {
+            const float origin = bounds.min[axis] - slack(bounds.min[axis]);
+            const float extent = bounds.max[axis] + slack(bounds.max[axis]) - origin;
+            
+            /// smallest power of two step that lets 255 steps span the node
+            int exponent = extent > 0 ? int(std::ceil(std::log2(extent / 255))) : -126;
+            exponent = std::clamp(exponent, -126, 127);
+            while (exponent < 127 && origin + 255 * exp2i(exponent) < bounds.max[axis]) exponent++;
+            
+            compressed.origin[axis] = origin;
+            compressed.exponent[axis] = int8_t(exponent);
+        }
+        
+        compressed.childBase = uint32_t(source.size());
+        compressed.primitiveBase = uint32_t(result.primitives.size());
+        for (int i = 0; i < WideArity; i++) {
+            if (node.count[i] > 0) {
+                const size_t offset = result.primitives.size() - compressed.primitiveBase;
+                assert(offset <= 255 && node.count[i] <= 255 && "leaves need to be at most 31 primitives, see isCompressible");
+                compressed.offset[i] = uint8_t(offset);
+                compressed.count[i] = uint8_t(node.count[i]);
+                result.primitives.insert(result.primitives.end(),
+                    bvh.primitives.begin() + node.first[i],
+                    bvh.primitives.begin() + node.first[i] + node.count[i]);
+            } else if (node.first[i] != 0) {
+                compressed.innerMask |= 1 << i;
+                compressed.offset[i] = uint8_t(source.size() - compressed.childBase);
+                source.push_back(node.first[i]);
+            } else {
+                /// minimum above maximum, so that rays never enter unused slots
+                for (int axis = 0; axis < 3; axis++) {
+                    compressed.min[axis][i] = 255;
+                    compressed.max[axis][i] = 0;
+                }
+                continue;
+            }
+            
+            quantize(compressed, i, node.childBounds(i));
+        }
+        
+        result.nodes.push_back(compressed);
+    }
+    
+    /// faces that are already in leaf order need no indirection
+    bool isLeafOrder = true;
+    for (size_t i = 0; i < result.primitives.size() && isLeafOrder; i++) isLeafOrder = result.primitives[i] == i;
+    if (isLeafOrder) result.assumeLeafOrder();
+    return result;
+}
+
+bool reorderFaces(CompressedBvh &bvh, IndexTriplet *indices, MaterialIndex *materials, FaceIndex faceCount) {
+    if (bvh.primitives.empty()) return true;
+    if (bvh.primitives.size() != faceCount) return false;
+    
+    std::vector<bool> isReferenced(faceCount, false);
+    for (uint32_t face : bvh.primitives) {
+        if (face >= faceCount || isReferenced[face]) return false;
+        isReferenced[face] = true;
+    }
+    
+    std::vector<IndexTriplet> reorderedIndices(faceCount);
+    for (FaceIndex i = 0; i < faceCount; i++) reorderedIndices[i] = indices[bvh.primitives[i]];
+    std::copy(reorderedIndices.begin(), reorderedIndices.end(), indices);
+    
+    if (materials) {
+        std::vector<MaterialIndex> reorderedMaterials(faceCount);
+        for (FaceIndex i = 0; i < faceCount; i++) reorderedMaterials[i] = materials[bvh.primitives[i]];
+        std::copy(reorderedMaterials.begin(), reorderedMaterials.end(), materials);
+    }
+    
+    bvh.assumeLeafOrder();
+    return true;
+}
+
+}
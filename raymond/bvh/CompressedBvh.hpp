@@ -0,0 +1,100 @@
+#pragma once
+
+#include "WideBvh.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace raymond::bvh {
+
+/** @returns `2^exponent` for exponents of normal floats, without the cost of `std::ldexp` */
+inline float exp2i(int exponent) {
+    const uint32_t bits = uint32_t(exponent + 127) << 23;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/**
+ * Eight-wide node whose child bounds are quantized to 8 bits relative to the bounds of the node (Ylitie et al. 2017,
+ * "Efficient Incoherent Ray Traversal on GPUs Through Compressed Wide BVHs"). Takes 88 bytes instead of the 256 bytes
+ * of a `WideNode`. Quantized bounds are always conservative, so they can only cost extra traversal steps.
+ */
+struct CompressedNode {
+    /// minimum corner of the node, children are quantized on a grid with spacing `2^exponent` from here
+    float origin[3];
+    int8_t exponent[3];
+    /// bit set of the children that are inner nodes
+    uint8_t innerMask;
+    /// inner children are stored consecutively starting at this node index
+    uint32_t childBase;
+    /// primitives of leaf children are stored consecutively starting at this index
+    uint32_t primitiveBase;
+    /// position relative to `childBase` for inner children, relative to `primitiveBase` for leaves
+    uint8_t offset[WideArity];
+    /// number of primitives of leaf children, zero for inner children and unused slots
+    uint8_t count[WideArity];
+    uint8_t min[3][WideArity];
+    uint8_t max[3][WideArity];
+    
+    uint32_t childFirst(int child) const {
+        return (innerMask >> child & 1 ? childBase : primitiveBase) + offset[child];
+    }
+    
+    uint32_t childCount(int child) const { return count[child]; }
+    
+    /// Expands the quantized bounds of all children into the same layout as `WideNode`
+    void decode(float (&minimum)[3][WideArity], float (&maximum)[3][WideArity]) const {
+        for (int axis = 0; axis < 3; axis++) {
+            const float scale = exp2i(exponent[axis]);
+            for (int i = 0; i < WideArity; i++) {
+                minimum[axis][i] = origin[axis] + float(min[axis][i]) * scale;
+                maximum[axis][i] = origin[axis] + float(max[axis][i]) * scale;
+            }
+        }
+    }
+};
+
+/// Wide BVH with quantized nodes, the root is node 0
+struct CompressedBvh {
+    std::vector<CompressedNode> nodes;
+    /// indices of the primitives referenced by leaves, empty if leaves reference face ranges directly
+    std::vector<uint32_t> primitives;
+    Bounds bounds;
+    
+    uint32_t primitive(uint32_t index) const { return primitives.empty() ? index : primitives[index]; }
+    
+    /**
+     * Drops the primitive indices, after which leaves reference ranges of the `IndexTriplet` buffer directly.
+     * Only valid once the faces of the mesh have been reordered according to `primitives`.
+     */
+    void assumeLeafOrder() { primitives = {}; }
+    
+    size_t memoryUsage() const {
+        return nodes.size() * sizeof(CompressedNode) + primitives.size() * sizeof(uint32_t);
+    }
+};
+
+/**
+ * @returns whether the leaves of every node fit the 8-bit offsets and counts of `CompressedNode`, which is guaranteed
+ * for leaves of at most 31 primitives but not for larger `BuildSettings::maxLeafSize`
+ */
+bool isCompressible(const WideBvh &bvh);
+
+/**
+ * Quantizes the nodes of a wide BVH, which needs to be `isCompressible`. Inner children of every node are laid out
+ * consecutively, and so are the primitives of its leaf children. If that primitive order matches the face order of the
+ * mesh, the primitive indices are dropped.
+ */
+CompressedBvh compress(const WideBvh &bvh);
+
+/**
+ * Permutes the faces of a shape (and their materials, if given) into the order in which the leaves reference them and
+ * drops the primitive indices. Face indices of hits then refer to the new order. Trees that reference faces more than
+ * once (spatial splits) or not at all are left untouched.
+ * @returns whether the faces were reordered
+ */
+bool reorderFaces(CompressedBvh &bvh, IndexTriplet *indices, MaterialIndex *materials, FaceIndex faceCount);
+
+}
@@ -0,0 +1,168 @@
+#include "Bvh.hpp"
+
+#include <utils/Morton.hpp>
+#include <utils/ThreadPool.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+
+namespace raymond::bvh {
+
+namespace {
+
+constexpr size_t ChunkSize = 1 << 14;
+/// both children need at least this many primitives to be built as separate tasks
+constexpr size_t ParallelSubtreeThreshold = 1 << 12;
+
+template<typename Function>
+void parallelChunks(size_t count, Function function) {
+    ThreadPool::shared().parallelFor((count + ChunkSize - 1) / ChunkSize, [&](size_t chunk) {
+        const size_t end = std::min(count, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++) function(i);
+    });
+}
+
+class Builder {
+public:
+    Builder(const Bounds *primitiveBounds, std::vector<uint64_t> keys, const BuildSettings &settings, Bvh &bvh)
+    : m_primitiveBounds(primitiveBounds), m_keys(std::move(keys)), m_bvh(bvh) {
+        m_maxLeafSize = std::max(settings.maxLeafSize, 1u);
+        m_bvh.nodes.resize(2 * m_keys.size() - 1);
+    }
+    
+    void build() {
+        build(0, 0, uint32_t(m_keys.size()), 1);
+        m_bvh.nodes.resize(m_nodeCount);
+        
+        m_bvh.primitives.resize(m_keys.size());
+        parallelChunks(m_keys.size(), [&](size_t i) {
+            m_bvh.primitives[i] = uint32_t(m_keys[i]);
+        });
+    }
+    
+    size_t leafCount() const { return m_leafCount; }
+    uint32_t maxDepth() const { return m_maxDepth; }
+
+private:
+    uint32_t code(uint32_t index) const { return uint32_t(m_keys[index] >> 32); }
+    
+    /** @returns the first index whose code has the highest bit set in which the codes of the range differ */
+    uint32_t findSplit(uint32_t begin, uint32_t end) const {
+        const uint32_t first = code(begin), last = code(end - 1);
+        if (first == last) return begin + (end - begin) / 2;
+        
+        const uint32_t bit = 1u << (31 - __builtin_clz(first ^ last));
+        /// codes are sorted, so the ones with the bit set form a suffix of the range
+        uint32_t low = begin, high = end - 1;
+        while (low + 1 < high) {
+            const uint32_t mid = low + (high - low) / 2;
+            if (code(mid) & bit) high = mid;
+            else low = mid;
+        }
+        return high;
+    }
+    
+    /** @returns the bounds of the subtree, which are computed bottom-up */
+    Bounds build(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth) {
+        Node &node = m_bvh.nodes[nodeIndex];
+        if (end - begin <= m_maxLeafSize) {
+            node.bounds = Bounds();
+            for (uint32_t i = begin; i < end; i++) node.bounds.extend(m_primitiveBounds[uint32_t(m_keys[i])]);
+            node.first = begin;
+            node.count = end - begin;
+            m_leafCount++;
+            
+            uint32_t maxDepth = m_maxDepth.load(std::memory_order_relaxed);
+            while (depth > maxDepth && !m_maxDepth.compare_exchange_weak(maxDepth, depth));
+            return node.bounds;
+        }
+        
+        /// 30 bits of Morton code followed by median splits of identical codes stay well within `MaxDepth`
+        const uint32_t mid = findSplit(begin, end);
+        assert(mid > begin && mid < end);
+        
+        const uint32_t left = m_nodeCount.fetch_add(2);
+        node.first = left;
+        node.count = 0;
+        
+        Bounds leftBounds, rightBounds;
+        if (mid - begin >= ParallelSubtreeThreshold && end - mid >= ParallelSubtreeThreshold) {
+            ThreadPool::shared().parallelFor(2, [&](size_t child) {
+                if (child == 0) leftBounds = build(left, begin, mid, depth + 1);
+                else rightBounds = build(left + 1, mid, end, depth + 1);
+            });
+        } else {
+            leftBounds = build(left, begin, mid, depth + 1);
+            rightBounds = build(left + 1, mid, end, depth + 1);
+        }
+        
+        /// nodes are allocated up front, so `node` is still valid after the recursion
+        node.bounds = leftBounds;
+        node.bounds.extend(rightBounds);
+        return node.bounds;
+    }
+    
+    const Bounds *m_primitiveBounds;
+    /// Morton code in the upper 32 bits, primitive index in the lower 32 bits
+    std::vector<uint64_t> m_keys;
+    Bvh &m_bvh;
+    uint32_t m_maxLeafSize;
+    
+    std::atomic<uint32_t> m_nodeCount { 1 };
+    std::atomic<size_t> m_leafCount { 0 };
+    std::atomic<uint32_t> m_maxDepth { 0 };
+};
+
+}
+
+Bvh buildLbvh(const Bounds *primitiveBounds, size_t count, const BuildSettings &settings, BuildStats *stats) {
+    const auto startTime = std::chrono::steady_clock::now();
+    
+    Bvh bvh;
+    if (count > 0) {
+        assert(count <= UINT32_MAX / 2 && "too many primitives");
+        
+        const size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+        std::vector<Bounds> chunkCentroids(chunkCount);
+        ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+            const size_t end = std::min(count, (chunk + 1) * ChunkSize);
+            for (size_t i = chunk * ChunkSize; i < end; i++) chunkCentroids[chunk].extend(primitiveBounds[i].center());
+        });
+        
+        Bounds centroidBounds;
+        for (const Bounds &bounds : chunkCentroids) centroidBounds.extend(bounds);
+        
+        /// quantize centroids to a grid of 1024^3 cubes, cells need to be cubes so that flat scenes are not split
+        /// along their thin axis first
+        const Vec3 extent = centroidBounds.extent();
+        const float maxExtent = std::max(std::max(extent.x, extent.y), extent.z);
+        const Vec3 scale(maxExtent > 0 ? 1023.99f / maxExtent : 0);
+        
+        std::vector<uint64_t> keys(count);
+        parallelChunks(count, [&](size_t i) {
+            const Vec3 position = (primitiveBounds[i].center() - centroidBounds.min) * scale;
+            const uint32_t code = morton::encode(uint32_t(position.x), uint32_t(position.y), uint32_t(position.z));
+            keys[i] = uint64_t(code) << 32 | uint32_t(i);
+        });
+        std::vector<uint64_t> buffer(count);
+        morton::sortKeys(keys, buffer, count);
+        
+        Builder builder(primitiveBounds, std::move(keys), settings, bvh);
+        builder.build();
+        
+        if (stats) {
+            stats->leafCount = builder.leafCount();
+            stats->maxDepth = builder.maxDepth();
+        }
+    }
+    
+    if (stats) {
+        stats->buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        stats->nodeCount = bvh.nodes.size();
+        stats->sahCost = sahCost(bvh, settings);
+    }
+    return bvh;
+}
+
+}
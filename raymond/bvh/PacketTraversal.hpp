@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Traversal.hpp"
+
+#include <cstdint>
+
+namespace raymond::bvh {
+
+/// Rays per packet, one 8x8 tile of the block linear order in which `generateRays` writes camera rays
+constexpr int PacketSize = 64;
+/// Bit set over the rays of a packet
+typedef uint64_t RayMask;
+/// Subtrees entered by fewer rays than this are traversed one ray at a time, as the rays no longer share much work
+constexpr int MinPacketRays = 8;
+
+/**
+ * Visits the leaves of a wide BVH for a packet of rays. Every node is tested against the rays that entered its parent,
+ * so coherent rays share the node fetches and the stack. Once a subtree is only entered by a few rays, they continue
+ * with the single ray `traverse`.
+ * `leaf(mask, first, count)` intersects the primitives of a leaf with the rays in `mask` and returns those it updated.
+ * @returns mask of the rays whose hit was updated, rays stop at their first hit if `AnyHit` is set
+ */
+template<bool AnyHit, typename Tree, typename Leaf>
+RayMask traversePacket(const Tree &bvh, const TraversalRay *rays, Hit *hits, RayMask active, Leaf leaf) {
+    if (bvh.nodes.empty()) return 0;
+    
+    /// subtrees that still need to be visited together with the rays that entered them
+    struct Entry {
+        uint32_t first;
+        uint32_t count;
+        RayMask rays;
+    };
+    Entry stack[MaxDepth * (WideArity - 1) + 1];
+    int stackSize = 0;
+    stack[stackSize++] = { 0, 0, active };
+    
+    RayMask found = 0;
+    while (stackSize > 0) {
+        const Entry entry = stack[--stackSize];
+        const RayMask mask = AnyHit ? entry.rays & ~found : entry.rays;
+        if (!mask) continue;
+        
+        if (entry.count > 0) {
+            found |= leaf(mask, entry.first, entry.count);
+            continue;
+        }
+        
+        if (__builtin_popcountll(mask) < MinPacketRays) {
+            for (RayMask remaining = mask; remaining; remaining &= remaining - 1) {
+                const int i = __builtin_ctzll(remaining);
+                const RayMask ray = RayMask(1) << i;
+                const bool updated = traverse<AnyHit>(bvh, rays[i], hits[i], [&](uint32_t first, uint32_t count) {
+                    return leaf(ray, first, count) != 0;
+                }, entry.first);
+                if (updated) found |= ray;
+            }
+            continue;
+        }
+        
+        /// rays entering each child, and the sum of their entry distances to order the children
+        const auto &node = bvh.nodes[entry.first];
+        RayMask childRays[WideArity] = {};
+        float childDistance[WideArity] = {};
+        for (RayMask remaining = mask; remaining; remaining &= remaining - 1) {
+            const int i = __builtin_ctzll(remaining);
+            float distances[WideArity];
+            for (unsigned children = enterChildren(node, rays[i], hits[i].distance, distances); children; children &= children - 1) {
+                const int child = __builtin_ctz(children);
+                childRays[child] |= RayMask(1) << i;
+                childDistance[child] += distances[child];
+            }
+        }
+        
+        /// push the children by decreasing mean entry distance, so that the nearest one ends up on top of the stack
+        int order[WideArity];
+        int childCount = 0;
+        for (int child = 0; child < WideArity; child++) {
+            if (!childRays[child]) continue;
+            
+            childDistance[child] /= float(__builtin_popcountll(childRays[child]));
+            int position = childCount++;
+            while (!AnyHit && position > 0 && childDistance[order[position - 1]] < childDistance[child]) {
+                order[position] = order[position - 1];
+                position--;
+            }
+            order[position] = child;
+        }
+        
+        for (int i = 0; i < childCount; i++) {
+            const int child = order[i];
+            stack[stackSize++] = { node.childFirst(child), node.childCount(child), childRays[child] };
+        }
+    }
+    return found;
+}
+
+/**
+ * Packet version of `intersectBlas`, finds the closest triangle (or any triangle if `AnyHit` is set) for every ray in
+ * `active`.
+ * @returns mask of the rays whose hit was updated
+ */
+template<bool AnyHit, typename Tree>
+RayMask intersectBlasPacket(const Tree &bvh, const Mesh &mesh, const TraversalRay *rays, Hit *hits, RayMask active) {
+    return traversePacket<AnyHit>(bvh, rays, hits, active, [&](RayMask mask, uint32_t first, uint32_t count) {
+        RayMask found = 0;
+        for (uint32_t offset = 0; offset < count; offset += WideArity) {
+            /// rays of a packet share the vertex fetches of every batch
+            TriangleBatch batch;
+            gatherTriangles(bvh, mesh, first + offset, std::min<uint32_t>(WideArity, count - offset), batch);
+            for (RayMask remaining = AnyHit ? mask & ~found : mask; remaining; remaining &= remaining - 1) {
+                const int ray = __builtin_ctzll(remaining);
+                if (intersectTriangles(rays[ray], batch, hits[ray]) >= 0) found |= RayMask(1) << ray;
+            }
+        }
+        return found;
+    });
+}
+
+}
@@ -0,0 +1,346 @@
+#include "Binning.hpp"
+
+#include <utils/ThreadPool.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+
+namespace raymond::bvh {
+
+namespace {
+
+using namespace binning;
+
+/**
+ * Spatial splits are only tried when the children of the best object split overlap by more than this fraction of the
+ * root surface area (alpha in Stich et al. 2009), which keeps them away from the many nodes that do not need them.
+ */
+constexpr float OverlapThreshold = 1e-5f;
+
+Bounds intersect(const Bounds &a, const Bounds &b) {
+    return { max(a.min, b.min), min(a.max, b.max) };
+}
+
+/** @returns the bounds of the part of a triangle that lies between `lower` and `upper` along `axis` */
+Bounds clipTriangle(const Vec3 (&vertices)[3], int axis, float lower, float upper) {
+    Bounds result;
+    for (int i = 0; i < 3; i++) {
+        const Vec3 &a = vertices[i];
+        const Vec3 &b = vertices[(i + 1) % 3];
+        if (a[axis] >= lower && a[axis] <= upper) result.extend(a);
+        
+        for (const float plane : { lower, upper }) {
+            if ((a[axis] < plane && b[axis] > plane) || (a[axis] > plane && b[axis] < plane)) {
+                Vec3 point = a + (b - a) * ((plane - a[axis]) / (b[axis] - a[axis]));
+                point[axis] = plane;
+                result.extend(point);
+            }
+        }
+    }
+    return result;
+}
+
+/// Hierarchy of a subtree that was built by a separate task, to be spliced into the hierarchy of its parent
+struct Subtree {
+    std::vector<Node> nodes;
+    std::vector<uint32_t> primitives;
+};
+
+class Builder {
+public:
+    Builder(const Mesh &mesh, const BuildSettings &settings)
+    : m_mesh(mesh), m_settings(settings) {
+        m_settings.binCount = std::min(std::max(settings.binCount, 2), MaxBinCount);
+        m_settings.maxLeafSize = std::max(settings.maxLeafSize, 1u);
+        m_maxDuplicates = size_t(double(std::max(settings.spatialSplitBudget, 0.f)) * mesh.faceCount);
+    }
+    
+    void build(const Bounds *primitiveBounds, Bvh &bvh) {
+        std::vector<Reference> references(m_mesh.faceCount);
+        parallelChunks(references.size(), [&](size_t i) {
+            references[i] = { primitiveBounds[i], uint32_t(i) };
+        });
+        
+        Bounds bounds, centroidBounds;
+        computeBounds(references.data(), references.size(), bounds, centroidBounds);
+        m_rootArea = std::max(bounds.halfArea(), std::numeric_limits<float>::min());
+        
+        Subtree tree;
+        tree.nodes.reserve(2 * references.size());
+        tree.primitives.reserve(references.size() + m_maxDuplicates);
+        tree.nodes.emplace_back();
+        build(tree, 0, std::move(references), 1);
+        
+        bvh.nodes = std::move(tree.nodes);
+        bvh.primitives = std::move(tree.primitives);
+    }
+    
+    size_t leafCount() const { return m_leafCount; }
+    uint32_t maxDepth() const { return m_maxDepth; }
+
+private:
+    void triangle(uint32_t primitive, Vec3 (&vertices)[3]) const {
+        Vertex v0, v1, v2;
+        m_mesh.corners(primitive, v0, v1, v2);
+        vertices[0] = Vec3(v0);
+        vertices[1] = Vec3(v1);
+        vertices[2] = Vec3(v2);
+    }
+    
+    /// Kept out of line so that the bins do not occupy stack space during recursion, worker threads have small stacks
+    [[gnu::noinline]] Split findObjectSplit(const std::vector<Reference> &references, const Binning &binning, const Bounds &bounds) const {
+        Bins bins;
+        binCentroids(references.data(), references.size(), binning, bins);
+        return sweep(bins, binning.binCount, bounds, m_settings, false);
+    }
+    
+    /**
+     * Bins references by the part of their triangle that overlaps each bin, so that references spanning several bins
+     * only contribute their clipped bounds to either side of a split plane.
+     */
+    [[gnu::noinline]] Split findSpatialSplit(const std::vector<Reference> &references, const Binning &binning, const Bounds &bounds) const {
+        Bins bins;
+        bin(references.size(), binning.binCount, bins, [&](size_t first, size_t last, Bins &output) {
+            for (size_t i = first; i < last; i++) {
+                const Reference &reference = references[i];
+                Vec3 vertices[3];
+                triangle(reference.primitive, vertices);
+                
+                for (int axis = 0; axis < 3; axis++) {
+                    if (binning.width[axis] <= 0) continue;
+                    
+                    const int firstBin = binning.bin(reference.bounds.min[axis], axis);
+                    const int lastBin = binning.bin(reference.bounds.max[axis], axis);
+                    for (int b = firstBin; b <= lastBin; b++) {
+                        const Bounds clipped = firstBin == lastBin ? reference.bounds :
+                            intersect(clipTriangle(vertices, axis, binning.plane(b, axis), binning.plane(b + 1, axis)), reference.bounds);
+                        output.bins[axis][b].bounds.extend(clipped);
+                    }
+                    output.bins[axis][firstBin].count++;
+                    output.bins[axis][lastBin].exitCount++;
+                }
+            }
+        });
+        
+        Split split = sweep(bins, binning.binCount, bounds, m_settings, true);
+        if (split.axis >= 0) {
+            /// a split that duplicates every reference to one side does not make progress
+            uint32_t leftCount = 0, rightCount = 0;
+            for (int b = 0; b < binning.binCount; b++) {
+                if (b < split.bin) leftCount += bins.bins[split.axis][b].count;
+                else rightCount += bins.bins[split.axis][b].exitCount;
+            }
+            if (leftCount >= references.size() || rightCount >= references.size()) split = Split();
+        }
+        return split;
+    }
+    
+    /**
+     * Distributes references to the sides of a spatial split plane. References that straddle the plane are only
+     * duplicated if that is cheaper than moving them to one side entirely ("reference unsplitting").
+     * @returns number of references that were duplicated
+     */
+    size_t partitionSpatial(
+        const std::vector<Reference> &references, const Binning &binning, const Split &split,
+        std::vector<Reference> &left, std::vector<Reference> &right
+    ) const {
+        const int axis = split.axis;
+        const float plane = binning.plane(split.bin, axis);
+        
+        std::vector<const Reference *> straddling;
+        Bounds leftBounds, rightBounds;
+        for (const Reference &reference : references) {
+            if (binning.bin(reference.bounds.max[axis], axis) < split.bin) {
+                left.push_back(reference);
+                leftBounds.extend(reference.bounds);
+            } else if (binning.bin(reference.bounds.min[axis], axis) >= split.bin) {
+                right.push_back(reference);
+                rightBounds.extend(reference.bounds);
+            } else {
+                straddling.push_back(&reference);
+            }
+        }
+        
+        size_t duplicateCount = 0;
+        for (const Reference *reference : straddling) {
+            Vec3 vertices[3];
+            triangle(reference->primitive, vertices);
+            const Reference leftPart = {
+                intersect(clipTriangle(vertices, axis, -std::numeric_limits<float>::infinity(), plane), reference->bounds),
+                reference->primitive
+            };
+            const Reference rightPart = {
+                intersect(clipTriangle(vertices, axis, plane, std::numeric_limits<float>::infinity()), reference->bounds),
+                reference->primitive
+            };
+            
+            /// compare the SAH of both children when splitting against moving the whole reference to either side
+            const float leftCount = float(left.size()), rightCount = float(right.size());
+            Bounds leftUnsplit = leftBounds, rightUnsplit = rightBounds;
+            leftUnsplit.extend(reference->bounds);
+            rightUnsplit.extend(reference->bounds);
+            Bounds leftSplit = leftBounds, rightSplit = rightBounds;
+            leftSplit.extend(leftPart.bounds);
+            rightSplit.extend(rightPart.bounds);
+            
+            const float splitCost = leftPart.bounds.isEmpty() || rightPart.bounds.isEmpty() ?
+                std::numeric_limits<float>::infinity() :
+                leftSplit.halfArea() * (leftCount + 1) + rightSplit.halfArea() * (rightCount + 1);
+            const float leftCost = leftUnsplit.halfArea() * (leftCount + 1) + rightBounds.halfArea() * rightCount;
+            const float rightCost = leftBounds.halfArea() * leftCount + rightUnsplit.halfArea() * (rightCount + 1);
+            
+            if (splitCost < leftCost && splitCost < rightCost) {
+                left.push_back(leftPart);
+                right.push_back(rightPart);
+                leftBounds = leftSplit;
+                rightBounds = rightSplit;
+                duplicateCount++;
+            } else if (leftCost <= rightCost) {
+                left.push_back(*reference);
+                leftBounds = leftUnsplit;
+            } else {
+                right.push_back(*reference);
+                rightBounds = rightUnsplit;
+            }
+        }
+        return duplicateCount;
+    }
+    
+    /** @returns whether `count` more duplicates fit into the budget, in which case they are taken from it */
+    bool reserveDuplicates(size_t count) {
+        if (m_duplicateCount.fetch_add(count) + count <= m_maxDuplicates) return true;
+        m_duplicateCount.fetch_sub(count);
+        return false;
+    }
+    
+    void makeLeaf(Subtree &tree, uint32_t nodeIndex, const std::vector<Reference> &references, uint32_t depth) {
+        Node &node = tree.nodes[nodeIndex];
+        node.first = uint32_t(tree.primitives.size());
+        node.count = uint32_t(references.size());
+        for (const Reference &reference : references) tree.primitives.push_back(reference.primitive);
+        m_leafCount++;
+        updateMaximum(m_maxDepth, depth);
+    }
+    
+    void build(Subtree &tree, uint32_t nodeIndex, std::vector<Reference> references, uint32_t depth) {
+        Bounds bounds, centroidBounds;
+        computeBounds(references.data(), references.size(), bounds, centroidBounds);
+        tree.nodes[nodeIndex].bounds = bounds;
+        
+        const size_t count = references.size();
+        if (count == 1) return makeLeaf(tree, nodeIndex, references, depth);
+        
+        /// small nodes gain nothing from more bins than they have references
+        const int binCount = std::min(m_settings.binCount, int(count) + 1);
+        const Binning objectBinning(centroidBounds, binCount);
+        Split split = findObjectSplit(references, objectBinning, bounds);
+        
+        /// median splits add at most 32 levels, which keeps degenerate trees within `MaxDepth`
+        const bool isTooDeep = depth + 32 >= MaxDepth;
+        const float leafCost = m_settings.intersectionCost * float(count);
+        
+        std::vector<Reference> left, right;
+        const float overlap = split.axis >= 0 ? intersect(split.left, split.right).halfArea() : m_rootArea;
+        if (!isTooDeep && overlap / m_rootArea > OverlapThreshold && m_duplicateCount < m_maxDuplicates) {
+            const Binning spatialBinning(bounds, binCount);
+            const Split spatial = findSpatialSplit(references, spatialBinning, bounds);
+            if (spatial.cost < split.cost && (spatial.cost < leafCost || count > m_settings.maxLeafSize)) {
+                const size_t duplicateCount = partitionSpatial(references, spatialBinning, spatial, left, right);
+                if (left.empty() || right.empty() || !reserveDuplicates(duplicateCount)) {
+                    left.clear();
+                    right.clear();
+                }
+            }
+        }
+        
+        if (!left.empty()) {
+            /// partitioned by the spatial split above
+        } else if (split.axis >= 0 && !isTooDeep && (split.cost < leafCost || count > m_settings.maxLeafSize)) {
+            for (const Reference &reference : references) {
+                const bool isLeft = objectBinning.bin(reference.centroid()[split.axis], split.axis) < split.bin;
+                (isLeft ? left : right).push_back(reference);
+            }
+        } else if (count > m_settings.maxLeafSize) {
+            /// all centroids coincide (or the tree is too deep), split in the middle instead
+            left.assign(references.begin(), references.begin() + count / 2);
+            right.assign(references.begin() + count / 2, references.end());
+        } else {
+            return makeLeaf(tree, nodeIndex, references, depth);
+        }
+        assert(!left.empty() && !right.empty());
+        references = {};
+        
+        const uint32_t leftIndex = uint32_t(tree.nodes.size());
+        tree.nodes[nodeIndex].first = leftIndex;
+        tree.nodes[nodeIndex].count = 0;
+        tree.nodes.resize(leftIndex + 2);
+        
+        if (left.size() < ParallelSubtreeThreshold || right.size() < ParallelSubtreeThreshold) {
+            build(tree, leftIndex, std::move(left), depth + 1);
+            build(tree, leftIndex + 1, std::move(right), depth + 1);
+            return;
+        }
+        
+        /// the number of nodes is not known in advance, so each task builds into its own arrays
+        Subtree subtrees[2];
+        std::vector<Reference> *children[2] = { &left, &right };
+        ThreadPool::shared().parallelFor(2, [&](size_t child) {
+            subtrees[child].nodes.emplace_back();
+            build(subtrees[child], 0, std::move(*children[child]), depth + 1);
+        });
+        splice(tree, leftIndex, subtrees[0]);
+        splice(tree, leftIndex + 1, subtrees[1]);
+    }
+    
+    /// Moves the root of a subtree to `nodeIndex` and appends its remaining nodes and primitives
+    static void splice(Subtree &tree, uint32_t nodeIndex, const Subtree &subtree) {
+        /// node `i > 0` of the subtree ends up at `nodeOffset + i`
+        const uint32_t nodeOffset = uint32_t(tree.nodes.size()) - 1;
+        const uint32_t primitiveOffset = uint32_t(tree.primitives.size());
+        
+        auto relocate = [&](Node node) {
+            node.first += node.isLeaf() ? primitiveOffset : nodeOffset;
+            return node;
+        };
+        
+        tree.nodes[nodeIndex] = relocate(subtree.nodes[0]);
+        for (size_t i = 1; i < subtree.nodes.size(); i++) tree.nodes.push_back(relocate(subtree.nodes[i]));
+        tree.primitives.insert(tree.primitives.end(), subtree.primitives.begin(), subtree.primitives.end());
+    }
+    
+    Mesh m_mesh;
+    BuildSettings m_settings;
+    float m_rootArea = 0;
+    size_t m_maxDuplicates = 0;
+    
+    std::atomic<size_t> m_duplicateCount { 0 };
+    std::atomic<size_t> m_leafCount { 0 };
+    std::atomic<uint32_t> m_maxDepth { 0 };
+};
+
+}
+
+Bvh buildSbvh(const Mesh &mesh, const Bounds *triangleBounds, const BuildSettings &settings, BuildStats *stats) {
+    const auto startTime = std::chrono::steady_clock::now();
+    
+    Bvh bvh;
+    if (mesh.faceCount > 0) {
+        Builder builder(mesh, settings);
+        builder.build(triangleBounds, bvh);
+        
+        if (stats) {
+            stats->leafCount = builder.leafCount();
+            stats->maxDepth = builder.maxDepth();
+        }
+    }
+    
+    if (stats) {
+        stats->buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        stats->nodeCount = bvh.nodes.size();
+        stats->sahCost = sahCost(bvh, settings);
+    }
+    return bvh;
+}
+
+}
@@ -0,0 +1,269 @@
+#include "Tlas.hpp"
+
+#include <utils/ThreadPool.hpp>
+
+#include <cassert>
+
+namespace raymond::bvh {
+
+uint32_t Tlas::addShape(const Mesh &mesh, const Bvh &blas, NodeLayout layout) {
+    Shape shape;
+    shape.mesh = mesh;
+    shape.layout = layout;
+    shape.wide = collapse(blas);
+    if (layout == NodeLayout::Compressed && !isCompressible(shape.wide)) {
+        shape.layout = NodeLayout::Wide;
+    }
+    if (shape.layout == NodeLayout::Compressed) {
+        shape.compressed = compress(shape.wide);
+        shape.wide = {};
+    }
+    m_shapes.push_back(std::move(shape));
+    return uint32_t(m_shapes.size() - 1);
+}
+
+uint32_t Tlas::addShapeInLeafOrder(const Mesh &mesh, IndexTriplet *indices, MaterialIndex *materials, const Bvh &blas) {
+    assert(mesh.indices == indices && !mesh.geometry);
+    const uint32_t shapeIndex = addShape(mesh, blas, NodeLayout::Compressed);
+    Shape &shape = m_shapes[shapeIndex];
+    if (shape.layout == NodeLayout::Compressed) {
+        reorderFaces(shape.compressed, indices, materials, mesh.faceCount);
+    }
+    return shapeIndex;
+}
+
+uint32_t Tlas::addInstance(uint32_t shape, const Transform &objectToWorld) {
+    assert(shape < m_shapes.size());
+    m_instances.push_back({
+        shape, objectToWorld, objectToWorld.inverse(),
+        objectToWorld.apply(m_shapes[shape].bounds())
+    });
+    return uint32_t(m_instances.size() - 1);
+}
+
+void Tlas::build(const BuildSettings &settings, BuildStats *stats) {
+    std::vector<Bounds> bounds(m_instances.size());
+    for (size_t i = 0; i < m_instances.size(); i++) {
+        bounds[i] = m_instances[i].worldBounds;
+    }
+    m_bvh = collapse(buildBvh(bounds.data(), bounds.size(), settings, stats));
+    m_settings = settings;
+    m_builtArea = childArea();
+}
+
+bool Tlas::updateInstances(const uint32_t *instances, const Transform *objectToWorld, size_t count, float rebuildThreshold) {
+    for (size_t i = 0; i < count; i++) {
+        Instance &instance = m_instances[instances[i]];
+        instance.objectToWorld = objectToWorld[i];
+        instance.worldToObject = objectToWorld[i].inverse();
+        instance.worldBounds = objectToWorld[i].apply(m_shapes[instance.shape].bounds());
+    }
+    
+    refit();
+    if (childArea() <= rebuildThreshold * m_builtArea) return false;
+    
+    build(m_settings);
+    return true;
+}
+
+void Tlas::refit() {
+    /// children are always created after their parent, so a reverse sweep visits them first
+    for (size_t nodeIndex = m_bvh.nodes.size(); nodeIndex-- > 0;) {
+        WideNode &node = m_bvh.nodes[nodeIndex];
+        for (int i = 0; i < WideArity; i++) {
+            Bounds bounds;
+            if (node.count[i] > 0) {
+                for (uint32_t j = node.first[i]; j < node.first[i] + node.count[i]; j++) {
+                    bounds.extend(m_instances[m_bvh.primitives[j]].worldBounds);
+                }
+            } else if (node.first[i] != 0) {
+                const WideNode &child = m_bvh.nodes[node.first[i]];
+                for (int k = 0; k < WideArity; k++) bounds.extend(child.childBounds(k));
+            } else {
+                continue;
+            }
+            node.setChildBounds(i, bounds);
+        }
+    }
+    
+    m_bvh.bounds = Bounds();
+    if (m_bvh.nodes.empty()) return;
+    for (int i = 0; i < WideArity; i++) m_bvh.bounds.extend(m_bvh.nodes[0].childBounds(i));
+}
+
+float Tlas::childArea() const {
+    float area = 0;
+    for (const WideNode &node : m_bvh.nodes) {
+        for (int i = 0; i < WideArity; i++) area += node.childBounds(i).halfArea();
+    }
+    return area;
+}
+
+template<bool AnyHit>
+bool Tlas::traverse(const Ray &ray, Hit &hit, uint32_t &instanceIndex) const {
+    const TraversalRay worldRay(ray);
+    return bvh::traverse<AnyHit>(m_bvh, worldRay, hit, [&](uint32_t first, uint32_t count) {
+        bool found = false;
+        for (uint32_t i = first; i < first + count; i++) {
+            const uint32_t index = m_bvh.primitives[i];
+            const Instance &instance = m_instances[index];
+            const Shape &shape = m_shapes[instance.shape];
+            
+            /// the direction is not normalized, so distances along the ray are the same in both spaces
+            Ray objectRay = ray;
+            objectRay.origin = instance.worldToObject.point(ray.origin);
+            objectRay.direction = instance.worldToObject.vector(ray.direction);
+            const bool updated = shape.visit([&](const auto &bvh) {
+                return intersectBlas<AnyHit>(bvh, shape.mesh, TraversalRay(objectRay), hit);
+            });
+            if (updated) {
+                instanceIndex = index;
+                found = true;
+                if (AnyHit) break;
+            }
+        }
+        return found;
+    });
+}
+
+template<bool AnyHit>
+RayMask Tlas::traversePacket(const Ray *rays, Hit *hits, uint32_t *instanceIndices, RayMask active) const {
+    TraversalRay worldRays[PacketSize] = {};
+    for (RayMask remaining = active; remaining; remaining &= remaining - 1) {
+        const int i = __builtin_ctzll(remaining);
+        worldRays[i] = TraversalRay(rays[i]);
+    }
+    
+    return bvh::traversePacket<AnyHit>(m_bvh, worldRays, hits, active, [&](RayMask mask, uint32_t first, uint32_t count) {
+        RayMask found = 0;
+        TraversalRay objectRays[PacketSize];
+        for (uint32_t i = first; i < first + count; i++) {
+            const uint32_t index = m_bvh.primitives[i];
+            const Instance &instance = m_instances[index];
+            const Shape &shape = m_shapes[instance.shape];
+            
+            const RayMask pending = AnyHit ? mask & ~found : mask;
+            for (RayMask remaining = pending; remaining; remaining &= remaining - 1) {
+                const int ray = __builtin_ctzll(remaining);
+                Ray objectRay = rays[ray];
+                objectRay.origin = instance.worldToObject.point(rays[ray].origin);
+                objectRay.direction = instance.worldToObject.vector(rays[ray].direction);
+                objectRays[ray] = TraversalRay(objectRay);
+            }
+            
+            const RayMask updated = shape.visit([&](const auto &bvh) {
+                return intersectBlasPacket<AnyHit>(bvh, shape.mesh, objectRays, hits, pending);
+            });
+            for (RayMask remaining = updated; remaining; remaining &= remaining - 1) {
+                instanceIndices[__builtin_ctzll(remaining)] = index;
+            }
+            found |= updated;
+        }
+        return found;
+    });
+}
+
+void Tlas::intersect(const Ray &ray, DeviceIntersection &intersection) const {
+    Hit hit;
+    hit.distance = ray.maxDistance;
+    uint32_t instanceIndex = 0;
+    if (!traverse<false>(ray, hit, instanceIndex)) {
+        intersection.distance = MissDistance;
+        return;
+    }
+    
+    intersection.distance = hit.distance;
+    intersection.primitiveIndex = hit.primitive;
+    intersection.instanceIndex = instanceIndex;
+    /// same convention as `raytrace`, which converts Metal's barycentrics to `(1 - u - v, u)`
+    intersection.coordinates = { 1 - hit.u - hit.v, hit.u };
+}
+
+void Tlas::intersectAny(const Ray &ray, DeviceIntersection &intersection) const {
+    Hit hit;
+    hit.distance = ray.maxDistance;
+    uint32_t instanceIndex = 0;
+    intersection.distance = traverse<true>(ray, hit, instanceIndex) ? hit.distance : MissDistance;
+}
+
+namespace {
+
+/// rays are handed out in ranges of at most this size, so that threads work on neighboring rays (which tend to be coherent)
+constexpr size_t RayChunkSize = 1024;
+
+}
+
+void Tlas::intersect(const DeviceRay *rays, DeviceIntersection *intersections, size_t count) const {
+    ThreadPool::shared().parallelForRange(count, RayChunkSize, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            intersect(makeRay(rays[i]), intersections[i]);
+        }
+    });
+}
+
+void Tlas::intersectAny(const DeviceShadowRay *rays, DeviceIntersection *intersections, size_t count) const {
+    ThreadPool::shared().parallelForRange(count, RayChunkSize, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            intersectAny(makeRay(rays[i]), intersections[i]);
+        }
+    });
+}
+
+template<bool AnyHit, typename DeviceRayType>
+void Tlas::tracePacket(const DeviceRayType *rays, DeviceIntersection *intersections, int count) const {
+    assert(count <= PacketSize);
+    Ray packetRays[PacketSize];
+    Hit hits[PacketSize];
+    uint32_t instanceIndices[PacketSize];
+    for (int i = 0; i < count; i++) {
+        packetRays[i] = makeRay(rays[i]);
+        hits[i].distance = packetRays[i].maxDistance;
+    }
+    
+    const RayMask active = count == PacketSize ? ~RayMask(0) : (RayMask(1) << count) - 1;
+    const RayMask found = traversePacket<AnyHit>(packetRays, hits, instanceIndices, active);
+    for (int i = 0; i < count; i++) {
+        DeviceIntersection &intersection = intersections[i];
+        if (!(found >> i & 1)) {
+            intersection.distance = MissDistance;
+            continue;
+        }
+        
+        intersection.distance = hits[i].distance;
+        if (AnyHit) continue;
+        
+        intersection.primitiveIndex = hits[i].primitive;
+        intersection.instanceIndex = instanceIndices[i];
+        intersection.coordinates = { 1 - hits[i].u - hits[i].v, hits[i].u };
+    }
+}
+
+void Tlas::intersectPackets(const DeviceRay *rays, DeviceIntersection *intersections, size_t count) const {
+    ThreadPool::shared().parallelFor((count + PacketSize - 1) / PacketSize, [&](size_t packet) {
+        const size_t offset = packet * PacketSize;
+        tracePacket<false>(rays + offset, intersections + offset, int(std::min<size_t>(PacketSize, count - offset)));
+    });
+}
+
+void Tlas::intersectAnyPackets(const DeviceShadowRay *rays, DeviceIntersection *intersections, size_t count) const {
+    ThreadPool::shared().parallelFor((count + PacketSize - 1) / PacketSize, [&](size_t packet) {
+        const size_t offset = packet * PacketSize;
+        tracePacket<true>(rays + offset, intersections + offset, int(std::min<size_t>(PacketSize, count - offset)));
+    });
+}
+
+void Tlas::intersectPacket(const DeviceRay *rays, DeviceIntersection *intersections, int count) const {
+    tracePacket<false>(rays, intersections, count);
+}
+
+void Tlas::intersectAnyPacket(const DeviceShadowRay *rays, DeviceIntersection *intersections, int count) const {
+    tracePacket<true>(rays, intersections, count);
+}
+
+size_t Tlas::memoryUsage() const {
+    size_t size = m_bvh.memoryUsage() + m_instances.size() * sizeof(Instance);
+    for (const Shape &shape : m_shapes) size += shape.wide.memoryUsage() + shape.compressed.memoryUsage();
+    return size;
+}
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Bvh.hpp"
+#include "CompressedBvh.hpp"
+#include "PacketTraversal.hpp"
+#include "Transform.hpp"
+#include "Traversal.hpp"
+#include "WideBvh.hpp"
+
+#include <bridge/Ray.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace raymond::bvh {
+
+/// `Intersection.distance` of rays that did not hit anything, which both `handleIntersections` and `handleShadowRays` treat as a miss
+constexpr float MissDistance = -1;
+
+/** @returns query of the CPU intersectors for a ray of the wavefront buffers, either `DeviceRay` or `DeviceShadowRay` */
+template<typename DeviceRayType>
+Ray makeRay(const DeviceRayType &ray) {
+    return { ray.origin, ray.minDistance, ray.direction, ray.maxDistance };
+}
+
+/// Node format of the hierarchy of a shape
+enum class NodeLayout {
+    /// full precision child bounds, fastest to traverse
+    Wide,
+    /// child bounds quantized to 8 bits, see `CompressedNode`
+    Compressed,
+};
+
+/**
+ * Two level hierarchy that mirrors the Metal acceleration structures: one bottom level BVH per shape (see
+ * `ShapeBuilder`) and a top level BVH over the world bounds of all instances (see `EntityBuilder`). Instances only
+ * store their transforms, rays are transformed into object space when they enter an instance.
+ * Both levels are collapsed into eight-wide trees, whose children are tested against rays with AVX when available.
+ */
+class Tlas {
+public:
+    /**
+     * Shapes whose leaves are too large for `NodeLayout::Compressed` (see `isCompressible`) keep the wide layout.
+     * @returns index of the shape, which corresponds to the `shapeIndex` of `ShapeBuilder` if added in the same order
+     */
+    uint32_t addShape(const Mesh &mesh, const Bvh &blas, NodeLayout layout = NodeLayout::Wide);
+    
+    /**
+     * Adds a shape with `NodeLayout::Compressed` after permuting its faces into leaf order (see `reorderFaces`), so that
+     * its leaves reference face ranges without primitive indices. `indices` and `materials` (optional) are the writable
+     * face buffers that `mesh` reads from, `primitiveIndex` of hits refers to the new order.
+     */
+    uint32_t addShapeInLeafOrder(const Mesh &mesh, IndexTriplet *indices, MaterialIndex *materials, const Bvh &blas);
+    
+    /** @returns index of the instance, which corresponds to `instanceIndex` (and `PerInstanceData`) of `EntityBuilder` */
+    uint32_t addInstance(uint32_t shape, const Transform &objectToWorld);
+    
+    /// Builds the top level hierarchy, needs to be called after adding instances and before tracing
+    void build(const BuildSettings &settings = BuildSettings(), BuildStats *stats = nullptr);
+    
+    /**
+     * Changes the transforms of some instances and refits the top level hierarchy bottom-up, shape hierarchies are
+     * left untouched. Refitting keeps the topology of the tree, so its quality degrades as instances move away from
+     * where they were during `build`. The top level is rebuilt instead once its surface area exceeds
+     * `rebuildThreshold` times the area it had after the last build.
+     * @returns whether the top level hierarchy was rebuilt
+     */
+    bool updateInstances(const uint32_t *instances, const Transform *objectToWorld, size_t count, float rebuildThreshold = 1.5f);
+    
+    /// Nearest hit with the same outputs as the `raytrace` kernel
+    void intersect(const Ray &ray, DeviceIntersection &intersection) const;
+    /// Occlusion query with the same outputs as the `raytraceAny` kernel (only `distance` is written)
+    void intersectAny(const Ray &ray, DeviceIntersection &intersection) const;
+    
+    /// Traces a whole ray buffer on `ThreadPool::shared()`, the CPU counterpart of dispatching `raytrace`
+    void intersect(const DeviceRay *rays, DeviceIntersection *intersections, size_t count) const;
+    /// Traces a whole shadow ray buffer on `ThreadPool::shared()`, the CPU counterpart of dispatching `raytraceAny`
+    void intersectAny(const DeviceShadowRay *rays, DeviceIntersection *intersections, size_t count) const;
+    
+    /**
+     * Same results as tracing a ray buffer, but consecutive rays are traversed together in packets of `PacketSize`.
+     * Meant for buffers whose neighboring rays are coherent, like the camera rays (and their shadow rays) that
+     * `generateRays` writes in tile order. Packets that diverge fall back to single ray traversal.
+     */
+    void intersectPackets(const DeviceRay *rays, DeviceIntersection *intersections, size_t count) const;
+    void intersectAnyPackets(const DeviceShadowRay *rays, DeviceIntersection *intersections, size_t count) const;
+    
+    /**
+     * Traces a single packet of at most `PacketSize` rays on the calling thread, the unit of work that
+     * `intersectPackets` hands out. For callers that already run on `ThreadPool::shared()` and would only pay for
+     * another dispatch, like the tiles of the megakernel.
+     */
+    void intersectPacket(const DeviceRay *rays, DeviceIntersection *intersections, int count) const;
+    void intersectAnyPacket(const DeviceShadowRay *rays, DeviceIntersection *intersections, int count) const;
+    
+    size_t shapeCount() const { return m_shapes.size(); }
+    size_t instanceCount() const { return m_instances.size(); }
+    Bounds bounds() const { return m_bvh.bounds; }
+    
+    /** @returns bytes used by all hierarchies and instance data, without the geometry they refer to */
+    size_t memoryUsage() const;
+
+private:
+    struct Shape {
+        Mesh mesh;
+        NodeLayout layout;
+        /// only the hierarchy matching `layout` is populated
+        WideBvh wide;
+        CompressedBvh compressed;
+        
+        const Bounds &bounds() const { return layout == NodeLayout::Wide ? wide.bounds : compressed.bounds; }
+        
+        /** @returns `f(bvh)` for the populated hierarchy */
+        template<typename F>
+        auto visit(F f) const { return layout == NodeLayout::Wide ? f(wide) : f(compressed); }
+    };
+    
+    struct Instance {
+        uint32_t shape;
+        Transform objectToWorld;
+        Transform worldToObject;
+        Bounds worldBounds;
+    };
+    
+    /** @returns summed half area of all children of the top level, a cheap proxy for its SAH cost */
+    float childArea() const;
+    void refit();
+    
+    template<bool AnyHit>
+    bool traverse(const Ray &ray, Hit &hit, uint32_t &instanceIndex) const;
+    template<bool AnyHit>
+    RayMask traversePacket(const Ray *rays, Hit *hits, uint32_t *instanceIndices, RayMask active) const;
+    template<bool AnyHit, typename DeviceRayType>
+    void tracePacket(const DeviceRayType *rays, DeviceIntersection *intersections, int count) const;
+    
+    std::vector<Shape> m_shapes;
+    std::vector<Instance> m_instances;
+    WideBvh m_bvh;
+    BuildSettings m_settings;
+    float m_builtArea = 0;
+};
+
+}
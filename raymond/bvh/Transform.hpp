@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Bounds.hpp"
+
+namespace raymond::bvh {
+
+/// Affine transformation stored as the four columns of a 4x3 matrix, the same layout as `MTLPackedFloat4x3`
+struct Transform {
+    Vec3 columns[4];
+    
+    static Transform identity() {
+        return {{ Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1), Vec3(0) }};
+    }
+    
+    /// Takes the upper 4x3 part of a column major 4x4 matrix, as used for `PerInstanceData.pointTransform`
+    static Transform fromColumnMajor(const float (&matrix)[16]) {
+        Transform result;
+        for (int column = 0; column < 4; column++) {
+            result.columns[column] = Vec3(matrix[4 * column], matrix[4 * column + 1], matrix[4 * column + 2]);
+        }
+        return result;
+    }
+    
+    Vec3 point(const Vec3 &p) const {
+        return columns[0] * p.x + columns[1] * p.y + columns[2] * p.z + columns[3];
+    }
+    
+    Vec3 vector(const Vec3 &v) const {
+        return columns[0] * v.x + columns[1] * v.y + columns[2] * v.z;
+    }
+    
+    Transform inverse() const {
+        const Vec3 &a = columns[0], &b = columns[1], &c = columns[2];
+        const Vec3 r0 = cross(b, c), r1 = cross(c, a), r2 = cross(a, b);
+        const float inverseDeterminant = 1 / dot(a, r0);
+        
+        /// rows of the inverse of the linear part are the cross products divided by the determinant
+        Transform result;
+        result.columns[0] = Vec3(r0.x, r1.x, r2.x) * inverseDeterminant;
+        result.columns[1] = Vec3(r0.y, r1.y, r2.y) * inverseDeterminant;
+        result.columns[2] = Vec3(r0.z, r1.z, r2.z) * inverseDeterminant;
+        result.columns[3] = -result.vector(columns[3]);
+        return result;
+    }
+    
+    /** @returns bounds of the transformed box (Arvo's method) */
+    Bounds apply(const Bounds &bounds) const {
+        if (bounds.isEmpty()) return bounds;
+        
+        Bounds result(columns[3], columns[3]);
+        for (int column = 0; column < 3; column++) {
+            const Vec3 a = columns[column] * bounds.min[column];
+            const Vec3 b = columns[column] * bounds.max[column];
+            result.min = result.min + bvh::min(a, b);
+            result.max = result.max + bvh::max(a, b);
+        }
+        return result;
+    }
+};
+
+}
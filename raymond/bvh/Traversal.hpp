@@ -0,0 +1,430 @@
+#pragma once
+
+#include "CompressedBvh.hpp"
+#include "WideBvh.hpp"
+
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace raymond::bvh {
+
+/// Query of the CPU intersectors, mirrors `metal::raytracing::ray`
+struct Ray {
+    Vec3 origin;
+    float minDistance;
+    Vec3 direction;
+    float maxDistance;
+};
+
+/// Closest hit found so far, `distance` starts out as the maximum distance of the ray
+struct Hit {
+    float distance;
+    /// barycentric coordinates of vertices 1 and 2, i.e. `triangle_barycentric_coord` in Metal
+    float u, v;
+    uint32_t primitive = UINT32_MAX;
+    
+    bool isValid() const { return primitive != UINT32_MAX; }
+};
+
+/// Ray with precomputed reciprocal direction for slab tests and shear for watertight triangle tests
+struct TraversalRay {
+    Vec3 origin;
+    Vec3 direction;
+    Vec3 inverseDirection;
+    float minDistance;
+    /// whether the ray travels towards smaller coordinates, in which case it enters boxes through their maximum
+    bool isNegative[3];
+    
+    /// axes permuted so that `kz` is the largest component of the direction, with `kx` and `ky` keeping the winding
+    int kx, ky, kz;
+    /// shear that maps the direction onto the unit z axis of the permuted space
+    float shearX, shearY, shearZ;
+    
+    TraversalRay() = default;
+    explicit TraversalRay(const Ray &ray)
+    : origin(ray.origin), direction(ray.direction), minDistance(ray.minDistance) {
+        for (int dim = 0; dim < 3; dim++) {
+            /// avoid NaNs from `0 * inf` in the slab test by replacing zero with a tiny value
+            const float d = std::abs(direction[dim]) > 1e-30f ? direction[dim] : std::copysign(1e-30f, direction[dim]);
+            inverseDirection[dim] = 1 / d;
+            isNegative[dim] = d < 0;
+        }
+        
+        const Vec3 magnitude(std::abs(direction.x), std::abs(direction.y), std::abs(direction.z));
+        kz = magnitude.x >= magnitude.y && magnitude.x >= magnitude.z ? 0 : magnitude.y >= magnitude.z ? 1 : 2;
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        if (direction[kz] < 0) std::swap(kx, ky);
+        
+        shearX = direction[kx] / direction[kz];
+        shearY = direction[ky] / direction[kz];
+        shearZ = 1 / direction[kz];
+    }
+};
+
+/// Up to `WideArity` triangles with their vertices stored as structure of arrays, so that a ray can be tested against all of them at once
+struct alignas(32) TriangleBatch {
+    /// vertices of the triangles, indexed by `[axis][triangle]`
+    float p0[3][WideArity];
+    float p1[3][WideArity];
+    float p2[3][WideArity];
+    uint32_t primitives[WideArity];
+    int count = 0;
+    
+    void add(uint32_t primitive, const Vec3 &v0, const Vec3 &v1, const Vec3 &v2) {
+        for (int axis = 0; axis < 3; axis++) {
+            p0[axis][count] = v0[axis];
+            p1[axis][count] = v1[axis];
+            p2[axis][count] = v2[axis];
+        }
+        primitives[count++] = primitive;
+    }
+    
+    /// Fills unused slots with degenerate triangles, which no ray can hit
+    void pad() {
+        for (int i = count; i < WideArity; i++) {
+            for (int axis = 0; axis < 3; axis++) p0[axis][i] = p1[axis][i] = p2[axis][i] = 0;
+        }
+    }
+};
+
+/** Gathers the triangles of `count` (at most `WideArity`) consecutive primitives of a leaf into a batch */
+template<typename Tree>
+void gatherTriangles(const Tree &bvh, const Mesh &mesh, uint32_t first, uint32_t count, TriangleBatch &batch) {
+    batch.count = 0;
+    for (uint32_t i = first; i < first + count; i++) {
+        const uint32_t primitive = bvh.primitive(i);
+        Vertex v0, v1, v2;
+        mesh.corners(primitive, v0, v1, v2);
+        batch.add(primitive, v0, v1, v2);
+    }
+    batch.pad();
+}
+
+/**
+ * Forces a product to be rounded before it is used, so that it cannot be fused into an FMA. GCC fuses across
+ * statements by default, clang only within a single expression, which the triangle tests already avoid.
+ */
+template<typename T>
+inline T unfused(T value) {
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+    asm("" : "+x"(value));
+#elif defined(__GNUC__) && !defined(__clang__) && defined(__aarch64__)
+    asm("" : "+w"(value));
+#endif
+    return value;
+}
+
+/// Edge functions of a triangle in the sheared space of a ray, all values still need to be divided by `determinant`
+template<typename Float>
+struct EdgeFunctions {
+    /// weights of vertices 0, 1 and 2
+    Float u, v, w;
+    Float determinant;
+    Float distance;
+};
+
+/**
+ * Evaluates the watertight test of Woop et al. 2013 for one triangle of a batch. The vertices are translated to the
+ * ray origin and sheared so that the ray runs along the z axis, which reduces the test to the signs of 2D edge
+ * functions. Vertices are always transformed in single precision, so that triangles sharing them see the same
+ * coordinates, only the edge functions are evaluated in `Float`. Products are not fused (see `unfused`), as fusing
+ * would break the symmetry between the edge functions of neighboring triangles.
+ */
+template<typename Float>
+EdgeFunctions<Float> edgeFunctions(const TraversalRay &ray, const TriangleBatch &batch, int i) {
+    auto translate = [&](const float (&p)[3][WideArity], int axis) {
+        return p[axis][i] - ray.origin[axis];
+    };
+    auto shear = [&](const float (&p)[3][WideArity], int axis, float shear, float z) {
+        const float offset = unfused(shear * z);
+        return translate(p, axis) - offset;
+    };
+    auto edge = [](Float px, Float py, Float qx, Float qy) {
+        const Float first = unfused(px * qy);
+        const Float second = unfused(py * qx);
+        return first - second;
+    };
+    
+    const float az = translate(batch.p0, ray.kz), bz = translate(batch.p1, ray.kz), cz = translate(batch.p2, ray.kz);
+    const float ax = shear(batch.p0, ray.kx, ray.shearX, az), ay = shear(batch.p0, ray.ky, ray.shearY, az);
+    const float bx = shear(batch.p1, ray.kx, ray.shearX, bz), by = shear(batch.p1, ray.ky, ray.shearY, bz);
+    const float cx = shear(batch.p2, ray.kx, ray.shearX, cz), cy = shear(batch.p2, ray.ky, ray.shearY, cz);
+    
+    EdgeFunctions<Float> result;
+    result.u = edge(cx, cy, bx, by);
+    result.v = edge(ax, ay, cx, cy);
+    result.w = edge(bx, by, ax, ay);
+    result.determinant = result.u + result.v + result.w;
+    
+    const float shearedAz = az * ray.shearZ, shearedBz = bz * ray.shearZ, shearedCz = cz * ray.shearZ;
+    const Float du = unfused(result.u * shearedAz);
+    const Float dv = unfused(result.v * shearedBz);
+    const Float dw = unfused(result.w * shearedCz);
+    result.distance = du + dv + dw;
+    return result;
+}
+
+/**
+ * Completes the watertight test of one triangle. Edge functions that round to zero (the ray passes through or very
+ * close to an edge or vertex) are recomputed in double precision, which is exact for products of floats.
+ * @returns whether the triangle is hit before `maxDistance`, in which case `t`, `u` and `v` are written
+ */
+inline bool finishTriangle(const TraversalRay &ray, const TriangleBatch &batch, int i, float maxDistance, float &t, float &u, float &v) {
+    EdgeFunctions<float> e = edgeFunctions<float>(ray, batch, i);
+    if (e.u == 0 || e.v == 0 || e.w == 0) {
+        const EdgeFunctions<double> precise = edgeFunctions<double>(ray, batch, i);
+        if ((precise.u < 0 || precise.v < 0 || precise.w < 0) && (precise.u > 0 || precise.v > 0 || precise.w > 0)) return false;
+        e = { float(precise.u), float(precise.v), float(precise.w), float(precise.determinant), float(precise.distance) };
+    } else if ((e.u < 0 || e.v < 0 || e.w < 0) && (e.u > 0 || e.v > 0 || e.w > 0)) {
+        return false;
+    }
+    
+    if (e.determinant == 0) return false;
+    const float inverseDeterminant = 1 / e.determinant;
+    const float distance = e.distance * inverseDeterminant;
+    if (!(distance >= ray.minDistance && distance < maxDistance)) return false;
+    
+    t = distance;
+    u = e.v * inverseDeterminant;
+    v = e.w * inverseDeterminant;
+    return true;
+}
+
+/**
+ * Watertight test of a ray against all triangles of a batch at once, rays cannot slip between triangles that share an
+ * edge. The barycentrics written to `hit` weigh vertices 1 and 2 like `triangle_barycentric_coord` in Metal.
+ * @returns index of the closest triangle that is closer than `hit`, which is updated (including `primitive`), or -1
+ */
+inline int intersectTriangles(const TraversalRay &ray, const TriangleBatch &batch, Hit &hit) {
+    float t[WideArity], u[WideArity], v[WideArity];
+    const unsigned lanes = (1u << batch.count) - 1;
+    unsigned mask = 0;
+
+#if defined(__AVX__)
+    auto translate = [&](const float (&p)[3][WideArity], int axis) {
+        return _mm256_sub_ps(_mm256_load_ps(p[axis]), _mm256_set1_ps(ray.origin[axis]));
+    };
+    auto shear = [&](const float (&p)[3][WideArity], int axis, float shear, __m256 z) {
+        return _mm256_sub_ps(translate(p, axis), unfused(_mm256_mul_ps(_mm256_set1_ps(shear), z)));
+    };
+    auto edge = [](__m256 px, __m256 py, __m256 qx, __m256 qy) {
+        return _mm256_sub_ps(unfused(_mm256_mul_ps(px, qy)), unfused(_mm256_mul_ps(py, qx)));
+    };
+    
+    const __m256 az = translate(batch.p0, ray.kz), bz = translate(batch.p1, ray.kz), cz = translate(batch.p2, ray.kz);
+    const __m256 ax = shear(batch.p0, ray.kx, ray.shearX, az), ay = shear(batch.p0, ray.ky, ray.shearY, az);
+    const __m256 bx = shear(batch.p1, ray.kx, ray.shearX, bz), by = shear(batch.p1, ray.ky, ray.shearY, bz);
+    const __m256 cx = shear(batch.p2, ray.kx, ray.shearX, cz), cy = shear(batch.p2, ray.ky, ray.shearY, cz);
+    
+    const __m256 eu = edge(cx, cy, bx, by);
+    const __m256 ev = edge(ax, ay, cx, cy);
+    const __m256 ew = edge(bx, by, ax, ay);
+    const __m256 determinant = _mm256_add_ps(_mm256_add_ps(eu, ev), ew);
+    
+    const __m256 shearZ = _mm256_set1_ps(ray.shearZ);
+    const __m256 scaledDistance = _mm256_add_ps(_mm256_add_ps(
+        unfused(_mm256_mul_ps(eu, _mm256_mul_ps(az, shearZ))),
+        unfused(_mm256_mul_ps(ev, _mm256_mul_ps(bz, shearZ)))),
+        unfused(_mm256_mul_ps(ew, _mm256_mul_ps(cz, shearZ))));
+    
+    const __m256 zero = _mm256_setzero_ps();
+    /// the predicate is passed as a type, since `_mm256_cmp_ps` needs an immediate even in unoptimized builds
+    auto any = [&](auto predicate) {
+        constexpr int Predicate = decltype(predicate)::value;
+        return _mm256_or_ps(_mm256_or_ps(
+            _mm256_cmp_ps(eu, zero, Predicate), _mm256_cmp_ps(ev, zero, Predicate)), _mm256_cmp_ps(ew, zero, Predicate));
+    };
+    using Equal = std::integral_constant<int, _CMP_EQ_OQ>;
+    using Less = std::integral_constant<int, _CMP_LT_OQ>;
+    using Greater = std::integral_constant<int, _CMP_GT_OQ>;
+    const unsigned onEdge = unsigned(_mm256_movemask_ps(any(Equal()))) & lanes;
+    
+    const __m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1), determinant);
+    const __m256 distance = _mm256_mul_ps(scaledDistance, inverseDeterminant);
+    __m256 valid = _mm256_andnot_ps(_mm256_and_ps(any(Less()), any(Greater())), _mm256_cmp_ps(determinant, zero, _CMP_NEQ_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(distance, _mm256_set1_ps(ray.minDistance), _CMP_GE_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(distance, _mm256_set1_ps(hit.distance), _CMP_LT_OQ));
+    
+    _mm256_storeu_ps(t, distance);
+    _mm256_storeu_ps(u, _mm256_mul_ps(ev, inverseDeterminant));
+    _mm256_storeu_ps(v, _mm256_mul_ps(ew, inverseDeterminant));
+    mask = unsigned(_mm256_movemask_ps(valid)) & lanes & ~onEdge;
+    
+    /// rays through edges and vertices are rare, those triangles are finished one at a time
+    for (unsigned remaining = onEdge; remaining; remaining &= remaining - 1) {
+        const int i = __builtin_ctz(remaining);
+        if (finishTriangle(ray, batch, i, hit.distance, t[i], u[i], v[i])) mask |= 1u << i;
+    }
+#else
+    /// plain loop over the triangles, which compilers turn into NEON or SSE code
+    for (int i = 0; i < batch.count; i++) {
+        if (finishTriangle(ray, batch, i, hit.distance, t[i], u[i], v[i])) mask |= 1u << i;
+    }
+#endif
+
+    int closest = -1;
+    for (; mask; mask &= mask - 1) {
+        const int i = __builtin_ctz(mask);
+        if (closest < 0 || t[i] < t[closest]) closest = i;
+    }
+    if (closest < 0) return -1;
+    
+    hit.distance = t[closest];
+    hit.u = u[closest];
+    hit.v = v[closest];
+    hit.primitive = batch.primitives[closest];
+    return closest;
+}
+
+/**
+ * Exit distances of slab tests are scaled by `1 + 2 * gamma(3)` to cover the rounding of the subtraction and product
+ * (Ize 2013), otherwise rays that graze the bounds of a triangle can miss its node even though they hit the triangle.
+ */
+constexpr float SlabExitScale = 1 + 2 * (3 * 0x1p-24f / (1 - 3 * 0x1p-24f));
+
+/**
+ * Tests the ray against the bounds of all children of a wide node at once, given as structure of arrays.
+ * @returns bit mask of the children the ray enters before `maxDistance`, their entry distances are written to `entry`
+ */
+inline unsigned enterChildren(
+    const float (&min)[3][WideArity], const float (&max)[3][WideArity],
+    const TraversalRay &ray, float maxDistance, float (&entry)[WideArity]
+) {
+    /// using the far plane of empty slots as near plane makes sure that rays never enter them
+    const float *near[3], *far[3];
+    for (int axis = 0; axis < 3; axis++) {
+        near[axis] = ray.isNegative[axis] ? max[axis] : min[axis];
+        far[axis] = ray.isNegative[axis] ? min[axis] : max[axis];
+    }
+
+#if defined(__AVX__)
+    __m256 entryDistance = _mm256_set1_ps(ray.minDistance);
+    __m256 exitDistance = _mm256_set1_ps(maxDistance);
+    const __m256 exitScale = _mm256_set1_ps(SlabExitScale);
+    for (int axis = 0; axis < 3; axis++) {
+        const __m256 origin = _mm256_set1_ps(ray.origin[axis]);
+        const __m256 inverseDirection = _mm256_set1_ps(ray.inverseDirection[axis]);
+        const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(near[axis]), origin), inverseDirection);
+        const __m256 t1 = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(far[axis]), origin), inverseDirection), exitScale);
+        entryDistance = _mm256_max_ps(entryDistance, t0);
+        exitDistance = _mm256_min_ps(exitDistance, t1);
+    }
+    _mm256_storeu_ps(entry, entryDistance);
+    return unsigned(_mm256_movemask_ps(_mm256_cmp_ps(entryDistance, exitDistance, _CMP_LE_OQ)));
+#else
+    /// plain loop over the lanes, which compilers turn into NEON or SSE code
+    unsigned mask = 0;
+    for (int i = 0; i < WideArity; i++) {
+        float entryDistance = ray.minDistance;
+        float exitDistance = maxDistance;
+        for (int axis = 0; axis < 3; axis++) {
+            entryDistance = std::max(entryDistance, (near[axis][i] - ray.origin[axis]) * ray.inverseDirection[axis]);
+            exitDistance = std::min(exitDistance, (far[axis][i] - ray.origin[axis]) * ray.inverseDirection[axis] * SlabExitScale);
+        }
+        entry[i] = entryDistance;
+        mask |= unsigned(entryDistance <= exitDistance) << i;
+    }
+    return mask;
+#endif
+}
+
+inline unsigned enterChildren(const WideNode &node, const TraversalRay &ray, float maxDistance, float (&entry)[WideArity]) {
+    return enterChildren(node.min, node.max, ray, maxDistance, entry);
+}
+
+inline unsigned enterChildren(const CompressedNode &node, const TraversalRay &ray, float maxDistance, float (&entry)[WideArity]) {
+    alignas(32) float min[3][WideArity], max[3][WideArity];
+    node.decode(min, max);
+    return enterChildren(min, max, ray, maxDistance, entry);
+}
+
+/**
+ * Visits the leaves of a wide BVH (`WideBvh` or `CompressedBvh`) that the ray enters before `hit.distance`. For nearest hit queries children are
+ * visited front to back, so that hits cull as much of the tree as possible.
+ * `leaf(first, count)` intersects the primitives of a leaf and returns whether it updated `hit`. Traversal can start at
+ * any inner node `root`, which lets packet traversal hand subtrees over to single rays.
+ * @returns whether any leaf updated `hit`, traversal stops at the first such leaf if `AnyHit` is set
+ */
+template<bool AnyHit, typename Tree, typename Leaf>
+bool traverse(const Tree &bvh, const TraversalRay &ray, Hit &hit, Leaf leaf, uint32_t root = 0) {
+    if (bvh.nodes.empty()) return false;
+    
+    /// children that still need to be visited together with the distance at which the ray enters them
+    struct Entry {
+        uint32_t first;
+        uint32_t count;
+        float distance;
+    };
+    /// every level adds at most `WideArity - 1` entries to the stack
+    Entry stack[MaxDepth * (WideArity - 1) + 1];
+    int stackSize = 0;
+    stack[stackSize++] = { root, 0, ray.minDistance };
+    
+    bool found = false;
+    while (stackSize > 0) {
+        const Entry entry = stack[--stackSize];
+        
+        /// skip children that are further away than a hit found after they were pushed
+        if (entry.distance > hit.distance) continue;
+        
+        if (entry.count > 0) {
+            if (leaf(entry.first, entry.count)) {
+                found = true;
+                if (AnyHit) return true;
+            }
+            continue;
+        }
+        
+        const auto &node = bvh.nodes[entry.first];
+        float distances[WideArity];
+        unsigned mask = enterChildren(node, ray, hit.distance, distances);
+        
+        const int firstChild = stackSize;
+        while (mask) {
+            const int i = __builtin_ctz(mask);
+            mask &= mask - 1;
+            
+            Entry child = { node.childFirst(i), node.childCount(i), distances[i] };
+            if (AnyHit) {
+                stack[stackSize++] = child;
+                continue;
+            }
+            
+            /// insertion sort, so that the nearest child ends up on top of the stack
+            int position = stackSize++;
+            while (position > firstChild && stack[position - 1].distance < child.distance) {
+                stack[position] = stack[position - 1];
+                position--;
+            }
+            stack[position] = child;
+        }
+    }
+    return found;
+}
+
+/**
+ * Finds the closest triangle of a shape (or any triangle if `AnyHit` is set) within `hit.distance`.
+ * @returns whether `hit` was updated
+ */
+template<bool AnyHit, typename Tree>
+bool intersectBlas(const Tree &bvh, const Mesh &mesh, const TraversalRay &ray, Hit &hit) {
+    return traverse<AnyHit>(bvh, ray, hit, [&](uint32_t first, uint32_t count) {
+        bool found = false;
+        for (uint32_t offset = 0; offset < count; offset += WideArity) {
+            TriangleBatch batch;
+            gatherTriangles(bvh, mesh, first + offset, std::min<uint32_t>(WideArity, count - offset), batch);
+            if (intersectTriangles(ray, batch, hit) >= 0) {
+                found = true;
+                if (AnyHit) break;
+            }
+        }
+        return found;
+    });
+}
+
+}
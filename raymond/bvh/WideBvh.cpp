@@ -0,0 +1,91 @@
+#include "WideBvh.hpp"
+
+namespace raymond::bvh {
+
+namespace {
+
+struct Collapser {
+    const Bvh &bvh;
+    WideBvh &result;
+    
+    /// fills the wide node at `index` with the descendants of the binary inner node `node`
+    void build(uint32_t index, const Node &node) {
+        uint32_t children[WideArity] = { node.first, node.first + 1 };
+        int childCount = 2;
+        
+        while (childCount < WideArity) {
+            int largest = -1;
+            float largestArea = -1;
+            for (int i = 0; i < childCount; i++) {
+                const Node &child = bvh.nodes[children[i]];
+                if (child.isLeaf()) continue;
+                
+                const float area = child.bounds.halfArea();
+                if (area > largestArea) {
+                    largest = i;
+                    largestArea = area;
+                }
+            }
+            if (largest < 0) break;
+            
+            const uint32_t opened = bvh.nodes[children[largest]].first;
+            children[largest] = opened;
+            children[childCount++] = opened + 1;
+        }
+        
+        /// slots are written before recursing, as the recursion may reallocate the node array
+        uint32_t childIndices[WideArity];
+        for (int i = 0; i < WideArity; i++) {
+            WideNode &wide = result.nodes[index];
+            wide.setChildBounds(i, i < childCount ? bvh.nodes[children[i]].bounds : Bounds());
+            
+            wide.first[i] = 0;
+            wide.count[i] = 0;
+            if (i >= childCount) continue;
+            
+            const Node &child = bvh.nodes[children[i]];
+            if (child.isLeaf()) {
+                wide.first[i] = child.first;
+                wide.count[i] = child.count;
+            } else {
+                childIndices[i] = uint32_t(result.nodes.size());
+                wide.first[i] = childIndices[i];
+                result.nodes.emplace_back();
+            }
+        }
+        
+        for (int i = 0; i < childCount; i++) {
+            const Node &child = bvh.nodes[children[i]];
+            if (!child.isLeaf()) build(childIndices[i], child);
+        }
+    }
+};
+
+}
+
+WideBvh collapse(const Bvh &bvh) {
+    WideBvh result;
+    result.primitives = bvh.primitives;
+    result.bounds = bvh.bounds();
+    if (bvh.nodes.empty()) return result;
+    
+    result.nodes.reserve(bvh.nodes.size() / 4 + 1);
+    result.nodes.emplace_back();
+    
+    const Node &root = bvh.nodes[0];
+    if (root.isLeaf()) {
+        /// a single leaf still needs a node so that traversal does not need a special case
+        WideNode &wide = result.nodes[0];
+        for (int i = 0; i < WideArity; i++) {
+            wide.setChildBounds(i, i == 0 ? root.bounds : Bounds());
+            wide.first[i] = i == 0 ? root.first : 0;
+            wide.count[i] = i == 0 ? root.count : 0;
+        }
+        return result;
+    }
+    
+    Collapser { bvh, result }.build(0, root);
+    return result;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Bvh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace raymond::bvh {
+
+/// Maximum number of children of a wide node, matches the lane count of AVX2
+constexpr int WideArity = 8;
+
+/**
+ * Node with up to eight children whose bounds are stored as structure of arrays, so that a ray can be tested against
+ * all of them at once. Unused slots have empty bounds, which no ray can enter.
+ */
+struct alignas(32) WideNode {
+    /// bounds of the children, indexed by `[axis][child]`
+    float min[3][WideArity];
+    float max[3][WideArity];
+    /// index of the child node for inner children, first entry in `primitives` for leaves, zero for unused slots
+    uint32_t first[WideArity];
+    /// number of primitives of leaf children, zero for inner children and unused slots
+    uint32_t count[WideArity];
+    
+    uint32_t childFirst(int child) const { return first[child]; }
+    uint32_t childCount(int child) const { return count[child]; }
+    
+    Bounds childBounds(int child) const {
+        return {
+            Vec3(min[0][child], min[1][child], min[2][child]),
+            Vec3(max[0][child], max[1][child], max[2][child])
+        };
+    }
+    
+    void setChildBounds(int child, const Bounds &bounds) {
+        for (int axis = 0; axis < 3; axis++) {
+            min[axis][child] = bounds.min[axis];
+            max[axis][child] = bounds.max[axis];
+        }
+    }
+};
+
+/// BVH with eight children per node, the root is node 0
+struct WideBvh {
+    std::vector<WideNode> nodes;
+    /// indices of the primitives referenced by leaves
+    std::vector<uint32_t> primitives;
+    Bounds bounds;
+    
+    uint32_t primitive(uint32_t index) const { return primitives[index]; }
+    
+    size_t memoryUsage() const {
+        return nodes.size() * sizeof(WideNode) + primitives.size() * sizeof(uint32_t);
+    }
+};
+
+/**
+ * Collapses a binary BVH into a wide one by repeatedly replacing the inner child with the largest surface area by its
+ * own children until a node is full. Leaves are kept as they are, so the primitive order is unchanged.
+ */
+WideBvh collapse(const Bvh &bvh);
+
+}
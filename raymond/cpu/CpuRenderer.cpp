@@ -0,0 +1,585 @@
+#include "CpuRenderer.hpp"
+
+#include <utils/ThreadPool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace raymond::cpu {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// width and height of the tiles of `generateRays`, the threadgroup size it is dispatched with
+constexpr uint32_t TileSize = 8;
+
+/// most rays per task of the shading stages, each task reserves space in the next ray buffers with a single atomic
+constexpr uint32_t ShadingChunkSize = 256;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+float computeMisWeight(float pdf, float other) {
+    pdf *= pdf;
+    if (std::isinf(pdf)) return 1;
+    
+    other *= other;
+    return pdf / (pdf + other);
+}
+
+// MARK: Tonemapping, see normalizeImage.metal
+
+Vec3 tonemapHablePartial(const Vec3 &x) {
+    const float hA = 0.15f;
+    const float hB = 0.50f;
+    const float hC = 0.10f;
+    const float hD = 0.20f;
+    const float hE = 0.02f;
+    const float hF = 0.30f;
+    auto channel = [&](float x) {
+        return ((x*(hA*x+hC*hB)+hD*hE) / (x*(hA*x+hB)+hD*hF)) - hE/hF;
+    };
+    return { channel(x.x), channel(x.y), channel(x.z) };
+}
+
+Vec3 tonemapHable(const Vec3 &x) {
+    const float exposureBias = 2.0f;
+    const Vec3 curr = tonemapHablePartial(x * exposureBias);
+    
+    const Vec3 W(11.2f);
+    const Vec3 whiteScale = tonemapHablePartial(W);
+    return { curr.x / whiteScale.x, curr.y / whiteScale.y, curr.z / whiteScale.z };
+}
+
+Vec3 tonemapAces(const Vec3 &x) {
+    const float tA = 2.51f;
+    const float tB = 0.03f;
+    const float tC = 2.43f;
+    const float tD = 0.59f;
+    const float tE = 0.14f;
+    auto channel = [&](float x) {
+        return std::min(std::max((x*(tA*x+tB))/(x*(tC*x+tD)+tE), 0.f), 1.f);
+    };
+    return { channel(x.x), channel(x.y), channel(x.z) };
+}
+
+}
+
+// MARK: - Report
+
+void Report::print(std::FILE *file) const {
+    std::fprintf(file, "Statistics\t%6.0lf us\t%6.0lf us\t%6.1f FPS\n",
+        reportedTime * 1e+6,
+        totalTime * 1e+6,
+        1 / totalTime);
+    for (const Section &section : sections) {
+        std::fprintf(file, "\n* %s\t%6.0lf us\t(%5.1f %%)\n",
+            section.name.c_str(),
+            section.reportedTime * 1e+6,
+            100 * section.reportedTime / reportedTime);
+        for (const Entry &entry : section.entries) {
+            std::fprintf(file, "  * %s\t%6.0lf us\t%7.1lf kray\t%7.1lf Mray/s\n",
+                entry.name.c_str(),
+                entry.time * 1e+6,
+                double(entry.rays) / 1e+3,
+                entry.time > 0 ? (double(entry.rays) / entry.time) / 1e+6 : 0);
+        }
+    }
+    std::fprintf(file, "\n");
+}
+
+// MARK: - Renderer
+
+/// Rays that `handleIntersection` emits, into buffers with room for one ray of each kind per shaded ray
+struct Renderer::Emitted {
+    DeviceRay *rays;
+    DeviceShadowRay *shadowRays;
+    uint32_t rayCount = 0;
+    uint32_t shadowRayCount = 0;
+};
+
+Renderer::Renderer(const Scene &scene, int maxDepth)
+: m_scene(scene), m_maxDepth(maxDepth),
+  m_rayCounts(new std::atomic<uint32_t>[maxDepth + 1]),
+  m_shadowRayCounts(new std::atomic<uint32_t>[maxDepth]) {
+    uniforms = DeviceUniforms();
+    uniforms.numLensSurfaces = 0;
+    uniforms.frameIndex = 0;
+    uniforms.randomSeed = 0;
+    uniforms.accumulate = true;
+    uniforms.lensSpectral = true;
+    uniforms.sensorScale = 1;
+    uniforms.cameraScale = 0.001f;
+    uniforms.focus = 0;
+    uniforms.exposure = 1;
+    uniforms.stopIndex = 0;
+    uniforms.relativeStop = 1;
+    uniforms.numApertureBlades = 7;
+    uniforms.samplingMode = SamplingModeMis;
+    uniforms.tonemapping = TonemappingLinear;
+    uniforms.rr = RussianRouletteThroughput;
+    uniforms.rrDepth = 0;
+    uniforms.outputChannel = OutputChannelImage;
+    
+    for (int depth = 0; depth <= maxDepth; depth++) m_rayCounts[depth] = 0;
+    for (int depth = 0; depth < maxDepth; depth++) m_shadowRayCounts[depth] = 0;
+}
+
+void Renderer::resize(uint32_t width, uint32_t height) {
+    m_width = width;
+    m_height = height;
+    
+    const size_t rayCount = size_t(width) * height;
+    m_rays.resize(2 * rayCount);
+    m_shadowRays.resize(rayCount);
+    m_intersections.resize(rayCount);
+    m_order.resize(rayCount);
+    m_reorderedRays.resize(rayCount);
+    m_normalizedImage.assign(rayCount, simd_float4());
+    reset();
+}
+
+void Renderer::reset() {
+    m_frameIndex = 0;
+    m_image.assign(size_t(m_width) * m_height, simd_float4());
+}
+
+std::vector<uint32_t> Renderer::rayCounts() const {
+    std::vector<uint32_t> result(m_maxDepth + 1);
+    for (int depth = 0; depth <= m_maxDepth; depth++) result[depth] = m_rayCounts[depth].load(std::memory_order_relaxed);
+    return result;
+}
+
+std::vector<uint32_t> Renderer::shadowRayCounts() const {
+    std::vector<uint32_t> result(m_maxDepth);
+    for (int depth = 0; depth < m_maxDepth; depth++) result[depth] = m_shadowRayCounts[depth].load(std::memory_order_relaxed);
+    return result;
+}
+
+void Renderer::updateState() {
+    uniforms.frameIndex = m_frameIndex;
+    uniforms.randomSeed += 1;
+    m_frameIndex += 1;
+}
+
+void Renderer::addToImage(uint16_t x, uint16_t y, const Vec3 &contribution) {
+    /// every pixel has at most one path (and one shadow ray) in flight per stage, so no synchronization is needed
+    simd_float4 &pixel = m_image[size_t(y) * m_width + x];
+    pixel.x += contribution.x;
+    pixel.y += contribution.y;
+    pixel.z += contribution.z;
+    pixel.w += 1;
+}
+
+void Renderer::execute() {
+    const Clock::time_point frameStart = Clock::now();
+    updateState();
+    
+    for (int depth = 0; depth <= m_maxDepth; depth++) m_rayCounts[depth] = 0;
+    for (int depth = 0; depth < m_maxDepth; depth++) m_shadowRayCounts[depth] = 0;
+    
+    Report report;
+    auto section = [&](const char *name, auto body) {
+        report.sections.emplace_back();
+        report.sections.back().name = name;
+        body();
+        report.reportedTime += report.sections.back().reportedTime;
+    };
+    auto measure = [&](const char *name, auto body, auto rays) {
+        const Clock::time_point start = Clock::now();
+        body();
+        Report::Section &current = report.sections.back();
+        current.entries.push_back({ name, secondsSince(start), rays() });
+        current.reportedTime += current.entries.back().time;
+    };
+    
+    if (options.executionMode == ExecutionMode::Megakernel) {
+        /// stages are interleaved within every tile, so they can only be timed together
+        section("Megakernel", [&]() {
+            measure("tiles", [&]() {
+                const uint32_t tilesX = (m_width + TileSize - 1) / TileSize;
+                const uint32_t tilesY = (m_height + TileSize - 1) / TileSize;
+                ThreadPool::shared().parallelFor(size_t(tilesX) * tilesY, [&](size_t tile) {
+                    renderTile(uint32_t(tile % tilesX), uint32_t(tile / tilesX));
+                });
+            }, [&]() {
+                uint32_t rays = 0;
+                for (int depth = 0; depth < m_maxDepth; depth++) rays += m_rayCounts[depth].load();
+                for (int depth = 0; depth + 1 < m_maxDepth; depth++) rays += m_shadowRayCounts[depth].load();
+                return rays;
+            });
+        });
+    } else {
+        section("Preproc", [&]() {
+            measure("raygen", [&]() { generateRays(); }, [&]() { return m_rayCounts[0].load(); });
+        });
+        
+        const size_t rayBufferHalf = m_rays.size() / 2;
+        DeviceRay *currentRays = m_rays.data();
+        DeviceRay *nextRays = m_rays.data() + rayBufferHalf;
+        
+        for (int depth = 0; depth < m_maxDepth; depth++) {
+            const bool isMaxDepth = depth + 1 == m_maxDepth;
+            const std::string name = "Depth " + std::to_string(depth);
+            
+            section(name.c_str(), [&]() {
+                const uint32_t rayCount = m_rayCounts[depth].load();
+                if (depth > 0 && options.reorderRays) {
+                    measure("reorder", [&]() { reorderRays(currentRays, rayCount); }, [&]() { return rayCount; });
+                }
+                
+                if (depth > 0) {
+                    measure("ctrace", [&]() {
+                        m_scene.accelerationStructure->intersect(currentRays, m_intersections.data(), rayCount);
+                    }, [&]() { return rayCount; });
+                } else {
+                    /// camera rays have already been traced by `generateRays`
+                    report.sections.back().entries.push_back({ "ctrace", 0, rayCount });
+                }
+                const uint32_t *order = nullptr;
+                if (options.sortByMaterial) {
+                    measure("sort", [&]() {
+                        sortByMaterial(m_scene, m_intersections.data(), rayCount, m_order.data(), m_sortBuffers);
+                    }, [&]() { return rayCount; });
+                    order = m_order.data();
+                }
+                measure("chit", [&]() { handleIntersections(currentRays, nextRays, depth, order); }, [&]() { return rayCount; });
+                
+                if (isMaxDepth) return;
+                
+                const uint32_t shadowRayCount = m_shadowRayCounts[depth].load();
+                measure("atrace", [&]() {
+                    m_scene.accelerationStructure->intersectAny(m_shadowRays.data(), m_intersections.data(), shadowRayCount);
+                }, [&]() { return shadowRayCount; });
+                measure("ahit", [&]() { handleShadowRays(depth); }, [&]() { return shadowRayCount; });
+            });
+            
+            // ping pong
+            std::swap(currentRays, nextRays);
+        }
+    }
+    
+    section("Postproc", [&]() {
+        measure("tonemap", [&]() { normalizeImage(); }, []() { return 0u; });
+    });
+    
+    report.totalTime = secondsSince(frameStart);
+    m_report = std::move(report);
+}
+
+// MARK: - Stages
+
+void Renderer::generateRays() {
+    const uint32_t tilesX = (m_width + TileSize - 1) / TileSize;
+    const uint32_t tilesY = (m_height + TileSize - 1) / TileSize;
+    
+    m_rayCounts[0].store(m_width * m_height, std::memory_order_relaxed);
+    
+    ThreadPool::shared().parallelFor(size_t(tilesX) * tilesY, [&](size_t tile) {
+        const uint32_t warpX = uint32_t(tile % tilesX);
+        const uint32_t warpY = uint32_t(tile / tilesX);
+        /// rays of a tile are contiguous, see `generateTile`
+        const uint32_t actualHeight = std::min(TileSize, m_height - warpY * TileSize);
+        generateTile(warpX, warpY, m_rays.data() + warpX * TileSize * actualHeight + warpY * TileSize * m_width);
+    });
+    
+    /// `generateRays` traces camera rays right away, their tile order makes them a good fit for packets
+    m_scene.accelerationStructure->intersectPackets(m_rays.data(), m_intersections.data(), m_width * m_height);
+}
+
+uint32_t Renderer::generateTile(uint32_t warpX, uint32_t warpY, DeviceRay *rays) {
+    const float aspect = float(m_height) / float(m_width);
+    const DeviceCamera &camera = m_scene.camera;
+    
+    /// tiles at the right and bottom border are cut off, like threadgroups of a non-uniform dispatch
+    const uint32_t actualWidth = std::min(TileSize, m_width - warpX * TileSize);
+    const uint32_t actualHeight = std::min(TileSize, m_height - warpY * TileSize);
+    
+    for (uint32_t threadY = 0; threadY < actualHeight; threadY++) {
+        for (uint32_t threadX = 0; threadX < actualWidth; threadX++) {
+            const uint32_t x = warpX * TileSize + threadX;
+            const uint32_t y = warpY * TileSize + threadY;
+            
+            /// same block linear indexing as `generateRays`
+            const uint32_t localIndex = threadX + threadY * actualWidth;
+            const uint32_t rayIndex = localIndex +
+                warpX * TileSize * actualHeight +
+                warpY * TileSize * m_width;
+            
+            Prng prng(uniforms.randomSeed, rayIndex);
+            DeviceRay ray;
+            ray.minDistance = camera.nearClip;
+            ray.maxDistance = camera.farClip;
+            ray.flags = RayFlagsCamera;
+            ray.depth = 0;
+            ray.bsdfPdf = std::numeric_limits<float>::infinity();
+            ray.x = uint16_t(x);
+            ray.y = uint16_t(y);
+            
+            if (!uniforms.accumulate) {
+                // clear image if accumulation is not desired
+                m_image[size_t(y) * m_width + x] = simd_float4();
+            }
+            
+            const float jitterX = prng.sample();
+            const float jitterY = prng.sample();
+            const float u = +1 * (((x + jitterX) / float(m_width) + camera.shift.x) * 2.0f - 1.0f);
+            const float v = -1 * (((y + jitterY) / float(m_height) + camera.shift.y) * 2.0f - 1.0f);
+            
+            ray.origin = pack(transformPoint(camera.transform, Vec3(0)));
+            ray.direction = pack(normalize(transformDirection(camera.transform, Vec3(u, v * aspect, -camera.focalLength))));
+            ray.weight = store(Vec3(1));
+            ray.prng = prng.state;
+            
+            rays[localIndex] = ray;
+        }
+    }
+    
+    return actualWidth * actualHeight;
+}
+
+void Renderer::reorderRays(DeviceRay *rays, uint32_t count) {
+    sortByOriginAndDirection(rays, count, m_scene.accelerationStructure->bounds(), m_order.data(), m_sortBuffers);
+    
+    ThreadPool::shared().parallelForRange(count, ShadingChunkSize, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) m_reorderedRays[i] = rays[m_order[i]];
+    });
+    ThreadPool::shared().parallelForRange(count, ShadingChunkSize, [&](size_t begin, size_t end) {
+        std::copy(m_reorderedRays.data() + begin, m_reorderedRays.data() + end, rays + begin);
+    });
+}
+
+void Renderer::handleIntersections(const DeviceRay *rays, DeviceRay *nextRays, int depth, const uint32_t *order) {
+    const uint32_t currentRayCount = m_rayCounts[depth].load(std::memory_order_relaxed);
+    std::atomic<uint32_t> &nextRayCount = m_rayCounts[depth + 1];
+    std::atomic<uint32_t> &shadowRayCount = m_shadowRayCounts[depth];
+    
+    /// ray counts shrink with every bounce, ranges are split on demand so that even the last bounces keep all threads busy
+    ThreadPool::shared().parallelForRange(currentRayCount, ShadingChunkSize, [&](size_t begin, size_t end) {
+        DeviceRay emittedRays[ShadingChunkSize];
+        DeviceShadowRay emittedShadowRays[ShadingChunkSize];
+        Emitted emitted { emittedRays, emittedShadowRays };
+        
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t rayIndex = order ? order[i] : uint32_t(i);
+            handleIntersection(rays[rayIndex], m_intersections[rayIndex], emitted);
+        }
+        
+        /// compaction: one atomic per chunk instead of one per ray, the GPU does not guarantee any order either
+        if (emitted.rayCount) {
+            const uint32_t offset = nextRayCount.fetch_add(emitted.rayCount, std::memory_order_relaxed);
+            std::copy(emitted.rays, emitted.rays + emitted.rayCount, nextRays + offset);
+        }
+        if (emitted.shadowRayCount) {
+            const uint32_t offset = shadowRayCount.fetch_add(emitted.shadowRayCount, std::memory_order_relaxed);
+            std::copy(emitted.shadowRays, emitted.shadowRays + emitted.shadowRayCount, m_shadowRays.data() + offset);
+        }
+    });
+}
+
+void Renderer::handleIntersection(const DeviceRay &ray, const DeviceIntersection &isect, Emitted &emitted) {
+    const bool needsToCollectEmission = std::isinf(ray.bsdfPdf) || uniforms.samplingMode != SamplingModeNee;
+    const Vec3 rayDirection = ray.direction;
+    const Vec3 rayWeight = load(ray.weight);
+    const Shaders &shaders = *m_scene.shaders;
+    
+    Prng prng(ray.prng);
+    
+    ShadingContext shading;
+    shading.rayFlags = RayFlags(ray.flags);
+    shading.rnd.x = prng.sample();
+    shading.rnd.y = prng.sample();
+    shading.rnd.z = prng.sample();
+    shading.wo = -rayDirection;
+    
+    if (isect.distance <= 0.0f) {
+        // miss
+        if (needsToCollectEmission) {
+            const float misWeight = (uniforms.samplingMode == SamplingModeBsdf) || std::isinf(ray.bsdfPdf) ? 1 :
+                computeMisWeight(ray.bsdfPdf, shaders.envmapPdf(rayDirection));
+            
+            shaders.evaluateEnvironment(shading);
+            addToImage(ray.x, ray.y, misWeight * rayWeight * shading.material.emission);
+        }
+        
+        return;
+    }
+    
+    // MARK: Evaluate shading graph
+    
+    const DevicePerInstanceData &instance = m_scene.perInstanceData[isect.instanceIndex];
+    
+    MaterialIndex shaderIndex;
+    buildShadingContext(m_scene, instance, isect, shading, shaderIndex);
+    
+    if (instance.visibility & ray.flags) {
+        shaders.shadeSurface(shaderIndex, shading);
+    } else {
+        shading.material.alpha = 0;
+    }
+    
+    if (needsToCollectEmission && mean(shading.material.emission) != 0) {
+        const float misWeight = (uniforms.samplingMode == SamplingModeBsdf) || std::isinf(ray.bsdfPdf) ? 1 :
+            computeMisWeight(ray.bsdfPdf, shaders.shapePdf(instance, shading));
+        
+        addToImage(ray.x, ray.y, misWeight * rayWeight * shading.material.emission);
+    }
+    
+    Vec3 shNormal;
+    if (isZero(shading.material.normal)) {
+        shNormal = shading.trueNormal;
+    } else {
+        Vec3 geoNormal = shading.trueNormal;
+        if (dot(geoNormal, shading.wo) < 0) geoNormal = -geoNormal;
+        
+        shNormal = ensureValidReflection(geoNormal, shading.wo, shading.material.normal);
+    }
+    
+    // MARK: NEE sampling
+    if (uniforms.samplingMode != SamplingModeBsdf) {
+        const LightSample neeSample = shaders.sampleLight(shading, prng);
+        
+        float bsdfPdf;
+        const Vec3 bsdf = shading.material.evaluate(shading.wo, neeSample.direction, shNormal, shading.trueNormal, bsdfPdf);
+        
+        const Vec3 contribution = neeSample.weight * bsdf * rayWeight;
+        if (neeSample.castsShadows) {
+            const float misWeight = uniforms.samplingMode == SamplingModeNee || !neeSample.canBeHit ? 1 :
+                computeMisWeight(neeSample.pdf, bsdfPdf);
+            
+            const Vec3 neeWeight = misWeight * contribution;
+            if (isFinite(neeWeight) && !isZero(neeWeight)) {
+                DeviceShadowRay &shadowRay = emitted.shadowRays[emitted.shadowRayCount++];
+                shadowRay.origin = pack(shading.position);
+                shadowRay.direction = pack(neeSample.direction);
+                shadowRay.minDistance = Epsilon;
+                shadowRay.maxDistance = neeSample.distance - Epsilon;
+                shadowRay.weight = store(neeWeight);
+                shadowRay.x = ray.x;
+                shadowRay.y = ray.y;
+            }
+        } else {
+            addToImage(ray.x, ray.y, rayWeight * contribution);
+        }
+    }
+    
+    // MARK: BSDF sampling
+    
+    const BsdfSample sample = shading.material.sample(shading.rnd, -rayDirection, shNormal, shading.trueNormal, RayFlags(ray.flags));
+    
+    const Vec3 weight = rayWeight * sample.weight;
+    const float meanWeight = mean(weight);
+    if (!std::isfinite(meanWeight)) return;
+    
+    const float survivalProb = std::min(meanWeight, 1.f);
+    if (prng.sample() < survivalProb) {
+        DeviceRay &nextRay = emitted.rays[emitted.rayCount++];
+        nextRay.origin = pack(shading.position);
+        nextRay.flags = sample.flags;
+        nextRay.depth = ray.depth + 1;
+        nextRay.direction = pack(sample.wi);
+        nextRay.minDistance = Epsilon;
+        nextRay.maxDistance = std::numeric_limits<float>::infinity();
+        nextRay.weight = store(weight * (1 / survivalProb));
+        nextRay.x = ray.x;
+        nextRay.y = ray.y;
+        nextRay.prng = prng.state;
+        nextRay.bsdfPdf = sample.pdf;
+    }
+}
+
+void Renderer::handleShadowRays(int depth) {
+    const uint32_t rayCount = m_shadowRayCounts[depth].load(std::memory_order_relaxed);
+    
+    ThreadPool::shared().parallelForRange(rayCount, ShadingChunkSize, [&](size_t begin, size_t end) {
+        for (size_t rayIndex = begin; rayIndex < end; rayIndex++) {
+            const DeviceShadowRay &shadowRay = m_shadowRays[rayIndex];
+            if (m_intersections[rayIndex].distance < 0.0f) {
+                addToImage(shadowRay.x, shadowRay.y, load(shadowRay.weight));
+            }
+        }
+    });
+}
+
+void Renderer::renderTile(uint32_t warpX, uint32_t warpY) {
+    /// everything a tile needs fits in about 12 kB, the wavefront stages stream the same data through memory instead
+    constexpr uint32_t MaxTileRays = TileSize * TileSize;
+    DeviceRay rays[2][MaxTileRays];
+    DeviceShadowRay shadowRays[MaxTileRays];
+    DeviceIntersection intersections[MaxTileRays];
+    const bvh::Tlas &accelerationStructure = *m_scene.accelerationStructure;
+    
+    DeviceRay *currentRays = rays[0];
+    DeviceRay *nextRays = rays[1];
+    uint32_t rayCount = generateTile(warpX, warpY, currentRays);
+    m_rayCounts[0].fetch_add(rayCount, std::memory_order_relaxed);
+    
+    /// the stages of `execute` in the same order, so that every pixel receives its contributions in the same order.
+    /// Tiles already run on `ThreadPool::shared()`, so rays are traced on this thread instead of through the buffer
+    /// entry points of `Tlas`, which would submit a job to the pool for every stage
+    for (int depth = 0; depth < m_maxDepth && rayCount > 0; depth++) {
+        if (depth == 0) {
+            for (uint32_t offset = 0; offset < rayCount; offset += bvh::PacketSize) {
+                accelerationStructure.intersectPacket(
+                    currentRays + offset, intersections + offset,
+                    int(std::min<uint32_t>(bvh::PacketSize, rayCount - offset)));
+            }
+        } else {
+            for (uint32_t i = 0; i < rayCount; i++) {
+                accelerationStructure.intersect(bvh::makeRay(currentRays[i]), intersections[i]);
+            }
+        }
+        
+        Emitted emitted { nextRays, shadowRays };
+        for (uint32_t i = 0; i < rayCount; i++) {
+            handleIntersection(currentRays[i], intersections[i], emitted);
+        }
+        m_rayCounts[depth + 1].fetch_add(emitted.rayCount, std::memory_order_relaxed);
+        m_shadowRayCounts[depth].fetch_add(emitted.shadowRayCount, std::memory_order_relaxed);
+        
+        if (depth + 1 == m_maxDepth) break;
+        
+        for (uint32_t i = 0; i < emitted.shadowRayCount; i++) {
+            accelerationStructure.intersectAny(bvh::makeRay(shadowRays[i]), intersections[i]);
+            if (intersections[i].distance < 0.0f) {
+                addToImage(shadowRays[i].x, shadowRays[i].y, load(shadowRays[i].weight));
+            }
+        }
+        
+        std::swap(currentRays, nextRays);
+        rayCount = emitted.rayCount;
+    }
+}
+
+void Renderer::normalizeImage() {
+    ThreadPool::shared().parallelFor(m_height, [&](size_t y) {
+        for (size_t x = 0; x < m_width; x++) {
+            const size_t index = y * m_width + x;
+            const simd_float4 &input = m_image[index];
+            Vec3 color = uniforms.exposure * Vec3(input.x, input.y, input.z);
+            if (uniforms.accumulate) color = color / float(uniforms.frameIndex + 1);
+            
+            switch (uniforms.tonemapping) {
+            case TonemappingLinear: break;
+            case TonemappingHable:
+                color = tonemapHable(color);
+                break;
+            case TonemappingAces:
+                color = tonemapAces(color);
+                break;
+            }
+            
+            simd_float4 &output = m_normalizedImage[index];
+            output.x = color.x;
+            output.y = color.y;
+            output.z = color.z;
+            output.w = 1;
+        }
+    });
+}
+
+}
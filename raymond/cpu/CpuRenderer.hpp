@@ -0,0 +1,156 @@
+#pragma once
+
+#include "Shading.hpp"
+#include "Sorting.hpp"
+
+#include <bridge/Ray.hpp>
+#include <bridge/Uniforms.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace raymond::cpu {
+
+/// Timings of one frame, with the same sections and entries as the report of `RendererCounters`
+struct Report {
+    struct Entry {
+        std::string name;
+        double time = 0;
+        uint32_t rays = 0;
+    };
+    
+    struct Section {
+        std::string name;
+        double reportedTime = 0;
+        std::vector<Entry> entries;
+    };
+    
+    double totalTime = 0;
+    double reportedTime = 0;
+    std::vector<Section> sections;
+    
+    /// Prints the report in the format of `RendererCounters`, so that the output of both backends can be diffed
+    void print(std::FILE *file = stdout) const;
+};
+
+/**
+ * CPU counterpart of `Renderer.execute`, which runs the same wavefront of stages over the same ray buffers: camera
+ * rays are generated and traced, then each depth traces its rays, shades them with `handleIntersections` (which
+ * compacts surviving paths into the other half of a ping-pong ray buffer and appends shadow rays through atomic
+ * counters), traces the shadow rays and resolves them with `handleShadowRays`. Finally, `normalizeImage` tonemaps the
+ * accumulated image. Every stage is a data parallel loop on `ThreadPool::shared()`.
+ *
+ * Alternatively, `ExecutionMode::Megakernel` runs all of these stages for one tile of `generateRays` at a time, so that
+ * rays and intersections stay in small stack buffers instead of round-tripping through memory between stages. Paths
+ * see the same random numbers and add to their pixel in the same order, so both modes produce the same image.
+ *
+ * Random numbers, ray counts and image contents follow the Metal kernels, so both backends can be compared stage by
+ * stage. Shading goes through `Scene::shaders` instead of the JIT compiled shader graphs, and only pinhole cameras are
+ * supported (`uniforms.numLensSurfaces` is ignored).
+ */
+class Renderer {
+public:
+    static constexpr int DefaultMaxDepth = 8;
+    
+    /// How the stages of a frame are scheduled
+    enum class ExecutionMode {
+        /// every stage processes all rays of the frame before the next stage starts, like `Renderer.execute`
+        Wavefront,
+        /// every task runs all stages for the paths of one tile until they terminate, see `renderTile`
+        Megakernel,
+    };
+    
+    /// Choices that only exist in the CPU backend, none of them change the rendered image
+    struct Options {
+        ExecutionMode executionMode = ExecutionMode::Wavefront;
+        /// shade rays grouped by material (see `sortByMaterial`), which is reported as an extra `sort` stage per depth.
+        /// Like `reorderRays`, this only applies to `ExecutionMode::Wavefront`, a tile has too few rays to benefit
+        bool sortByMaterial = false;
+        /// reorder secondary rays before tracing them (see `sortByOriginAndDirection`), reported as a `reorder` stage per depth
+        bool reorderRays = false;
+    };
+    
+    explicit Renderer(const Scene &scene, int maxDepth = DefaultMaxDepth);
+    
+    /// Same defaults as the uniforms of `Renderer.swift`, `frameIndex` and `randomSeed` are advanced by `execute`
+    DeviceUniforms uniforms;
+    Options options;
+    
+    /// Allocates ray buffers and images for the given output size and restarts accumulation
+    void resize(uint32_t width, uint32_t height);
+    /// Restarts accumulation
+    void reset();
+    /// Renders one frame (one sample per pixel) into `image` and updates `normalizedImage` and `report`
+    void execute();
+    
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+    uint32_t frameIndex() const { return m_frameIndex; }
+    int maxDepth() const { return m_maxDepth; }
+    
+    /// Accumulated radiance with the number of contributions in `w`, the counterpart of `outputImage`
+    const std::vector<simd_float4> &image() const { return m_image; }
+    /// Counterpart of `normalizedImage`
+    const std::vector<simd_float4> &normalizedImage() const { return m_normalizedImage; }
+    
+    /** @returns number of rays traced at each depth during the last frame, the contents of `rayCountBuffer` */
+    std::vector<uint32_t> rayCounts() const;
+    /** @returns number of shadow rays emitted at each depth during the last frame, the contents of `shadowRayCountBuffer` */
+    std::vector<uint32_t> shadowRayCounts() const;
+    
+    /// Timings of the last frame
+    const Report &report() const { return m_report; }
+
+private:
+    struct Emitted;
+    
+    void updateState();
+    
+    void generateRays();
+    /** @returns number of rays written to `rays`, which is less than a full tile at the right and bottom border */
+    uint32_t generateTile(uint32_t warpX, uint32_t warpY, DeviceRay *rays);
+    void reorderRays(DeviceRay *rays, uint32_t count);
+    /// `order` is either null or a permutation of the current rays that they are shaded in
+    void handleIntersections(const DeviceRay *rays, DeviceRay *nextRays, int depth, const uint32_t *order);
+    void handleIntersection(const DeviceRay &ray, const DeviceIntersection &isect, Emitted &emitted);
+    void handleShadowRays(int depth);
+    void normalizeImage();
+    
+    /// Megakernel counterpart of all stages between `generateRays` and `normalizeImage` for the paths of one tile
+    void renderTile(uint32_t warpX, uint32_t warpY);
+    
+    void addToImage(uint16_t x, uint16_t y, const Vec3 &contribution);
+    
+    Scene m_scene;
+    int m_maxDepth;
+    uint32_t m_frameIndex = 0;
+    
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    
+    /// two halves of `width * height` rays each, alternating between current and next rays
+    std::vector<DeviceRay> m_rays;
+    std::vector<DeviceShadowRay> m_shadowRays;
+    std::vector<DeviceIntersection> m_intersections;
+    /// `maxDepth + 1` counters, entry `depth + 1` is incremented by `handleIntersections` at `depth`
+    std::unique_ptr<std::atomic<uint32_t>[]> m_rayCounts;
+    /// `maxDepth` counters
+    std::unique_ptr<std::atomic<uint32_t>[]> m_shadowRayCounts;
+    
+    /// permutation of the current rays computed by the sorting stages
+    std::vector<uint32_t> m_order;
+    /// current rays in the order of `Options::reorderRays`, copied back before tracing
+    std::vector<DeviceRay> m_reorderedRays;
+    SortBuffers m_sortBuffers;
+    
+    std::vector<simd_float4> m_image;
+    std::vector<simd_float4> m_normalizedImage;
+    
+    Report m_report;
+};
+
+}
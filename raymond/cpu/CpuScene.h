@@ -0,0 +1,50 @@
+#import <Foundation/Foundation.h>
+#include "../bridge/common.hpp"
+#include "../bridge/Camera.hpp"
+#include "../bridge/PerInstanceData.hpp"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Mirrors a loaded scene for the CPU renderer (see `cpu::SceneBuilder`), reading the buffers that `ShapeBuilder` fills.
+ * Since shader graphs only exist as Metal code, every material renders as the same diffuse gray under a white
+ * environment, which is enough to compare geometry, ray counts and timings with the Metal renderer.
+ */
+@interface CpuScene : NSObject
+
+/// The buffers need to stay alive as long as the scene, vertex attributes need to be uncompressed
+- (instancetype)initWithVertices:(const Vertex *)vertices
+    normals:(const Normal *)normals
+    texCoords:(const TexCoord *)texCoords
+    indices:(IndexTriplet *)indices
+    materials:(MaterialIndex *)materials;
+
+/**
+ * Needs to be called in the order of `shapeIndex`. The hierarchy of the shape is cached next to its source file
+ * (see `rbvh::readOrBuildBlas`) and reused as long as its triangles do not change.
+ */
+- (void)addShapeWithVertexOffset:(VertexIndex)vertexOffset
+    faceOffset:(FaceIndex)faceOffset
+    faceCount:(FaceIndex)faceCount
+    sourcePath:(NSString *)sourcePath;
+
+/// Needs to be called in the order of `instanceIndex`
+- (void)addInstanceOfShape:(unsigned int)shapeIndex data:(DevicePerInstanceData)data;
+
+/// Builds the hierarchies, needs to be called after adding all shapes and instances
+- (void)build;
+
+/**
+ * Renders the given number of samples per pixel with `cpu::Renderer`, prints the report of the last frame in the
+ * format of `RendererCounters` and writes the normalized image.
+ * @returns NO if the image could not be written
+ */
+- (BOOL)renderFrames:(unsigned int)frameCount
+    camera:(DeviceCamera)camera
+    width:(unsigned int)width
+    height:(unsigned int)height
+    toEXR:(NSURL *)url;
+
+@end
+
+NS_ASSUME_NONNULL_END
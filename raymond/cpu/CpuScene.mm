@@ -0,0 +1,96 @@
+#import "CpuScene.h"
+#include <stdio.h>
+
+#include "CpuRenderer.hpp"
+#include "SceneBuilder.hpp"
+#include "../io/rbvh/RBvh.hpp"
+#include "../io/tinyexr.h"
+
+#include <algorithm>
+#include <memory>
+
+@implementation CpuScene {
+    std::unique_ptr<raymond::cpu::SceneBuilder> builder;
+    raymond::cpu::MaterialTable materialTable;
+    const MaterialIndex *materials;
+    FaceIndex faceCount;
+}
+
+- (instancetype)initWithVertices:(const Vertex *)vertices
+    normals:(const Normal *)normals
+    texCoords:(const TexCoord *)texCoords
+    indices:(IndexTriplet *)indices
+    materials:(MaterialIndex *)materials
+{
+    self = [super init];
+    if (!self) return self;
+    
+    raymond::cpu::SceneBuilder::Buffers buffers;
+    buffers.vertices = vertices;
+    buffers.normals = normals;
+    buffers.texCoords = texCoords;
+    buffers.indices = indices;
+    buffers.materials = materials;
+    buffers.isShared = true;
+    builder = std::make_unique<raymond::cpu::SceneBuilder>(buffers);
+    
+    self->materials = materials;
+    faceCount = 0;
+    return self;
+}
+
+- (void)addShapeWithVertexOffset:(VertexIndex)vertexOffset
+    faceOffset:(FaceIndex)faceOffset
+    faceCount:(FaceIndex)faceCount
+    sourcePath:(NSString *)sourcePath
+{
+    builder->addShape(
+        vertexOffset, faceOffset, faceCount,
+        raymond::rbvh::cachePath([sourcePath cStringUsingEncoding:NSUTF8StringEncoding]));
+    self->faceCount = std::max(self->faceCount, faceOffset + faceCount);
+}
+
+- (void)addInstanceOfShape:(unsigned int)shapeIndex data:(DevicePerInstanceData)data {
+    builder->addInstance(shapeIndex, data);
+}
+
+- (void)build {
+    builder->build();
+    
+    MaterialIndex materialCount = 0;
+    for (FaceIndex face = 0; face < faceCount; face++) {
+        materialCount = std::max(materialCount, MaterialIndex(materials[face] + 1));
+    }
+    
+    raymond::cpu::Material clay;
+    clay.diffuse = raymond::cpu::Vec3(0.8f);
+    materialTable.materials.assign(materialCount, clay);
+    materialTable.environment = raymond::cpu::Vec3(1);
+}
+
+- (BOOL)renderFrames:(unsigned int)frameCount
+    camera:(DeviceCamera)camera
+    width:(unsigned int)width
+    height:(unsigned int)height
+    toEXR:(NSURL *)url
+{
+    raymond::cpu::Renderer renderer(builder->scene(camera, materialTable));
+    renderer.resize(width, height);
+    for (unsigned int frame = 0; frame < frameCount; frame++) {
+        renderer.execute();
+    }
+    renderer.report().print();
+    
+    const char *error = nullptr;
+    const int result = SaveEXR(
+        &renderer.normalizedImage()[0].x, int(width), int(height), 4, 0,
+        [url.path cStringUsingEncoding:NSUTF8StringEncoding], &error);
+    if (result != TINYEXR_SUCCESS) {
+        printf("could not write '%s': %s\n", url.path.UTF8String, error ? error : "unknown error");
+        FreeEXRErrorMessage(error);
+        return NO;
+    }
+    return YES;
+}
+
+@end
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <bridge/common.hpp>
+#include <bvh/Bounds.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace raymond::cpu {
+
+using bvh::Vec3;
+using bvh::cross;
+using bvh::dot;
+
+constexpr float Pi = 3.14159265358979323846f;
+
+/// Same offset that the kernels use (see device/constants.hpp) to keep secondary rays from hitting their origin
+constexpr float Epsilon = 0.001f;
+
+inline Vec3 operator*(float s, const Vec3 &v) { return v * s; }
+inline Vec3 operator/(const Vec3 &v, float s) { return v * (1 / s); }
+
+inline float length(const Vec3 &v) { return std::sqrt(dot(v, v)); }
+inline Vec3 normalize(const Vec3 &v) { return v / length(v); }
+inline float mean(const Vec3 &v) { return (v.x + v.y + v.z) / 3; }
+inline float square(float f) { return f * f; }
+inline float safeSqrt(float f) { return std::sqrt(std::max(f, 0.0f)); }
+
+inline bool isZero(const Vec3 &v) { return v.x == 0 && v.y == 0 && v.z == 0; }
+inline bool isFinite(const Vec3 &v) { return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z); }
+
+// MARK: - Conversions from and to the types shared with Metal
+
+inline Vec3 load(const simd_float3 &v) { return { v.x, v.y, v.z }; }
+
+inline simd_float3 store(const Vec3 &v) {
+    simd_float3 result;
+    result.x = v.x;
+    result.y = v.y;
+    result.z = v.z;
+    return result;
+}
+
+inline MPSPackedFloat3 pack(const Vec3 &v) {
+    MPSPackedFloat3 result;
+    result.x = v.x;
+    result.y = v.y;
+    result.z = v.z;
+    return result;
+}
+
+/** @returns `(m * float4(p, 1)).xyz` */
+inline Vec3 transformPoint(const simd_float4x4 &m, const Vec3 &p) {
+    Vec3 result(m.columns[3].x, m.columns[3].y, m.columns[3].z);
+    for (int i = 0; i < 3; i++) {
+        result = result + Vec3(m.columns[i].x, m.columns[i].y, m.columns[i].z) * p[i];
+    }
+    return result;
+}
+
+/** @returns `(m * float4(d, 0)).xyz` */
+inline Vec3 transformDirection(const simd_float4x4 &m, const Vec3 &d) {
+    Vec3 result(0);
+    for (int i = 0; i < 3; i++) {
+        result = result + Vec3(m.columns[i].x, m.columns[i].y, m.columns[i].z) * d[i];
+    }
+    return result;
+}
+
+/** @returns `m * v` */
+inline Vec3 transform(const simd_float3x3 &m, const Vec3 &v) {
+    return load(m.columns[0]) * v.x + load(m.columns[1]) * v.y + load(m.columns[2]) * v.z;
+}
+
+// MARK: - Ports of device/utils/math.hpp
+
+/// Orthonormal basis around a normal, the same frame as `buildOrthonormalBasis` (Duff et al. 2017)
+struct Frame {
+    Vec3 s, t, n;
+    
+    explicit Frame(const Vec3 &normal) : n(normal) {
+        const float sign = std::copysign(1.0f, n.z);
+        const float a = -1.0f / (sign + n.z);
+        const float b = n.x * n.y * a;
+        s = Vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+        t = Vec3(b, sign + n.y * n.y * a, -n.y);
+    }
+    
+    Vec3 toLocal(const Vec3 &v) const { return { dot(v, s), dot(v, t), dot(v, n) }; }
+    Vec3 toWorld(const Vec3 &v) const { return s * v.x + t * v.y + n * v.z; }
+};
+
+/// Bends a shading normal so that the reflection of `I` stays above the surface, see `ensure_valid_reflection`
+inline Vec3 ensureValidReflection(const Vec3 &Ng, const Vec3 &I, const Vec3 &N) {
+    const Vec3 R = 2 * dot(N, I) * N - I;
+    
+    const float threshold = std::min(0.9f * dot(Ng, I), 0.01f);
+    if (dot(Ng, R) >= threshold) {
+        return N;
+    }
+    
+    const float NdotNg = dot(N, Ng);
+    const Vec3 X = normalize(N - NdotNg * Ng);
+    
+    const float Ix = dot(I, X), Iz = dot(I, Ng);
+    const float Ix2 = square(Ix), Iz2 = square(Iz);
+    const float a = Ix2 + Iz2;
+    
+    const float b = safeSqrt(Ix2 * (a - square(threshold)));
+    const float c = Iz * threshold + a;
+    
+    const float fac = 0.5f / a;
+    const float N1_z2 = fac * (b + c), N2_z2 = fac * (-b + c);
+    bool valid1 = (N1_z2 > 1e-5f) && (N1_z2 <= (1.0f + 1e-5f));
+    bool valid2 = (N2_z2 > 1e-5f) && (N2_z2 <= (1.0f + 1e-5f));
+    
+    float Nx, Nz;
+    if (valid1 && valid2) {
+        const float N1x = safeSqrt(1.0f - N1_z2), N1z = safeSqrt(N1_z2);
+        const float N2x = safeSqrt(1.0f - N2_z2), N2z = safeSqrt(N2_z2);
+        
+        const float R1 = 2 * (N1x * Ix + N1z * Iz) * N1z - Iz;
+        const float R2 = 2 * (N2x * Ix + N2z * Iz) * N2z - Iz;
+        
+        valid1 = (R1 >= 1e-5f);
+        valid2 = (R2 >= 1e-5f);
+        const bool pickFirst = valid1 && valid2 ? R1 < R2 : R1 > R2;
+        Nx = pickFirst ? N1x : N2x;
+        Nz = pickFirst ? N1z : N2z;
+    } else if (valid1 || valid2) {
+        const float Nz2 = valid1 ? N1_z2 : N2_z2;
+        Nx = safeSqrt(1.0f - Nz2);
+        Nz = safeSqrt(Nz2);
+    } else {
+        return Ng;
+    }
+    
+    return Nx * X + Nz * Ng;
+}
+
+}
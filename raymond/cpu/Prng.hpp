@@ -0,0 +1,47 @@
+#pragma once
+
+#include <bridge/PrngState.hpp>
+
+#include <cstdint>
+
+namespace raymond::cpu {
+
+/// Port of `sample_tea_32` in device/PrngState.metal, so that the CPU backend draws exactly the same random numbers
+inline uint32_t sampleTea32(uint32_t v0, uint32_t v1, int rounds = 6) {
+    uint32_t sum = 0;
+    
+    for (int i = 0; i < rounds; ++i) {
+        sum += 0x9e3779b9;
+        v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + sum) ^ ((v1 >> 5) + 0xc8013ea4);
+        v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + sum) ^ ((v0 >> 5) + 0x7e95761e);
+    }
+    
+    return v1;
+}
+
+/// Port of `sample_tea_float32`, uniformly distributed on `[0, 1)`
+inline float sampleTeaFloat32(uint32_t v0, uint32_t v1, int rounds = 6) {
+    union {
+        uint32_t raw;
+        float f;
+    } v;
+    v.raw = (sampleTea32(v0, v1, rounds) >> 9) | 0x3f800000u;
+    return v.f - 1.f;
+}
+
+/// Host side counterpart of the `PrngState` methods, operating on the state stored in `DeviceRay`
+struct Prng {
+    DevicePrngState state;
+    
+    Prng() = default;
+    explicit Prng(const DevicePrngState &state) : state(state) {}
+    Prng(uint32_t a, uint32_t b) {
+        state.seed = sampleTea32(a, b);
+        state.index = 0;
+    }
+    
+    float sample() { return sampleTeaFloat32(state.seed, state.index++); }
+    int sampleInt(int max) { return int(sampleTea32(state.seed, state.index++) % uint32_t(max)); }
+};
+
+}
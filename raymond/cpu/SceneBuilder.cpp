@@ -0,0 +1,140 @@
+#include "SceneBuilder.hpp"
+
+#include <io/rbvh/RBvh.hpp>
+#include <utils/ThreadPool.hpp>
+
+#include <cassert>
+#include <cstring>
+
+namespace raymond::cpu {
+
+uint32_t SceneBuilder::addShape(VertexIndex vertexOffset, FaceIndex faceOffset, FaceIndex faceCount,
+                                const std::string &cachePath) {
+    Shape shape;
+    shape.vertexOffset = vertexOffset;
+    shape.faceOffset = faceOffset;
+    shape.faceCount = faceCount;
+    shape.cachePath = cachePath;
+    m_shapes.push_back(shape);
+    return uint32_t(m_shapes.size() - 1);
+}
+
+void SceneBuilder::setMeshCache(uint32_t shape, const std::string &path, const MaterialIndex *palette,
+                                size_t paletteSize) {
+    assert(shape < m_shapes.size());
+    m_shapes[shape].meshCachePath = path;
+    m_shapes[shape].palette.assign(palette, palette + paletteSize);
+}
+
+uint32_t SceneBuilder::addInstance(uint32_t shape, const DevicePerInstanceData &data) {
+    assert(shape < m_shapes.size());
+    m_instanceShapes.push_back(shape);
+    m_instanceData.push_back(data);
+    return uint32_t(m_instanceData.size() - 1);
+}
+
+bool SceneBuilder::build(const Settings &settings) {
+    /// shapes with identical contents share their buffer ranges (see `ShapeBuilder`), and with that their hierarchy
+    std::vector<size_t> uniqueShapes;
+    /// position of the shape (or the shape it shares its ranges with) in `uniqueShapes`
+    std::vector<size_t> uniqueIndex(m_shapes.size());
+    for (size_t i = 0; i < m_shapes.size(); i++) {
+        uniqueIndex[i] = uniqueShapes.size();
+        for (size_t j = 0; j < uniqueShapes.size(); j++) {
+            const Shape &other = m_shapes[uniqueShapes[j]];
+            if (other.faceOffset == m_shapes[i].faceOffset && other.faceCount == m_shapes[i].faceCount) {
+                uniqueIndex[i] = j;
+                break;
+            }
+        }
+        if (uniqueIndex[i] == uniqueShapes.size()) uniqueShapes.push_back(i);
+    }
+    
+    /// paged shapes are appended to the geometry in the order of `uniqueShapes`, which gives them new offsets
+    m_geometry.reset();
+    if (settings.memoryBudget) {
+        m_geometry = std::make_unique<PagedGeometry>(settings.memoryBudget);
+        for (size_t i : uniqueShapes) {
+            const Shape &shape = m_shapes[i];
+            if (!m_geometry->addShape(shape.meshCachePath, shape.palette.data(), shape.palette.size()) ||
+                m_geometry->shape(m_geometry->shapeCount() - 1).faceCount != shape.faceCount) {
+                m_geometry.reset();
+                return false;
+            }
+        }
+    }
+    
+    auto mesh = [&](size_t unique) {
+        if (m_geometry) return bvh::Mesh::paged(*m_geometry, unique);
+        const Shape &shape = m_shapes[uniqueShapes[unique]];
+        return bvh::Mesh {
+            m_buffers.vertices + shape.vertexOffset,
+            m_buffers.indices + shape.faceOffset,
+            shape.faceCount
+        };
+    };
+    
+    std::vector<bvh::Bvh> hierarchies(uniqueShapes.size());
+    ThreadPool::shared().parallelFor(uniqueShapes.size(), [&](size_t i) {
+        const Shape &shape = m_shapes[uniqueShapes[i]];
+        hierarchies[i] = shape.cachePath.empty() ?
+            bvh::buildBlas(mesh(i), settings.shapes) :
+            rbvh::readOrBuildBlas(shape.cachePath, mesh(i), settings.shapes);
+    });
+    
+    assert(!(m_buffers.isShared && settings.nodeLayout == bvh::NodeLayout::Compressed) &&
+           "faces cannot be reordered in buffers that Metal acceleration structures refer to");
+    const bvh::NodeLayout nodeLayout = m_buffers.isShared || m_geometry ? bvh::NodeLayout::Wide : settings.nodeLayout;
+    
+    m_tlas = bvh::Tlas();
+    for (size_t i = 0; i < uniqueShapes.size(); i++) {
+        Shape &shape = m_shapes[uniqueShapes[i]];
+        shape.tlasShape = nodeLayout == bvh::NodeLayout::Compressed ?
+            m_tlas.addShapeInLeafOrder(
+                mesh(i), m_buffers.indices + shape.faceOffset,
+                m_buffers.materials ? m_buffers.materials + shape.faceOffset : nullptr,
+                hierarchies[i]) :
+            m_tlas.addShape(mesh(i), hierarchies[i], nodeLayout);
+        hierarchies[i] = {};
+    }
+    for (size_t i = 0; i < m_shapes.size(); i++) {
+        m_shapes[i].tlasShape = m_shapes[uniqueShapes[uniqueIndex[i]]].tlasShape;
+    }
+    
+    for (size_t i = 0; i < m_instanceData.size(); i++) {
+        DevicePerInstanceData &data = m_instanceData[i];
+        const Shape &shape = m_shapes[m_instanceShapes[i]];
+        if (m_geometry) {
+            const PagedGeometry::ShapeRange &range = m_geometry->shape(uniqueIndex[m_instanceShapes[i]]);
+            data.vertexOffset = range.vertexOffset;
+            data.faceOffset = range.faceOffset;
+        } else {
+            data.vertexOffset = shape.vertexOffset;
+            data.faceOffset = shape.faceOffset;
+        }
+        
+        float matrix[16];
+        static_assert(sizeof(matrix) == sizeof(data.pointTransform), "expected a 4x4 float matrix");
+        std::memcpy(matrix, &data.pointTransform, sizeof(matrix));
+        m_tlas.addInstance(shape.tlasShape, bvh::Transform::fromColumnMajor(matrix));
+    }
+    m_tlas.build(settings.instances);
+    return true;
+}
+
+Scene SceneBuilder::scene(const DeviceCamera &camera, const Shaders &shaders) const {
+    Scene scene;
+    scene.vertices = m_buffers.vertices;
+    scene.vertexIndices = m_buffers.indices;
+    scene.vertexNormals = m_buffers.normals;
+    scene.texcoords = m_buffers.texCoords;
+    scene.perInstanceData = m_instanceData.data();
+    scene.materials = m_buffers.materials;
+    scene.geometry = m_geometry.get();
+    scene.camera = camera;
+    scene.accelerationStructure = &m_tlas;
+    scene.shaders = &shaders;
+    return scene;
+}
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Shading.hpp"
+
+#include <bridge/Camera.hpp>
+#include <bridge/PerInstanceData.hpp>
+#include <bvh/Tlas.hpp>
+#include <mesh/PagedGeometry.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace raymond::cpu {
+
+/**
+ * Builds the CPU counterpart of a loaded scene from the buffers that `ShapeBuilder` fills and the per instance data
+ * that `EntityBuilder` writes: one hierarchy per shape (shapes that share their buffer ranges share it), a top level
+ * hierarchy over the instances and a `Scene` that reads the same buffers. Shapes and instances need to be added in the
+ * order of their `shapeIndex` and `instanceIndex`. The buffers need to outlive the builder and its scenes.
+ */
+class SceneBuilder {
+public:
+    /// The global buffers of `ShapeBuilder`, vertex attributes need to be uncompressed (see `buildShadingContext`)
+    struct Buffers {
+        const Vertex *vertices = nullptr;
+        const Normal *normals = nullptr;
+        const TexCoord *texCoords = nullptr;
+        IndexTriplet *indices = nullptr;
+        MaterialIndex *materials = nullptr;
+        /// whether Metal acceleration structures are built over the same buffers, which rules out reordering faces
+        bool isShared = false;
+    };
+    
+    struct Settings {
+        bvh::BuildSettings shapes;
+        bvh::BuildSettings instances;
+        /**
+         * `NodeLayout::Compressed` permutes the faces of every shape within the buffers (see
+         * `Tlas::addShapeInLeafOrder`), which is only valid if no Metal acceleration structure refers to them.
+         * Shared buffers (see `Buffers::isShared`) and paged shapes therefore always use `NodeLayout::Wide`.
+         */
+        bvh::NodeLayout nodeLayout = bvh::NodeLayout::Wide;
+        /**
+         * If nonzero, the shapes are read from their mesh caches (see `setMeshCache`) through a `PagedGeometry` that
+         * keeps about this many bytes of them in memory, and the buffers are not used at all
+         */
+        size_t memoryBudget = 0;
+    };
+    
+    explicit SceneBuilder(const Buffers &buffers) : m_buffers(buffers) {}
+    
+    /**
+     * The hierarchy of the shape is read from `cachePath` (see `rbvh::readOrBuildBlas`) if it was built from the same
+     * triangles, and written there otherwise. Without a cache path the hierarchy is always built.
+     * @returns index of the shape, which corresponds to `shapeIndex` of `ShapeBuilder`
+     */
+    uint32_t addShape(VertexIndex vertexOffset, FaceIndex faceOffset, FaceIndex faceCount,
+                      const std::string &cachePath = std::string());
+    
+    /**
+     * Names the mesh cache (see `rmesh::write`) that holds the contents of a shape, which is needed to page the shape
+     * in with `Settings::memoryBudget`. Material indices are resolved through `palette` like `MeshCache` does.
+     */
+    void setMeshCache(uint32_t shape, const std::string &path, const MaterialIndex *palette, size_t paletteSize);
+    
+    /**
+     * Places a shape with the transform and visibility of the instance data, which is copied. The vertex and face
+     * offsets of the instance are those of the shape, in the buffers or in the paged geometry.
+     * @returns index of the instance, which corresponds to `instanceIndex` of `EntityBuilder`
+     */
+    uint32_t addInstance(uint32_t shape, const DevicePerInstanceData &data);
+    
+    /**
+     * Builds or reads the hierarchies of all shapes on `ThreadPool::shared()`, then builds the top level hierarchy
+     * @returns false if a memory budget is set and the mesh cache of a shape cannot be mapped or does not match it
+     */
+    bool build(const Settings &settings);
+    bool build() { return build(Settings()); }
+    
+    /** @returns scene that renders what has been built with the given camera and shaders, which need to outlive it */
+    Scene scene(const DeviceCamera &camera, const Shaders &shaders) const;
+    
+    const bvh::Tlas &accelerationStructure() const { return m_tlas; }
+    /// Geometry that the scenes read if the last build had a memory budget, nullptr otherwise
+    const PagedGeometry *geometry() const { return m_geometry.get(); }
+
+private:
+    struct Shape {
+        VertexIndex vertexOffset;
+        FaceIndex faceOffset;
+        FaceIndex faceCount;
+        std::string cachePath;
+        std::string meshCachePath;
+        std::vector<MaterialIndex> palette;
+        /// index of the shape in `m_tlas`, assigned by `build`
+        uint32_t tlasShape = 0;
+    };
+    
+    Buffers m_buffers;
+    std::vector<Shape> m_shapes;
+    std::vector<uint32_t> m_instanceShapes;
+    std::vector<DevicePerInstanceData> m_instanceData;
+    bvh::Tlas m_tlas;
+    /// unique shapes in the order of `build`, only if the shapes are paged
+    std::unique_ptr<PagedGeometry> m_geometry;
+};
+
+}
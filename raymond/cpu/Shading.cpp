@@ -0,0 +1,212 @@
+#include "Shading.hpp"
+
+#include <limits>
+
+namespace raymond::cpu {
+
+namespace {
+
+/// Port of `warp::uniformSquareToCosineWeightedHemisphere`
+Vec3 uniformSquareToCosineWeightedHemisphere(float u, float v) {
+    const float cosTheta = std::sqrt(u);
+    const float sinTheta = std::sqrt(1 - square(cosTheta));
+    const float phi = 2 * Pi * v;
+    return { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+}
+
+/// Port of `warp::uniformSquareToSphere`
+Vec3 uniformSquareToSphere(float u, float v) {
+    const float z = 1 - 2 * v;
+    const float r = safeSqrt(1 - z * z);
+    const float phi = 2 * Pi * u;
+    return { r * std::cos(phi), r * std::sin(phi), z };
+}
+
+Vec3 interpolate(const Vec3 &a, const Vec3 &b, const Vec3 &c, float u, float v) {
+    return a * u + b * v + c * (1 - u - v);
+}
+
+float safeDivide(float a, float b, float fallback) {
+    return b == 0 ? fallback : a / b;
+}
+
+}
+
+// MARK: - Material
+
+Vec3 Material::evaluate(const Vec3 &wo, const Vec3 &wi, const Vec3 &shNormal, const Vec3 &geoNormal, float &pdf) const {
+    pdf = 0;
+    
+    const Frame frame(shNormal);
+    const Vec3 localWo = frame.toLocal(wo);
+    if (localWo.z * dot(wo, geoNormal) < 0) {
+        return Vec3(0);
+    }
+    
+    const Vec3 localWi = frame.toLocal(wi);
+    if (localWi.z * dot(wi, geoNormal) < 0) {
+        return Vec3(0);
+    }
+    
+    if (!(localWi.z * localWo.z > 0)) {
+        return Vec3(0);
+    }
+    
+    pdf = std::abs(localWi.z) / Pi;
+    const Vec3 value = pdf * diffuse;
+    
+    pdf *= alpha;
+    return value * alpha;
+}
+
+BsdfSample Material::sample(const Vec3 &rnd, const Vec3 &wo, const Vec3 &shNormal, const Vec3 &geoNormal, RayFlags previousFlags) const {
+    if (!(rnd.x < alpha)) {
+        BsdfSample sample;
+        sample.weight = Vec3(1);
+        sample.wi = -wo;
+        sample.pdf = 1;
+        sample.flags = RayFlags(previousFlags | RayFlagsSingular); /// null scattering does not alter ray flags
+        return sample;
+    }
+    
+    const Frame frame(shNormal);
+    const Vec3 localWo = frame.toLocal(wo);
+    if (localWo.z * dot(wo, geoNormal) < 0) {
+        return BsdfSample::invalid();
+    }
+    
+    BsdfSample sample;
+    Vec3 localWi = uniformSquareToCosineWeightedHemisphere(rnd.y, rnd.z);
+    if (!(localWi.z * localWo.z > 0)) {
+        localWi = -localWi;
+    }
+    
+    sample.pdf = std::abs(localWi.z) / Pi;
+    if (!(sample.pdf > 0)) {
+        return BsdfSample::invalid();
+    }
+    
+    sample.weight = diffuse * alpha;
+    sample.pdf *= alpha;
+    sample.flags = RayFlags(RayFlagsReflection | RayFlagsDiffuse);
+    
+    sample.wi = frame.toWorld(localWi);
+    if (localWi.z * dot(sample.wi, geoNormal) < 0) {
+        return BsdfSample::invalid();
+    }
+    
+    return sample;
+}
+
+// MARK: - MaterialTable
+
+void MaterialTable::shadeSurface(MaterialIndex shaderIndex, ShadingContext &shading) const {
+    shading.material = shaderIndex < materials.size() ? materials[shaderIndex] : Material();
+}
+
+void MaterialTable::evaluateEnvironment(ShadingContext &shading) const {
+    shading.position = shading.wo;
+    shading.normal = shading.wo;
+    shading.trueNormal = shading.wo;
+    shading.generated = -shading.wo;
+    shading.object = -shading.wo;
+    shading.uv = Vec3(0);
+    
+    shading.material = Material();
+    shading.material.emission = environment;
+}
+
+float MaterialTable::envmapPdf(const Vec3 &) const {
+    return 1 / (4 * Pi);
+}
+
+float MaterialTable::shapePdf(const DevicePerInstanceData &, const ShadingContext &) const {
+    /// emissive surfaces are never sampled as lights, so BSDF sampling gets the full weight
+    return 0;
+}
+
+LightSample MaterialTable::sampleLight(const ShadingContext &, Prng &prng) const {
+    /// the environment is the only light, but the selection still consumes a random number like `Lights::sample`
+    prng.sampleInt(1);
+    
+    LightSample sample;
+    const float u = prng.sample();
+    const float v = prng.sample();
+    sample.direction = uniformSquareToSphere(u, v);
+    sample.pdf = envmapPdf(sample.direction);
+    sample.distance = std::numeric_limits<float>::infinity();
+    sample.castsShadows = true;
+    sample.canBeHit = true;
+    sample.weight = environment / sample.pdf;
+    
+    const float survivalProbability = std::min(std::max(4 * mean(sample.weight), 0.f), 1.f);
+    if (survivalProbability < 1) {
+        if (prng.sample() < survivalProbability) {
+            sample.weight = sample.weight / survivalProbability;
+        } else {
+            sample.weight = Vec3(0);
+        }
+    }
+    
+    return sample;
+}
+
+// MARK: - ShadingContext
+
+void buildShadingContext(
+    const Scene &scene,
+    const DevicePerInstanceData &instance,
+    const DeviceIntersection &isect,
+    ShadingContext &shading,
+    MaterialIndex &shaderIndex
+) {
+    const float u = isect.coordinates.x;
+    const float v = isect.coordinates.y;
+    
+    const unsigned int faceIndex = instance.faceOffset + isect.primitiveIndex;
+    const IndexTriplet triangle = scene.triangle(faceIndex);
+    const unsigned int idx0 = instance.vertexOffset + triangle.x;
+    const unsigned int idx1 = instance.vertexOffset + triangle.y;
+    const unsigned int idx2 = instance.vertexOffset + triangle.z;
+    
+    if (scene.hasTexCoords()) {
+        auto texcoord = [&](unsigned int idx) {
+            const TexCoord uv = scene.texCoord(idx);
+            return Vec3(uv.x, uv.y, 0);
+        };
+        shading.uv = interpolate(texcoord(idx0), texcoord(idx1), texcoord(idx2), u, v);
+    } else {
+        shading.uv = Vec3(0);
+    }
+    
+    const Vec3 Pc = scene.vertex(idx2);
+    const Vec3 P0 = Vec3(scene.vertex(idx0)) - Pc;
+    const Vec3 P1 = Vec3(scene.vertex(idx1)) - Pc;
+    shading.trueNormal = normalize(transform(instance.normalTransform, cross(P0, P1)));
+    
+    const Vec3 localP = P0 * u + P1 * v + Pc;
+    const Vec3 boundsMin = load(instance.boundsMin);
+    const Vec3 boundsSize = load(instance.boundsSize);
+    shading.object = localP;
+    shading.generated = Vec3(
+        safeDivide(localP.x - boundsMin.x, boundsSize.x, 0.5f),
+        safeDivide(localP.y - boundsMin.y, boundsSize.y, 0.5f),
+        safeDivide(localP.z - boundsMin.z, boundsSize.z, 0.5f));
+    shading.position = transformPoint(instance.pointTransform, localP);
+    
+    if (scene.hasNormals()) {
+        shading.normal = normalize(transform(instance.normalTransform, interpolate(
+            scene.normal(idx0),
+            scene.normal(idx1),
+            scene.normal(idx2),
+            u, v)));
+    } else {
+        shading.normal = shading.trueNormal;
+    }
+    
+    shading.distance = isect.distance;
+    
+    shaderIndex = scene.material(faceIndex);
+}
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "Math.hpp"
+#include "Prng.hpp"
+
+#include <bridge/Camera.hpp>
+#include <bridge/PerInstanceData.hpp>
+#include <bridge/Ray.hpp>
+#include <bvh/Tlas.hpp>
+
+#include <vector>
+
+namespace raymond::cpu {
+
+/// Counterpart of `BsdfSample`
+struct BsdfSample {
+    float pdf;
+    Vec3 wi;
+    Vec3 weight;
+    RayFlags flags;
+    
+    static BsdfSample invalid() {
+        BsdfSample result;
+        result.pdf = 0;
+        result.wi = Vec3(0);
+        result.weight = Vec3(0);
+        result.flags = RayFlags(0);
+        return result;
+    }
+};
+
+/// Counterpart of `LightSample`, with the emission of the light already included in `weight`
+struct LightSample {
+    bool canBeHit = false;
+    bool castsShadows = false;
+    Vec3 weight { 0 };
+    float pdf = 0;
+    Vec3 direction { 0 };
+    float distance = 0;
+};
+
+/**
+ * The subset of `UberShader` that the CPU backend supports: a Lambertian lobe with optional null scattering through
+ * `alpha`. Evaluation and sampling follow `UberShader` with only the diffuse lobe enabled, so that scenes made of
+ * diffuse materials render the same on both backends.
+ */
+struct Material {
+    Vec3 diffuse { 0 };
+    Vec3 emission { 0 };
+    float alpha = 1;
+    /// shading normal, zero means that the true normal is used
+    Vec3 normal { 0 };
+    
+    Vec3 evaluate(const Vec3 &wo, const Vec3 &wi, const Vec3 &shNormal, const Vec3 &geoNormal, float &pdf) const;
+    BsdfSample sample(const Vec3 &rnd, const Vec3 &wo, const Vec3 &shNormal, const Vec3 &geoNormal, RayFlags previousFlags) const;
+};
+
+/// Counterpart of the device `ShadingContext`, tangents are left out since no CPU material uses them
+struct ShadingContext {
+    Vec3 uv;
+    Vec3 position;
+    Vec3 generated;
+    Vec3 object;
+    Vec3 normal;
+    Vec3 trueNormal;
+    Vec3 rnd;
+    Vec3 wo; // pointing away from the hitpoint
+    float distance;
+    RayFlags rayFlags;
+    
+    Material material;
+    
+    float geometryTerm() const {
+        return std::abs(dot(wo, trueNormal)) / square(distance);
+    }
+};
+
+/**
+ * Stand-in for the JIT compiled parts of the Metal backend (`shadeSurface`, `shadeLight` and the light sampling of
+ * `Lights`), which are generated from the scene's shader graphs and only exist as Metal code.
+ */
+class Shaders {
+public:
+    virtual ~Shaders() = default;
+    
+    /// Counterpart of `shadeSurface`, writes `shading.material`
+    virtual void shadeSurface(MaterialIndex shaderIndex, ShadingContext &shading) const = 0;
+    /// Counterpart of `Lights::evaluateEnvironment`, writes the emission of the environment seen in direction `-shading.wo`
+    virtual void evaluateEnvironment(ShadingContext &shading) const = 0;
+    
+    /// Counterpart of `Lights::envmapPdf`, including the light selection probability
+    virtual float envmapPdf(const Vec3 &direction) const = 0;
+    /// Counterpart of `Lights::shapePdf`, including the light selection probability
+    virtual float shapePdf(const DevicePerInstanceData &instance, const ShadingContext &shading) const = 0;
+    /// Counterpart of `Lights::sample`
+    virtual LightSample sampleLight(const ShadingContext &shading, Prng &prng) const = 0;
+};
+
+/**
+ * Default `Shaders` with one constant `Material` per `MaterialIndex` and a uniformly emitting environment as the only
+ * light, which is sampled uniformly over the sphere. Emissive surfaces are only found by BSDF sampling.
+ */
+class MaterialTable : public Shaders {
+public:
+    std::vector<Material> materials;
+    Vec3 environment { 0 };
+    
+    void shadeSurface(MaterialIndex shaderIndex, ShadingContext &shading) const override;
+    void evaluateEnvironment(ShadingContext &shading) const override;
+    float envmapPdf(const Vec3 &direction) const override;
+    float shapePdf(const DevicePerInstanceData &instance, const ShadingContext &shading) const override;
+    LightSample sampleLight(const ShadingContext &shading, Prng &prng) const override;
+};
+
+/// Counterpart of the device `Context`: the scene buffers that `ShapeBuilder` and `EntityBuilder` create, the camera and the shaders
+struct Scene {
+    const Vertex *vertices = nullptr;
+    const IndexTriplet *vertexIndices = nullptr;
+    const Normal *vertexNormals = nullptr;
+    const TexCoord *texcoords = nullptr;
+    const DevicePerInstanceData *perInstanceData = nullptr;
+    const MaterialIndex *materials = nullptr;
+    
+    /// if set, the geometry above is read from the pages of `geometry` instead and its pointers can be null
+    PagedGeometry *geometry = nullptr;
+    
+    DeviceCamera camera;
+    const bvh::Tlas *accelerationStructure = nullptr;
+    const Shaders *shaders = nullptr;
+    
+    IndexTriplet triangle(FaceIndex face) const {
+        return geometry ? geometry->threadReader().indices(face) : vertexIndices[face];
+    }
+    Vertex vertex(VertexIndex index) const {
+        return geometry ? geometry->threadReader().vertex(index) : vertices[index];
+    }
+    bool hasNormals() const { return geometry || vertexNormals; }
+    Normal normal(VertexIndex index) const {
+        return geometry ? geometry->threadReader().normal(index) : vertexNormals[index];
+    }
+    bool hasTexCoords() const { return geometry || texcoords; }
+    TexCoord texCoord(VertexIndex index) const {
+        return geometry ? geometry->threadReader().texCoord(index) : texcoords[index];
+    }
+    MaterialIndex material(FaceIndex face) const {
+        return geometry ? geometry->threadReader().material(face) : materials[face];
+    }
+};
+
+/**
+ * Port of `ShadingContext::build`: interpolates the geometry of the hit point and looks up its material.
+ * Expects uncompressed vertex attributes, i.e. no `COMPACT_VERTEX_ATTRIBUTES`.
+ */
+void buildShadingContext(
+    const Scene &scene,
+    const DevicePerInstanceData &instance,
+    const DeviceIntersection &isect,
+    ShadingContext &shading,
+    MaterialIndex &shaderIndex
+);
+
+}
@@ -0,0 +1,150 @@
+#include "Sorting.hpp"
+
+#include <utils/Morton.hpp>
+#include <utils/ThreadPool.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace raymond::cpu {
+
+namespace {
+
+/// rays per task, few enough tasks that the per-chunk histograms stay small
+constexpr uint32_t SortChunkSize = 1 << 14;
+
+/** @returns octahedral mapping of a unit vector to `[0, 1]^2` */
+void octahedral(const Vec3 &direction, float &u, float &v) {
+    const float norm = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    float x = direction.x / norm;
+    float y = direction.y / norm;
+    if (direction.z < 0) {
+        const float foldedX = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+        const float foldedY = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+        x = foldedX;
+        y = foldedY;
+    }
+    u = x * 0.5f + 0.5f;
+    v = y * 0.5f + 0.5f;
+}
+
+/** @returns key of a ray, zero for misses and `1 + MaterialIndex` for hits */
+uint32_t materialKey(const Scene &scene, const DeviceIntersection &isect) {
+    if (isect.distance <= 0.0f) return 0;
+    
+    const DevicePerInstanceData &instance = scene.perInstanceData[isect.instanceIndex];
+    return 1 + uint32_t(scene.material(instance.faceOffset + isect.primitiveIndex));
+}
+
+}
+
+void sortByMaterial(
+    const Scene &scene,
+    const DeviceIntersection *intersections,
+    uint32_t count,
+    uint32_t *order,
+    SortBuffers &buffers
+) {
+    if (count == 0) return;
+    
+    const uint32_t chunkCount = (count + SortChunkSize - 1) / SortChunkSize;
+    buffers.keys.resize(count);
+    
+    /// pass 1: compute keys and find how many buckets are needed
+    std::atomic<uint32_t> maxKey { 0 };
+    ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        const uint32_t begin = uint32_t(chunk) * SortChunkSize;
+        const uint32_t end = std::min(count, begin + SortChunkSize);
+        
+        uint32_t chunkMax = 0;
+        for (uint32_t i = begin; i < end; i++) {
+            buffers.keys[i] = materialKey(scene, intersections[i]);
+            chunkMax = std::max(chunkMax, buffers.keys[i]);
+        }
+        
+        uint32_t current = maxKey.load(std::memory_order_relaxed);
+        while (current < chunkMax && !maxKey.compare_exchange_weak(current, chunkMax, std::memory_order_relaxed));
+    });
+    
+    const uint32_t bucketCount = maxKey.load() + 1;
+    buffers.histograms.assign(size_t(bucketCount) * chunkCount, 0);
+    
+    /// pass 2: histogram of every chunk
+    ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        const uint32_t begin = uint32_t(chunk) * SortChunkSize;
+        const uint32_t end = std::min(count, begin + SortChunkSize);
+        for (uint32_t i = begin; i < end; i++) {
+            buffers.histograms[size_t(buffers.keys[i]) * chunkCount + chunk]++;
+        }
+    });
+    
+    /// exclusive prefix sum, bucket-major so that earlier chunks precede later ones within each bucket
+    uint32_t offset = 0;
+    for (uint32_t &entry : buffers.histograms) {
+        const uint32_t size = entry;
+        entry = offset;
+        offset += size;
+    }
+    
+    /// pass 3: scatter ray indices, each chunk walks its rays in order which keeps the permutation stable
+    ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        const uint32_t begin = uint32_t(chunk) * SortChunkSize;
+        const uint32_t end = std::min(count, begin + SortChunkSize);
+        for (uint32_t i = begin; i < end; i++) {
+            order[buffers.histograms[size_t(buffers.keys[i]) * chunkCount + chunk]++] = i;
+        }
+    });
+}
+
+void sortByOriginAndDirection(
+    const DeviceRay *rays,
+    uint32_t count,
+    const bvh::Bounds &bounds,
+    uint32_t *order,
+    SortBuffers &buffers
+) {
+    if (count == 0) return;
+    
+    buffers.rayKeys.resize(count);
+    buffers.rayKeysScratch.resize(count);
+    
+    /// cubic cells like `buildLbvh`, so that flat scenes are not sorted along their thin axis first
+    const Vec3 extent = bounds.extent();
+    const float maxExtent = std::max(std::max(extent.x, extent.y), extent.z);
+    const float scale = maxExtent > 0 ? 255.99f / maxExtent : 0;
+    
+    const uint32_t chunkCount = (count + SortChunkSize - 1) / SortChunkSize;
+    ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        const uint32_t begin = uint32_t(chunk) * SortChunkSize;
+        const uint32_t end = std::min(count, begin + SortChunkSize);
+        for (uint32_t i = begin; i < end; i++) {
+            const DeviceRay &ray = rays[i];
+            auto quantize = [](float value, float maximum) {
+                return value > 0 ? uint32_t(std::min(value, maximum)) : 0;
+            };
+            
+            const Vec3 position = (Vec3(ray.origin) - bounds.min) * scale;
+            const uint32_t originCode = morton::encode(
+                quantize(position.x, 255), quantize(position.y, 255), quantize(position.z, 255));
+            
+            float u, v;
+            octahedral(ray.direction, u, v);
+            const uint32_t directionCode =
+                morton::spreadBits2(quantize(u * 16, 15)) << 1 |
+                morton::spreadBits2(quantize(v * 16, 15));
+            
+            const uint32_t code = originCode << 8 | directionCode;
+            buffers.rayKeys[i] = uint64_t(code) << 32 | i;
+        }
+    });
+    
+    morton::sortKeys(buffers.rayKeys, buffers.rayKeysScratch, count);
+    
+    ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        const uint32_t begin = uint32_t(chunk) * SortChunkSize;
+        const uint32_t end = std::min(count, begin + SortChunkSize);
+        for (uint32_t i = begin; i < end; i++) order[i] = uint32_t(buffers.rayKeys[i]);
+    });
+}
+
+}
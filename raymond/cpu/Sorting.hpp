@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Shading.hpp"
+
+#include <bridge/Ray.hpp>
+#include <bvh/Bounds.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace raymond::cpu {
+
+/// Scratch memory of the sorting stages, kept across frames so that sorting does not allocate
+struct SortBuffers {
+    std::vector<uint32_t> keys;
+    /// one histogram per chunk of rays, stored bucket-major so that the prefix sum yields stable offsets
+    std::vector<uint32_t> histograms;
+    /// sort keys of `sortByOriginAndDirection`, code in the upper and ray index in the lower 32 bits
+    std::vector<uint64_t> rayKeys;
+    std::vector<uint64_t> rayKeysScratch;
+};
+
+/**
+ * Computes a stable permutation that groups rays by what `handleIntersections` will do with them: misses come first,
+ * followed by the hits of each `MaterialIndex` in ascending order. Shading rays in this order runs the same shader
+ * for long stretches of rays instead of jumping between unrelated materials.
+ * Implemented as a parallel counting sort with one histogram per chunk of rays, the number of buckets is the largest
+ * material index that occurs plus two.
+ * @param order receives `count` ray indices
+ */
+void sortByMaterial(
+    const Scene &scene,
+    const DeviceIntersection *intersections,
+    uint32_t count,
+    uint32_t *order,
+    SortBuffers &buffers
+);
+
+/**
+ * Computes a permutation that orders rays along a Morton curve, first over their origins (quantized to 256 cubes along
+ * the largest axis of `bounds`) and then over their directions (16 by 16 cells of the octahedral mapping). Rays that
+ * start close to each other and travel in similar directions end up next to each other, which restores the locality
+ * of traversal that compaction through `atomic_fetch_add` destroys.
+ * Sorted with a parallel least significant digit radix sort, digits that all rays share are skipped.
+ * @param order receives `count` ray indices
+ */
+void sortByOriginAndDirection(
+    const DeviceRay *rays,
+    uint32_t count,
+    const bvh::Bounds &bounds,
+    uint32_t *order,
+    SortBuffers &buffers
+);
+
+}
@@ -15,8 +15,13 @@ using namespace metal;
 struct Context {
     device const Vertex *vertices                 [[id(ContextBufferVertices)]];
     device const IndexTriplet *vertexIndices      [[id(ContextBufferVertexIndices)]];
+#ifdef COMPACT_VERTEX_ATTRIBUTES
+    device const PackedNormal *vertexNormals      [[id(ContextBufferNormals)]];
+    device const PackedTexCoord *texcoords        [[id(ContextBufferTexcoords)]];
+#else
     device const Normal *vertexNormals            [[id(ContextBufferNormals)]];
     device const TexCoord *texcoords              [[id(ContextBufferTexcoords)]];
+#endif
     device const PerInstanceData *perInstanceData [[id(ContextBufferPerInstanceData)]];
     device const MaterialIndex *materials         [[id(ContextBufferMaterials)]];
     
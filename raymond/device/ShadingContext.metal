@@ -1,6 +1,34 @@
 #include "ShadingContext.hpp"
 #include "Context.hpp"
 
+#ifdef COMPACT_VERTEX_ATTRIBUTES
+/// Inverse of `encodeOctahedral` in mesh/compression.cpp
+float3 decodeOctahedral(PackedNormal packed) {
+    const float2 e = unpack_snorm2x16_to_float(packed);
+    float3 n = float3(e, 1 - abs(e.x) - abs(e.y));
+    if (n.z < 0) {
+        n.xy = (1 - abs(n.yx)) * select(float2(-1), float2(1), n.xy >= 0);
+    }
+    return normalize(n);
+}
+
+float3 fetchNormal(device const Context &ctx, unsigned int idx) {
+    return decodeOctahedral(ctx.vertexNormals[idx]);
+}
+
+float2 fetchTexcoord(device const Context &ctx, unsigned int idx) {
+    return float2(ctx.texcoords[idx]);
+}
+#else
+float3 fetchNormal(device const Context &ctx, unsigned int idx) {
+    return float3(ctx.vertexNormals[idx]);
+}
+
+float2 fetchTexcoord(device const Context &ctx, unsigned int idx) {
+    return ctx.texcoords[idx];
+}
+#endif
+
 void ShadingContext::build(
     device const Context &ctx,
     device const PerInstanceData &instance,
@@ -14,10 +42,10 @@ void ShadingContext::build(
     const unsigned int idx1 = instance.vertexOffset + ctx.vertexIndices[faceIndex].y;
     const unsigned int idx2 = instance.vertexOffset + ctx.vertexIndices[faceIndex].z;
     
-    float2 Tc = ctx.texcoords[idx2];
+    float2 Tc = fetchTexcoord(ctx, idx2);
     float2x2 T;
-    T.columns[0] = ctx.texcoords[idx0] - Tc;
-    T.columns[1] = ctx.texcoords[idx1] - Tc;
+    T.columns[0] = fetchTexcoord(ctx, idx0) - Tc;
+    T.columns[1] = fetchTexcoord(ctx, idx1) - Tc;
     uv = float3(T * barycentric + Tc, 0);
     
     float3 Pc = ctx.vertices[idx2];
@@ -32,9 +60,9 @@ void ShadingContext::build(
     position = (instance.pointTransform * float4(localP, 1)).xyz;
     
     normal = instance.normalTransform * interpolate(
-        float3(ctx.vertexNormals[idx0]),
-        float3(ctx.vertexNormals[idx1]),
-        float3(ctx.vertexNormals[idx2]),
+        fetchNormal(ctx, idx0),
+        fetchNormal(ctx, idx1),
+        fetchNormal(ctx, idx2),
         barycentric);
     normal = normalize(normal);
     
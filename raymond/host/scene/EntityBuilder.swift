@@ -3,7 +3,7 @@ import Metal
 import MetalPerformanceShaders
 import Rayjay
 
-fileprivate extension simd_float4x4 {
+extension simd_float4x4 {
     var inner3x3: simd_float3x3 {
         .init(
             SIMD3(self[0, 0], self[0, 1], self[0, 2]),
@@ -25,8 +25,10 @@ fileprivate extension simd_float4x4 {
 class EntityBuilder {
     struct Result {
         let accelerationStructure: MTLAccelerationStructure
+        let instanceData: UnsafeMutablePointer<DevicePerInstanceData>
         let boundsMin: float3
         let boundsMax: float3
+        let updater: EntityUpdater
     }
     
     private struct Instance {
@@ -36,16 +38,23 @@ class EntityBuilder {
         let transform: simd_float4x4
         let visibility: RayFlags
     }
-
+    
     private let library: [String: Entity]
     private let lightBuilder: LightBuilder
     private let shapeBuilder: ShapeBuilder
+    private let accelerationQuality: AccelerationStructureQuality
     private var instances: [Instance] = []
     
-    public init(library: [String: Entity], lightBuilder: LightBuilder, shapeBuilder: ShapeBuilder) throws {
+    public init(
+        library: [String: Entity],
+        lightBuilder: LightBuilder,
+        shapeBuilder: ShapeBuilder,
+        accelerationQuality: AccelerationStructureQuality = .high
+    ) throws {
         self.library = library
         self.lightBuilder = lightBuilder
         self.shapeBuilder = shapeBuilder
+        self.accelerationQuality = accelerationQuality
         
         for entity in library.values {
             try shapeBuilder.index(of: entity.shape)
@@ -84,15 +93,9 @@ class EntityBuilder {
     ) throws -> Result {
         try library.values.forEach(add)
         
-        var (instanceBuffer, instanceData) = device.makeBufferAndPointer(
+        let (instanceBuffer, instanceDataStart) = device.makeBufferAndPointer(
             type: DevicePerInstanceData.self, count: instances.count, name: "Instance Data Buffer")
-        
-        var boundsMin = float3(repeating: +Float.infinity)
-        var boundsMax = float3(repeating: -Float.infinity)
-        func extendBounds(by point: float3) {
-            boundsMin = simd_min(boundsMin, point)
-            boundsMax = simd_max(boundsMax, point)
-        }
+        var instanceData = instanceDataStart
         
         for instance in instances {
             let normalTransform = instance.transform.inner3x3.inverse.transpose
@@ -127,19 +130,8 @@ class EntityBuilder {
                 visibility: instance.visibility)
             
             instanceData = instanceData.advanced(by: 1)
-
-            for i in 0..<8 {
-                var localPoint = instance.shapeInfo.boundsMin
-                for dim in 0..<3 {
-                    if i & (1 << dim) != 0 {
-                        localPoint[dim] = instance.shapeInfo.boundsMax[dim]
-                    }
-                }
-                let globalPoint = simd_mul(instance.transform, simd_float4(localPoint, 1))
-                extendBounds(by: .init(globalPoint.x, globalPoint.y, globalPoint.z) / globalPoint.w)
-            }
         }
-
+        
         encoder.setBuffer(instanceBuffer, offset: 0, index: ContextBufferIndex.perInstanceData.rawValue)
         resources.append(instanceBuffer)
         
@@ -162,13 +154,34 @@ class EntityBuilder {
         asDescriptor.instancedAccelerationStructures = shapes.accelerationStructures
         asDescriptor.instanceCount = instances.count
         asDescriptor.instanceDescriptorBuffer = instanceDescriptorBuffer
-        let accelerationStructure = newAccelerationStructureWithDescriptor(asDescriptor, on: device)
+        asDescriptor.usage = accelerationQuality.usage
         resources.append(contentsOf: shapes.accelerationStructures)
-
+        
+        /// builds the structure so that transforms can be changed later without rebuilding the scene
+        let updater = EntityUpdater(
+            device: device,
+            descriptor: asDescriptor,
+            instanceData: instanceDataStart,
+            localBounds: instances.map { .init(min: $0.shapeInfo.boundsMin, max: $0.shapeInfo.boundsMax) },
+            transforms: instances.map { $0.transform },
+            hasEmission: instances.map { $0.shapeInfo.hasEmission })
+        let bounds = updater.bounds
+        
         return .init(
-            accelerationStructure: accelerationStructure,
-            boundsMin: boundsMin,
-            boundsMax: boundsMax
+            accelerationStructure: updater.accelerationStructure,
+            instanceData: instanceDataStart,
+            boundsMin: bounds.min,
+            boundsMax: bounds.max,
+            updater: updater
         )
     }
+    
+    /// Adds all instances to the CPU counterpart of the scene, after `build` has written their instance data
+    func addInstances(to cpuScene: CpuScene, from result: Result) {
+        for instance in instances {
+            cpuScene.addInstance(
+                ofShape: instance.shapeIndex,
+                data: result.instanceData[Int(instance.instanceIndex)])
+        }
+    }
 }
@@ -0,0 +1,148 @@
+import Foundation
+import Metal
+import Rayjay
+
+fileprivate let log = SwiftLogger(named: "entity")
+
+/// Moves the entities of a loaded scene by patching their instance data and refitting the instance acceleration
+/// structure, the acceleration structures of the shapes stay untouched.
+class EntityUpdater {
+    struct Bounds {
+        var min = float3(repeating: +Float.infinity)
+        var max = float3(repeating: -Float.infinity)
+        
+        var halfArea: Float {
+            if min.x > max.x || min.y > max.y || min.z > max.z { return 0 }
+            let extent = max - min
+            return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x
+        }
+        
+        mutating func extend(by point: float3) {
+            min = simd_min(min, point)
+            max = simd_max(max, point)
+        }
+        
+        mutating func extend(by other: Bounds) {
+            min = simd_min(min, other.min)
+            max = simd_max(max, other.max)
+        }
+        
+        func transformed(by transform: simd_float4x4) -> Bounds {
+            var result = Bounds()
+            for i in 0..<8 {
+                var localPoint = min
+                for dim in 0..<3 {
+                    if i & (1 << dim) != 0 {
+                        localPoint[dim] = max[dim]
+                    }
+                }
+                let globalPoint = simd_mul(transform, simd_float4(localPoint, 1))
+                result.extend(by: .init(globalPoint.x, globalPoint.y, globalPoint.z) / globalPoint.w)
+            }
+            return result
+        }
+    }
+    
+    /// Refitting keeps the topology of the tree, so nodes grow to enclose both the old and new positions of moved
+    /// instances. The structure is rebuilt once this growth exceeds the given factor of the area after the last build.
+    var rebuildThreshold: Float = 1.5
+    
+    private(set) var accelerationStructure: MTLAccelerationStructure
+    
+    private let device: MTLDevice
+    private let queue: MTLCommandQueue
+    private let descriptor: MTLInstanceAccelerationStructureDescriptor
+    private let instanceData: UnsafeMutablePointer<DevicePerInstanceData>
+    private let instanceDescriptors: UnsafeMutablePointer<MTLAccelerationStructureInstanceDescriptor>
+    private var scratchBuffer: MTLBuffer?
+    
+    private let localBounds: [Bounds]
+    private let hasEmission: [Bool]
+    private var worldBounds: [Bounds]
+    private var builtBounds: [Bounds]
+    private var builtArea: Float = 0
+    
+    var bounds: Bounds {
+        worldBounds.reduce(into: Bounds()) { $0.extend(by: $1) }
+    }
+    
+    /// Builds the initial acceleration structure, the buffers need to stay alive as long as the updater is used
+    init(
+        device: MTLDevice,
+        descriptor: MTLInstanceAccelerationStructureDescriptor,
+        instanceData: UnsafeMutablePointer<DevicePerInstanceData>,
+        localBounds: [Bounds],
+        transforms: [simd_float4x4],
+        hasEmission: [Bool]
+    ) {
+        self.device = device
+        self.queue = device.makeCommandQueue()!
+        self.descriptor = descriptor
+        self.instanceData = instanceData
+        self.instanceDescriptors = descriptor.instanceDescriptorBuffer!.contents().assumingMemoryBound(
+            to: MTLAccelerationStructureInstanceDescriptor.self)
+        self.localBounds = localBounds
+        self.hasEmission = hasEmission
+        let worldBounds = zip(localBounds, transforms).map { $0.transformed(by: $1) }
+        self.worldBounds = worldBounds
+        self.builtBounds = worldBounds
+        
+        descriptor.usage.insert(.refit)
+        accelerationStructure = newAccelerationStructureWithDescriptor(descriptor, on: device, compact: false)
+        builtArea = builtBounds.reduce(0) { $0 + $1.halfArea }
+    }
+    
+    /**
+     * Changes the transforms of the given instances (indexed like `PerInstanceData`) and updates the instance
+     * acceleration structure. Must not be called while a frame using the scene is in flight.
+     * @returns whether the acceleration structure was rebuilt instead of refit, which replaces `accelerationStructure`
+     */
+    @discardableResult
+    func update(transforms: [InstanceIndex: simd_float4x4]) -> Bool {
+        for (instanceIndex, transform) in transforms {
+            let index = Int(instanceIndex)
+            if hasEmission[index] {
+                /// the light sampling data of emissive instances is baked by `LightBuilder`
+                log.warn("instance \(index) is emissive and cannot be moved without reloading the scene")
+                continue
+            }
+            
+            instanceData[index].pointTransform = transform
+            instanceData[index].normalTransform = transform.inner3x3.inverse.transpose
+            instanceDescriptors[index].transformationMatrix = transform.packed4x3
+            worldBounds[index] = localBounds[index].transformed(by: transform)
+        }
+        
+        var refitArea: Float = 0
+        for (built, current) in zip(builtBounds, worldBounds) {
+            var union = built
+            union.extend(by: current)
+            refitArea += union.halfArea
+        }
+        
+        if refitArea > rebuildThreshold * builtArea {
+            accelerationStructure = newAccelerationStructureWithDescriptor(descriptor, on: device, compact: false)
+            builtBounds = worldBounds
+            builtArea = builtBounds.reduce(0) { $0 + $1.halfArea }
+            return true
+        }
+        
+        let sizes = device.accelerationStructureSizes(descriptor: descriptor)
+        if (scratchBuffer?.length ?? 0) < sizes.refitScratchBufferSize {
+            scratchBuffer = device.makeBuffer(length: max(sizes.refitScratchBufferSize, 1), options: .storageModePrivate)
+        }
+        
+        let commandBuffer = queue.makeCommandBuffer()!
+        let commandEncoder = commandBuffer.makeAccelerationStructureCommandEncoder()!
+        commandEncoder.refit(
+            sourceAccelerationStructure: accelerationStructure,
+            descriptor: descriptor,
+            destinationAccelerationStructure: nil,
+            scratchBuffer: scratchBuffer,
+            scratchBufferOffset: 0)
+        commandEncoder.endEncoding()
+        commandBuffer.commit()
+        commandBuffer.waitUntilCompleted()
+        return false
+    }
+}
@@ -32,9 +32,12 @@ extension String {
 struct Codegen {
     struct Options {
         let externalCompile: Bool
+        /// must match the layout that `ShapeBuilder` uses for normal and texture coordinate buffers
+        let compactVertexAttributes: Bool
         
-        init(externalCompile: Bool = false) {
+        init(externalCompile: Bool = false, compactVertexAttributes: Bool = false) {
             self.externalCompile = externalCompile
+            self.compactVertexAttributes = compactVertexAttributes
         }
     }
     
@@ -216,7 +219,7 @@ struct Codegen {
     
     private mutating func loadTextures() throws {
         log.info("loading textures")
-        DispatchQueue.concurrentPerform(iterations: textureDescriptors.count) { index in
+        parallel_for(textureDescriptors.count) { index in
             if let url = textureDescriptors[index].url {
                 do {
                     textureDescriptors[index].texture = try textureLoader.newTexture(
@@ -268,6 +271,10 @@ struct Codegen {
         
         """
         
+        if options.compactVertexAttributes {
+            header += "#define COMPACT_VERTEX_ATTRIBUTES\n"
+        }
+        
         for index in 0..<textures.count {
             let pixelFormat = textures[index].pixelFormat
             header += "#define TEX\(index)_PIXEL_FORMAT kTexImage::PIXEL_FORMAT_\(try mapPixelFormat(pixelFormat))\n"
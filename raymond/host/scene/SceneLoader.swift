@@ -16,6 +16,11 @@ struct Scene {
     var boundsMin: float3
     var boundsMax: float3
     
+    /// Moves entities without reloading the scene, see `EntityUpdater`
+    let entityUpdater: EntityUpdater
+    /// Counterpart for the CPU renderer if requested by `SceneLoader.buildCpuScene`, does not follow `updateTransforms`
+    let cpuScene: CpuScene?
+    
     var camera: DeviceCamera {
         get {
             return argumentEncoder.get(at: ContextBufferIndex.camera.rawValue, DeviceCamera.self)
@@ -24,10 +29,35 @@ struct Scene {
             argumentEncoder.set(at: ContextBufferIndex.camera.rawValue, camera)
         }
     }
+    
+    /**
+     * Changes the transforms of the given instances, see `EntityUpdater.update(transforms:)`.
+     * Must not be called while a frame using the scene is in flight.
+     */
+    mutating func updateTransforms(_ transforms: [InstanceIndex: simd_float4x4]) {
+        let previous = accelerationStructure
+        if entityUpdater.update(transforms: transforms) {
+            /// a rebuild allocates a new structure, the old one must no longer be bound or made resident
+            accelerationStructure = entityUpdater.accelerationStructure
+            resourcesRead = resourcesRead.map { $0 === previous ? accelerationStructure : $0 }
+        }
+        
+        let bounds = entityUpdater.bounds
+        boundsMin = bounds.min
+        boundsMax = bounds.max
+    }
 }
 
 struct SceneLoader {
     var externalCompile: Bool = false
+    /// Stores normals octahedral encoded and texture coordinates in half precision
+    var compactVertexAttributes: Bool = false
+    /// Welds duplicate vertices and reorders triangles and vertices for memory locality
+    var optimizeMeshes: Bool = true
+    /// Use `.fast` for previews, where build latency matters more than trace speed
+    var accelerationQuality: AccelerationStructureQuality = .high
+    /// Also builds the hierarchies of the CPU renderer, see `CpuScene`, needs uncompressed vertex attributes
+    var buildCpuScene: Bool = false
     
     private func makeDefaultCamera() -> DeviceCamera {
         let transform = float4x4(rows: [
@@ -54,19 +84,25 @@ struct SceneLoader {
             library: sceneDescription.materials)
         let shapeBuilder = ShapeBuilder(
             library: sceneDescription.shapes,
-            materialBuilder: materialBuilder)
+            materialBuilder: materialBuilder,
+            compactVertexAttributes: compactVertexAttributes,
+            optimizeMeshes: optimizeMeshes,
+            accelerationQuality: accelerationQuality)
         let lightBuilder = LightBuilder(
             library: sceneDescription.lights,
             materialBuilder: materialBuilder)
         let entityBuilder = try EntityBuilder(
             library: sceneDescription.entities,
             lightBuilder: lightBuilder,
-            shapeBuilder: shapeBuilder)
+            shapeBuilder: shapeBuilder,
+            accelerationQuality: accelerationQuality)
         
         // STEP 1: build all the shaders, so the following stages can access pipeline state info
         let shading = try materialBuilder.build(
             withDevice: device,
-            options: .init(externalCompile: externalCompile))
+            options: .init(
+                externalCompile: externalCompile,
+                compactVertexAttributes: compactVertexAttributes))
         
         let (intersectionFunction, intersectionHandler) = try shading.makeComputePipelineState(
             for: "handleIntersections",
@@ -112,6 +148,20 @@ struct SceneLoader {
             encoder: argumentEncoder,
             resources: &resourcesRead)
         
+        var cpuScene: CpuScene?
+        if buildCpuScene {
+            precondition(!compactVertexAttributes, "the CPU renderer does not support compact vertex attributes")
+            cpuScene = CpuScene(
+                vertices: shapes.vertices,
+                normals: shapes.normals.assumingMemoryBound(to: Normal.self),
+                texCoords: shapes.texCoords.assumingMemoryBound(to: TexCoord.self),
+                indices: shapes.indices,
+                materials: shapes.materials)
+            shapeBuilder.addShapes(to: cpuScene!)
+            entityBuilder.addInstances(to: cpuScene!, from: entities)
+            cpuScene!.build()
+        }
+        
         var scene = Scene(
             accelerationStructure: entities.accelerationStructure,
             intersectionHandler: intersectionHandler,
@@ -122,7 +172,9 @@ struct SceneLoader {
             contextBuffer: contextBuffer,
             argumentEncoder: argumentEncoder,
             boundsMin: entities.boundsMin,
-            boundsMax: entities.boundsMax
+            boundsMax: entities.boundsMax,
+            entityUpdater: entities.updater,
+            cpuScene: cpuScene
         )
         
         var camera = makeDefaultCamera()
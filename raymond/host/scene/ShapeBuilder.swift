@@ -4,9 +4,22 @@ import Rayjay
 
 fileprivate let log = SwiftLogger(named: "mesh")
 
+/// Trade-off between building and tracing acceleration structures
+enum AccelerationStructureQuality {
+    /// builds with Metal's fast build preference and skips compaction, for previews and interactive editing
+    case fast
+    /// compacted structures that trace fastest, for final frames
+    case high
+    
+    var usage: MTLAccelerationStructureUsage {
+        self == .fast ? .preferFastBuild : []
+    }
+}
+
 func newAccelerationStructureWithDescriptor(
     _ descriptor: MTLAccelerationStructureDescriptor,
-    on device: MTLDevice
+    on device: MTLDevice,
+    compact: Bool = true
 ) -> MTLAccelerationStructure {
     // Query for the sizes needed to store and build the acceleration structure.
     let accelSize = device.accelerationStructureSizes(descriptor: descriptor)
@@ -37,6 +50,14 @@ func newAccelerationStructureWithDescriptor(
         scratchBuffer: scratchBuffer,
         scratchBufferOffset: 0)
     
+    if !compact {
+        // Structures that are refit later keep their conservative size.
+        commandEncoder.endEncoding()
+        commandBuffer.commit()
+        commandBuffer.waitUntilCompleted()
+        return accelerationStructure
+    }
+    
     // Compute and write the compacted acceleration structure size into the buffer. You
     // must already have a built acceleration structure because Metal determines the compacted
     // size based on the final size of the acceleration structure. Compacting an acceleration
@@ -56,7 +77,7 @@ func newAccelerationStructureWithDescriptor(
     
     // The sample waits for Metal to finish executing the command buffer so that it can
     // read back the compacted size.
-
+    
     // Note: Don't wait for Metal to finish executing the command buffer if you aren't compacting
     // the acceleration structure, as doing so requires CPU/GPU synchronization. You don't have
     // to compact acceleration structures, but do so when creating large static acceleration
@@ -99,10 +120,13 @@ class ShapeBuilder {
         let indices: UnsafeMutablePointer<IndexTriplet>
         let vertices: UnsafeMutablePointer<Vertex>
         let materials: UnsafeMutablePointer<MaterialIndex>
+        /// `PackedNormal` and `PackedTexCoord` elements if vertex attributes are compact
+        let normals: UnsafeMutableRawPointer
+        let texCoords: UnsafeMutableRawPointer
         
         let accelerationStructures: [MTLAccelerationStructure]
     }
-
+    
     struct ShapeInfo {
         var vertexOffset: VertexIndex
         var faceOffset: FaceIndex
@@ -114,15 +138,40 @@ class ShapeBuilder {
     
     private let library: [String: Shape]
     private var materialBuilder: MaterialBuilder
-    public init(library: [String: Shape], materialBuilder: MaterialBuilder) {
+    /// Stores normals as `PackedNormal` and texture coordinates as `PackedTexCoord`, see `Codegen.Options`
+    private let compactVertexAttributes: Bool
+    /// Welds and reorders meshes for memory locality after they have been parsed, see `optimize_mesh`
+    private let optimizeMeshes: Bool
+    private let accelerationQuality: AccelerationStructureQuality
+    
+    /// Bounds on the resources held by shapes that are loaded concurrently
+    struct LoadLimits {
+        /// files mapped or written at the same time
+        var maxOpenFiles = 32
+        /// estimated bytes held by shapes in flight (mapped files and scratch memory), see `ShapeHandle.workingSetSize`
+        var maxMemory = Int(ProcessInfo.processInfo.physicalMemory / 4)
+    }
+    var loadLimits = LoadLimits()
+    
+    public init(
+        library: [String: Shape],
+        materialBuilder: MaterialBuilder,
+        compactVertexAttributes: Bool = false,
+        optimizeMeshes: Bool = true,
+        accelerationQuality: AccelerationStructureQuality = .high
+    ) {
         self.library = library
         self.materialBuilder = materialBuilder
+        self.compactVertexAttributes = compactVertexAttributes
+        self.optimizeMeshes = optimizeMeshes
+        self.accelerationQuality = accelerationQuality
     }
     
     enum MeshLoaderError: Error {
         case unsupportedFormat
         case invalidShapeHeader
         case onlyTrianglesSupported
+        case malformedShapeData
     }
     
     private struct ShapeHandle {
@@ -142,14 +191,29 @@ class ShapeBuilder {
         var boundsMax: simd_float3
         
         var fileReader: PLYReader
+        var meshCache: MeshCache
+        /// whether an up to date `.rmesh` cache exists, in which case the PLY file does not need to be parsed
+        var isCached: Bool
+        /// size of the file that will be read, either the cache or the PLY file
+        var fileSize: Int
+        /// seconds spent loading this shape, including optimization and cache writing
+        var loadTime: Double = 0
+        /// hash of the final buffer contents of this shape, see `hash_mesh`
+        var contentHash: UInt64 = 0
+        /// index of an earlier shape with identical content whose buffer ranges this shape shares
+        var aliasOf: Int?
+        /// whether the element data turned out to be truncated or malformed while parsing
+        var isMalformed = false
         
         init(
             withPath url: URL,
             materialIndices: [MaterialIndex], emissiveMaterials: [Bool], hasEmission: Bool,
-            vertexOffset: VertexIndex, faceOffset: FaceIndex
+            vertexOffset: VertexIndex, faceOffset: FaceIndex,
+            requireOptimized: Bool
         ) throws {
             self.path = url.relativePath
             self.fileReader = PLYReader(url: url)
+            self.meshCache = MeshCache(sourceURL: url)
             
             self.materialIndices = materialIndices
             self.emissiveMaterials = emissiveMaterials
@@ -161,36 +225,41 @@ class ShapeBuilder {
             self.boundsMin = simd_float3(repeating: +Float.infinity)
             self.boundsMax = simd_float3(repeating: -Float.infinity)
             
-            // read header
-            
-            fileReader.assertLine("ply")
-            fileReader.assertLine("format ascii 1.0")
-            fileReader.assertToken("comment")
-            fileReader.readLine()
-            
-            fileReader.assertToken("element")
-            fileReader.assertToken("vertex")
-            vertexCount = VertexIndex(exactly: fileReader.readInt())!
+            if meshCache.open() && (meshCache.isOptimized || !requireOptimized) {
+                isCached = true
+                vertexCount = VertexIndex(meshCache.vertexCount)
+                faceCount = FaceIndex(meshCache.faceCount)
+                fileSize = meshCache.fileSize
+                meshCache.close()
+                return
+            }
+            meshCache.close()
             
-            fileReader.assertLine("property float x")
-            fileReader.assertLine("property float y")
-            fileReader.assertLine("property float z")
-            fileReader.assertLine("property float nx")
-            fileReader.assertLine("property float ny")
-            fileReader.assertLine("property float nz")
-            fileReader.assertLine("property float s")
-            fileReader.assertLine("property float t")
+            // read header
             
-            fileReader.assertToken("element")
-            fileReader.assertToken("face")
-            faceCount = FaceIndex(exactly: fileReader.readInt())!
+            isCached = false
+            guard fileReader.readHeader() else {
+                throw MeshLoaderError.invalidShapeHeader
+            }
             
-            fileReader.assertLine("property list uchar uint vertex_indices")
-            fileReader.assertLine("property uchar material_index")
-            fileReader.assertLine("end_header")
+            vertexCount = VertexIndex(fileReader.vertexCount)
+            faceCount = FaceIndex(fileReader.faceCount)
+            fileSize = fileReader.fileSize
             
             fileReader.close()
         }
+        
+        /// Estimates the memory touched while loading: the mapped file plus scratch buffers of the optional passes
+        func workingSetSize(optimize: Bool, compact: Bool) -> Int {
+            var size = fileSize
+            if !isCached && optimize {
+                size += 40 * Int(vertexCount) + 40 * Int(faceCount)
+            }
+            if compact {
+                size += (MemoryLayout<Normal>.stride + MemoryLayout<TexCoord>.stride) * Int(vertexCount)
+            }
+            return size
+        }
     }
     
     private var shapeIds: [String: InstanceIndex] = [:]
@@ -222,13 +291,24 @@ class ShapeBuilder {
         let emissiveMaterials = shape.materials.map(materialBuilder.hasMaterialEmission)
         let hasEmission = emissiveMaterials.contains(where: { $0 })
         
+        if let original = shapeHandles.firstIndex(where: {
+            $0.aliasOf == nil && $0.path == shape.filepath.relativePath && $0.materialIndices == materialIndices
+        }) {
+            /// the exporter writes linked duplicates as separate shapes referring to the same file
+            var shapeHandle = shapeHandles[original]
+            shapeHandle.aliasOf = original
+            shapeHandles.append(shapeHandle)
+            return
+        }
+        
         let shapeHandle = try ShapeHandle(
             withPath: shape.filepath,
             materialIndices: materialIndices,
             emissiveMaterials: emissiveMaterials,
             hasEmission: hasEmission,
             vertexOffset: vertexOffset,
-            faceOffset: faceOffset
+            faceOffset: faceOffset,
+            requireOptimized: optimizeMeshes
         )
         shapeHandles.append(shapeHandle)
         
@@ -256,50 +336,312 @@ class ShapeBuilder {
         let totalVertexCount = Int(vertexOffset)
         let totalFaceCount = Int(faceOffset)
         
-        let (vertexBuffer, vertices) = device.makeBufferAndPointer(
+        var (vertexBuffer, vertices) = device.makeBufferAndPointer(
             type: Vertex.self, count: totalVertexCount, name: "Vertex Buffer")
-        let (indexBuffer, indices) = device.makeBufferAndPointer(
+        var (indexBuffer, indices) = device.makeBufferAndPointer(
             type: IndexTriplet.self, count: totalFaceCount, name: "Index Buffer")
-        let (normalBuffer, normals) = device.makeBufferAndPointer(
-            type: Normal.self, count: totalVertexCount, name: "Normal Buffer")
-        let (texCoordBuffer, texCoords) = device.makeBufferAndPointer(
-            type: TexCoord.self, count: totalVertexCount, name: "UV Buffer")
-        let (materialBuffer, materials) = device.makeBufferAndPointer(
+        var (normalBuffer, texCoordBuffer) = compactVertexAttributes ? (
+            device.makeBuffer(type: PackedNormal.self, count: totalVertexCount, name: "Normal Buffer")!,
+            device.makeBuffer(type: PackedTexCoord.self, count: totalVertexCount, name: "UV Buffer")!
+        ) : (
+            device.makeBuffer(type: Normal.self, count: totalVertexCount, name: "Normal Buffer")!,
+            device.makeBuffer(type: TexCoord.self, count: totalVertexCount, name: "UV Buffer")!
+        )
+        var (materialBuffer, materials) = device.makeBufferAndPointer(
             type: MaterialIndex.self, count: totalFaceCount, name: "Material Buffer")
+        let normalStride = compactVertexAttributes ?
+            MemoryLayout<PackedNormal>.stride : MemoryLayout<Normal>.stride
+        let texCoordStride = compactVertexAttributes ?
+            MemoryLayout<PackedTexCoord>.stride : MemoryLayout<TexCoord>.stride
         
-        //DispatchQueue.concurrentPerform(iterations: shapeHandles.count) { index in
-        for index in 0..<shapeHandles.count {
-            var shapeHandle = shapeHandles[index]
-            log.debug("parsing shape \(shapeHandle.path)")
-            
-            shapeHandle.fileReader.reopen()
-            
-            let shapeVertices = vertices.advanced(by: Int(shapeHandle.vertexOffset))
-            shapeHandle.fileReader.readVertexElements(
-                shapeHandle.vertexCount,
-                vertices: shapeVertices,
-                normals: normals.advanced(by: Int(shapeHandle.vertexOffset)),
-                texCoords: texCoords.advanced(by: Int(shapeHandle.vertexOffset)),
-                boundsMin: &shapeHandle.boundsMin,
-                boundsMax: &shapeHandle.boundsMax)
+        let openFiles = ResourceBudget(capacity: loadLimits.maxOpenFiles)
+        let memory = ResourceBudget(capacity: loadLimits.maxMemory)
+        let loadStartTime = CFAbsoluteTimeGetCurrent()
+        
+        // shapes are loaded in parallel into their precomputed slices, each thread only writes its own handle
+        // (on the shared thread pool, which the PLY parser and BVH builds of each shape nest into)
+        shapeHandles.withUnsafeMutableBufferPointer { shapeHandles in
+            parallel_for(shapeHandles.count) { index in
+                var shapeHandle = shapeHandles[index]
+                if shapeHandle.aliasOf != nil { return }
+                
+                let workingSetSize = shapeHandle.workingSetSize(
+                    optimize: optimizeMeshes, compact: compactVertexAttributes)
+                memory.acquire(workingSetSize)
+                defer { memory.release(workingSetSize) }
+                
+                let startTime = CFAbsoluteTimeGetCurrent()
+                
+                let shapeVertices = vertices.advanced(by: Int(shapeHandle.vertexOffset))
+                let shapeNormals: UnsafeMutablePointer<Normal>
+                let shapeTexCoords: UnsafeMutablePointer<TexCoord>
+                if compactVertexAttributes {
+                    // attributes are read at full precision and compressed once the shape is complete
+                    shapeNormals = .allocate(capacity: Int(shapeHandle.vertexCount))
+                    shapeTexCoords = .allocate(capacity: Int(shapeHandle.vertexCount))
+                } else {
+                    shapeNormals = normalBuffer.contents().assumingMemoryBound(to: Normal.self)
+                        .advanced(by: Int(shapeHandle.vertexOffset))
+                    shapeTexCoords = texCoordBuffer.contents().assumingMemoryBound(to: TexCoord.self)
+                        .advanced(by: Int(shapeHandle.vertexOffset))
+                }
+                let shapeIndices = indices.advanced(by: Int(shapeHandle.faceOffset))
+                let shapeMaterials = materials.advanced(by: Int(shapeHandle.faceOffset))
+                
+                openFiles.acquire(1)
+                if shapeHandle.isCached {
+                    log.debug("loading cached shape \(shapeHandle.path)")
+                    
+                    shapeHandle.meshCache.reopen()
+                    shapeHandle.meshCache.readVertexElements(
+                        shapeHandle.vertexCount,
+                        vertices: shapeVertices,
+                        normals: shapeNormals,
+                        texCoords: shapeTexCoords,
+                        boundsMin: &shapeHandle.boundsMin,
+                        boundsMax: &shapeHandle.boundsMax)
+                    
+                    shapeHandle.materialIndices.withUnsafeBufferPointer { materialIndicesPtr in
+                        shapeHandle.meshCache.readFaces(
+                            shapeHandle.faceCount,
+                            indices: shapeIndices,
+                            materials: shapeMaterials,
+                            fromPalette: materialIndicesPtr.baseAddress!,
+                            paletteSize: UInt32(materialIndicesPtr.count))
+                    }
+                    
+                    shapeHandle.meshCache.close()
+                } else {
+                    log.debug("parsing shape \(shapeHandle.path)")
+                    
+                    var isParsed = shapeHandle.fileReader.reopen()
+                    if isParsed {
+                        isParsed = shapeHandle.fileReader.readVertexElements(
+                            shapeHandle.vertexCount,
+                            vertices: shapeVertices,
+                            normals: shapeNormals,
+                            texCoords: shapeTexCoords,
+                            boundsMin: &shapeHandle.boundsMin,
+                            boundsMax: &shapeHandle.boundsMax)
+                    }
+                    if isParsed {
+                        isParsed = shapeHandle.materialIndices.withUnsafeBufferPointer { materialIndicesPtr in
+                            shapeHandle.fileReader.readFaces(
+                                shapeHandle.faceCount,
+                                vertices: shapeVertices,
+                                normals: shapeNormals,
+                                indices: shapeIndices,
+                                materials: shapeMaterials,
+                                fromPalette: materialIndicesPtr.baseAddress!,
+                                paletteSize: UInt32(materialIndicesPtr.count))
+                        }
+                    }
+                    
+                    shapeHandle.fileReader.close()
+                    
+                    // the loop body cannot throw, malformed shapes are reported once all shapes are loaded
+                    if !isParsed {
+                        openFiles.release(1)
+                        if compactVertexAttributes {
+                            shapeNormals.deallocate()
+                            shapeTexCoords.deallocate()
+                        }
+                        shapeHandle.isMalformed = true
+                        shapeHandles[index] = shapeHandle
+                        return
+                    }
+                }
+                openFiles.release(1)
+                
+                let timeElapsed = CFAbsoluteTimeGetCurrent() - startTime
+                log.debug(String(format: "%@ %@, %.1f MB in %.1f ms (%.1f MB/s)",
+                    shapeHandle.isCached ? "loaded" : "parsed",
+                    shapeHandle.path,
+                    Double(shapeHandle.fileSize) / 1e+6,
+                    timeElapsed * 1e+3,
+                    Double(shapeHandle.fileSize) / timeElapsed / 1e+6))
+                
+                if !shapeHandle.isCached && optimizeMeshes {
+                    let optimizedVertexCount = optimize_mesh(
+                        shapeVertices, shapeNormals, shapeTexCoords, shapeHandle.vertexCount,
+                        shapeIndices, shapeMaterials, shapeHandle.faceCount)
+                    log.debug("optimized \(shapeHandle.path), \(shapeHandle.vertexCount) -> \(optimizedVertexCount) vertices")
+                    shapeHandle.vertexCount = optimizedVertexCount
+                }
+                
+                if !shapeHandle.isCached {
+                    let success = openFiles.using(1) {
+                        shapeHandle.materialIndices.withUnsafeBufferPointer { materialIndicesPtr in
+                            shapeHandle.meshCache.writeVertices(
+                                shapeVertices,
+                                normals: shapeNormals,
+                                texCoords: shapeTexCoords,
+                                vertexCount: shapeHandle.vertexCount,
+                                indices: shapeIndices,
+                                materials: shapeMaterials,
+                                faceCount: shapeHandle.faceCount,
+                                palette: materialIndicesPtr.baseAddress!,
+                                paletteSize: UInt32(materialIndicesPtr.count),
+                                boundsMin: shapeHandle.boundsMin,
+                                boundsMax: shapeHandle.boundsMax,
+                                optimized: optimizeMeshes)
+                        }
+                    }
+                    if !success {
+                        log.warn("could not write mesh cache for \(shapeHandle.path)")
+                    }
+                }
+                
+                if compactVertexAttributes {
+                    compress_normals(
+                        shapeNormals,
+                        normalBuffer.contents().assumingMemoryBound(to: PackedNormal.self)
+                            .advanced(by: Int(shapeHandle.vertexOffset)),
+                        shapeHandle.vertexCount)
+                    compress_texcoords(
+                        shapeTexCoords,
+                        texCoordBuffer.contents().assumingMemoryBound(to: PackedTexCoord.self)
+                            .advanced(by: Int(shapeHandle.vertexOffset)),
+                        shapeHandle.vertexCount)
+                    
+                    shapeNormals.deallocate()
+                    shapeTexCoords.deallocate()
+                }
+                
+                shapeHandle.contentHash = hash_mesh(
+                    shapeVertices,
+                    normalBuffer.contents().advanced(by: normalStride * Int(shapeHandle.vertexOffset)),
+                    normalStride,
+                    texCoordBuffer.contents().advanced(by: texCoordStride * Int(shapeHandle.vertexOffset)),
+                    texCoordStride,
+                    shapeHandle.vertexCount,
+                    shapeIndices, shapeMaterials, shapeHandle.faceCount)
+                
+                shapeHandle.loadTime = CFAbsoluteTimeGetCurrent() - startTime
+                shapeHandles[index] = shapeHandle
+            }
+        }
+        
+        if let malformed = shapeHandles.first(where: { $0.isMalformed }) {
+            log.error("could not parse shape \(malformed.path)")
+            throw MeshLoaderError.malformedShapeData
+        }
+        
+        let loadTime = CFAbsoluteTimeGetCurrent() - loadStartTime
+        let loadedShapes = shapeHandles.filter { $0.aliasOf == nil }
+        let totalFileSize = loadedShapes.reduce(0) { $0 + $1.fileSize }
+        let totalShapeTime = loadedShapes.reduce(0) { $0 + $1.loadTime }
+        log.info(String(format: "loaded %d shapes, %.1f MB in %.1f ms (%.1f MB/s, %.1fx parallel speedup)",
+            loadedShapes.count,
+            Double(totalFileSize) / 1e+6,
+            loadTime * 1e+3,
+            Double(totalFileSize) / loadTime / 1e+6,
+            totalShapeTime / loadTime))
+        if let slowest = shapeHandles.max(by: { $0.loadTime < $1.loadTime }) {
+            log.debug(String(format: "slowest shape %@ took %.1f ms", slowest.path, slowest.loadTime * 1e+3))
+        }
+        
+        // MARK: share identical shapes
+        
+        func hasSameContent(_ a: ShapeHandle, _ b: ShapeHandle) -> Bool {
+            guard a.vertexCount == b.vertexCount && a.faceCount == b.faceCount else { return false }
+            func equal(_ buffer: MTLBuffer, stride: Int, _ offsetA: UInt32, _ offsetB: UInt32, count: UInt32) -> Bool {
+                memcmp(
+                    buffer.contents().advanced(by: stride * Int(offsetA)),
+                    buffer.contents().advanced(by: stride * Int(offsetB)),
+                    stride * Int(count)) == 0
+            }
+            return equal(vertexBuffer, stride: MemoryLayout<Vertex>.stride, a.vertexOffset, b.vertexOffset, count: a.vertexCount) &&
+                equal(normalBuffer, stride: normalStride, a.vertexOffset, b.vertexOffset, count: a.vertexCount) &&
+                equal(texCoordBuffer, stride: texCoordStride, a.vertexOffset, b.vertexOffset, count: a.vertexCount) &&
+                equal(indexBuffer, stride: MemoryLayout<IndexTriplet>.stride, a.faceOffset, b.faceOffset, count: a.faceCount) &&
+                equal(materialBuffer, stride: MemoryLayout<MaterialIndex>.stride, a.faceOffset, b.faceOffset, count: a.faceCount)
+        }
+        
+        var uniqueShapes: [UInt64: [Int]] = [:]
+        for index in shapeHandles.indices where shapeHandles[index].aliasOf == nil {
+            let shapeHandle = shapeHandles[index]
+            let candidates = uniqueShapes[shapeHandle.contentHash, default: []]
+            if let original = candidates.first(where: { hasSameContent(shapeHandles[$0], shapeHandle) }) {
+                log.debug("\(shapeHandle.path) is identical to \(shapeHandles[original].path)")
+                shapeHandles[index].aliasOf = original
+            } else {
+                uniqueShapes[shapeHandle.contentHash, default: []].append(index)
+            }
+        }
+        
+        // MARK: close gaps left by welding and shared shapes
+        
+        func moveElements(in buffer: MTLBuffer, stride: Int, from source: UInt32, to destination: UInt32, count: UInt32) {
+            memmove(
+                buffer.contents().advanced(by: stride * Int(destination)),
+                buffer.contents().advanced(by: stride * Int(source)),
+                stride * Int(count))
+        }
+        
+        var compactedVertexOffset: VertexIndex = 0
+        var compactedFaceOffset: FaceIndex = 0
+        for index in shapeHandles.indices {
+            let shapeHandle = shapeHandles[index]
+            if let original = shapeHandle.aliasOf {
+                /// originals come first, so their ranges have already been moved
+                shapeHandles[index].vertexOffset = shapeHandles[original].vertexOffset
+                shapeHandles[index].faceOffset = shapeHandles[original].faceOffset
+                shapeHandles[index].vertexCount = shapeHandles[original].vertexCount
+                shapeHandles[index].boundsMin = shapeHandles[original].boundsMin
+                shapeHandles[index].boundsMax = shapeHandles[original].boundsMax
+                continue
+            }
             
-            shapeHandle.materialIndices.withUnsafeBufferPointer { materialIndicesPtr in
-                shapeHandle.fileReader.readFaces(
-                    shapeHandle.faceCount,
-                    vertices: shapeVertices,
-                    indices: indices.advanced(by: Int(shapeHandle.faceOffset)),
-                    materials: materials.advanced(by: Int(shapeHandle.faceOffset)),
-                    fromPalette: materialIndicesPtr.baseAddress!)
+            if shapeHandle.vertexOffset != compactedVertexOffset {
+                let from = shapeHandle.vertexOffset
+                let count = shapeHandle.vertexCount
+                moveElements(in: vertexBuffer, stride: MemoryLayout<Vertex>.stride,
+                    from: from, to: compactedVertexOffset, count: count)
+                moveElements(in: normalBuffer, stride: normalStride,
+                    from: from, to: compactedVertexOffset, count: count)
+                moveElements(in: texCoordBuffer, stride: texCoordStride,
+                    from: from, to: compactedVertexOffset, count: count)
+                shapeHandles[index].vertexOffset = compactedVertexOffset
             }
+            if shapeHandle.faceOffset != compactedFaceOffset {
+                let from = shapeHandle.faceOffset
+                let count = shapeHandle.faceCount
+                moveElements(in: indexBuffer, stride: MemoryLayout<IndexTriplet>.stride,
+                    from: from, to: compactedFaceOffset, count: count)
+                moveElements(in: materialBuffer, stride: MemoryLayout<MaterialIndex>.stride,
+                    from: from, to: compactedFaceOffset, count: count)
+                shapeHandles[index].faceOffset = compactedFaceOffset
+            }
+            compactedVertexOffset += shapeHandle.vertexCount
+            compactedFaceOffset += shapeHandle.faceCount
+        }
+        
+        if compactedVertexOffset < vertexOffset || compactedFaceOffset < faceOffset {
+            let aliasCount = shapeHandles.filter { $0.aliasOf != nil }.count
+            log.info("\(aliasCount) shapes share geometry, \(vertexOffset - compactedVertexOffset) vertices " +
+                "and \(faceOffset - compactedFaceOffset) faces removed")
             
-            shapeHandle.fileReader.close()
+            vertexBuffer = vertexBuffer.trimmed(to: MemoryLayout<Vertex>.stride * Int(compactedVertexOffset))
+            normalBuffer = normalBuffer.trimmed(to: normalStride * Int(compactedVertexOffset))
+            texCoordBuffer = texCoordBuffer.trimmed(to: texCoordStride * Int(compactedVertexOffset))
+            indexBuffer = indexBuffer.trimmed(to: MemoryLayout<IndexTriplet>.stride * Int(compactedFaceOffset))
+            materialBuffer = materialBuffer.trimmed(to: MemoryLayout<MaterialIndex>.stride * Int(compactedFaceOffset))
             
-            shapeHandles[index] = shapeHandle
+            vertices = vertexBuffer.contents().assumingMemoryBound(to: Vertex.self)
+            indices = indexBuffer.contents().assumingMemoryBound(to: IndexTriplet.self)
+            materials = materialBuffer.contents().assumingMemoryBound(to: MaterialIndex.self)
         }
-
+        
         // MARK: build acceleration structure
         
-        let accelerationStructures = shapeHandles.map { shapeHandle in
+        var accelerationStructures: [MTLAccelerationStructure] = []
+        for shapeHandle in shapeHandles {
+            if let original = shapeHandle.aliasOf {
+                accelerationStructures.append(accelerationStructures[original])
+                continue
+            }
+            
             log.debug("accelerating \(shapeHandle.path)")
             
             let mtlGeom = MTLAccelerationStructureTriangleGeometryDescriptor()
@@ -314,8 +656,10 @@ class ShapeBuilder {
             
             let mtlAccel = MTLPrimitiveAccelerationStructureDescriptor()
             mtlAccel.geometryDescriptors = [ mtlGeom ]
+            mtlAccel.usage = accelerationQuality.usage
             
-            return newAccelerationStructureWithDescriptor(mtlAccel, on: device)
+            accelerationStructures.append(newAccelerationStructureWithDescriptor(
+                mtlAccel, on: device, compact: accelerationQuality == .high))
         }
         
         encoder.setBuffer(vertexBuffer, offset: 0, index: ContextBufferIndex.vertices.rawValue)
@@ -334,8 +678,21 @@ class ShapeBuilder {
             indices: indices,
             vertices: vertices,
             materials: materials,
+            normals: normalBuffer.contents(),
+            texCoords: texCoordBuffer.contents(),
             
             accelerationStructures: accelerationStructures
         )
     }
+    
+    /// Adds all shapes to the CPU counterpart of the scene, after `build` has filled the buffers
+    func addShapes(to cpuScene: CpuScene) {
+        for shapeHandle in shapeHandles {
+            cpuScene.addShape(
+                withVertexOffset: shapeHandle.vertexOffset,
+                faceOffset: shapeHandle.faceOffset,
+                faceCount: shapeHandle.faceCount,
+                sourcePath: shapeHandle.path)
+        }
+    }
 }
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace raymond {
+
+/**
+ * Parses a decimal number such as `-12.5`, `.25` or `6.02e23` from the start of `[head, end)` and rounds it
+ * correctly to the nearest float, using the Eisel-Lemire algorithm with a Clinger fast path for short inputs.
+ * Special values (`inf`, `nan`) and the rare inputs that need arbitrary precision are handed to `strtof`.
+ * The input does not need to be null terminated, no whitespace is skipped.
+ * @returns pointer past the last character of the number, or `nullptr` if no number could be parsed
+ */
+const char *parseFloat(const char *head, const char *end, float &value);
+
+}
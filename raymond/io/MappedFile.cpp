@@ -0,0 +1,67 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <utility>
+
+namespace raymond {
+
+MappedFile::MappedFile(MappedFile &&other)
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+    if (this != &other) {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &path) {
+    close();
+    
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    
+    void *mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (mapping == MAP_FAILED) return false;
+    
+    m_data = (const char *)mapping;
+    m_size = size_t(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_data) munmap((void *)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+void MappedFile::adviseSequential(size_t offset, size_t length) const {
+    if (!m_data || offset >= m_size) return;
+    
+    /// madvise requires page aligned addresses
+    const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+    const size_t begin = offset - offset % pageSize;
+    const size_t end = std::min(offset + length, m_size);
+    madvise((void *)(m_data + begin), end - begin, MADV_SEQUENTIAL);
+    madvise((void *)(m_data + begin), end - begin, MADV_WILLNEED);
+}
+
+}
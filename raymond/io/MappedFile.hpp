@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace raymond {
+
+/// Read-only memory mapping of an entire file, unmapped when the object goes out of scope.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other);
+    MappedFile &operator=(MappedFile &&other);
+    ~MappedFile();
+    
+    /// Maps the file at the given path, returns false if the file cannot be opened or mapped.
+    bool open(const std::string &path);
+    void close();
+    
+    /// Hints the kernel that the given byte range will be read front to back soon.
+    void adviseSequential(size_t offset, size_t length) const;
+    
+    bool isOpen() const { return m_data != nullptr; }
+    const char *data() const { return m_data; }
+    const char *end() const { return m_data + m_size; }
+    size_t size() const { return m_size; }
+
+private:
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+}
@@ -0,0 +1,59 @@
+#import <Foundation/Foundation.h>
+#import <simd/simd.h>
+#include "../bridge/common.hpp"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Reads and writes `.rmesh` files, which hold meshes in the exact layout of our buffers next to their source files
+@interface MeshCache : NSObject
+
+- (instancetype)initWithSourceURL:(NSURL *)url;
+
+/**
+ * Maps the cache file if it exists and matches the current contents of the source file.
+ * @returns NO if the source needs to be parsed
+ */
+- (BOOL)open;
+
+@property (readonly) unsigned int vertexCount;
+@property (readonly) unsigned int faceCount;
+/// Whether the cached mesh has been welded and reordered by `optimize_mesh`
+@property (readonly) BOOL isOptimized;
+
+- (void)close;
+- (void)reopen;
+
+/// Size of the cache file in bytes, only valid while the file is open
+@property (readonly) long fileSize;
+
+- (void)readVertexElements:(unsigned int)number
+    vertices:(Vertex * _Nonnull)vertices
+    normals:(Normal * _Nonnull)normals
+    texCoords:(TexCoord * _Nonnull)texCoords
+    boundsMin:(simd_float3 *)boundsMin
+    boundsMax:(simd_float3 *)boundsMax;
+
+/// Copies the material indices, remapping them if the materials of the scene have been assigned different indices
+- (void)readFaces:(unsigned int)number
+    indices:(IndexTriplet * _Nonnull)indices
+    materials:(MaterialIndex * _Nonnull)materials
+    fromPalette:(const MaterialIndex * _Nonnull)palette
+    paletteSize:(unsigned int)paletteSize;
+
+/// @returns NO if the cache could not be written, which is not fatal since we can always parse the source again
+- (BOOL)writeVertices:(const Vertex * _Nonnull)vertices
+    normals:(const Normal * _Nonnull)normals
+    texCoords:(const TexCoord * _Nonnull)texCoords
+    vertexCount:(unsigned int)vertexCount
+    indices:(const IndexTriplet * _Nonnull)indices
+    materials:(const MaterialIndex * _Nonnull)materials
+    faceCount:(unsigned int)faceCount
+    palette:(const MaterialIndex * _Nonnull)palette
+    paletteSize:(unsigned int)paletteSize
+    boundsMin:(simd_float3)boundsMin
+    boundsMax:(simd_float3)boundsMax
+    optimized:(BOOL)optimized;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,142 @@
+#import "MeshCache.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "MappedFile.hpp"
+#include "rmesh/RMesh.hpp"
+
+@implementation MeshCache {
+    std::string sourcePath;
+    std::string cachePath;
+    
+    raymond::MappedFile mapping;
+    raymond::rmesh::MeshView view;
+}
+
+- (instancetype)initWithSourceURL:(NSURL *)url {
+    self = [super init];
+    if (!self) return self;
+    
+    sourcePath = [url.relativePath cStringUsingEncoding:NSUTF8StringEncoding];
+    cachePath = raymond::rmesh::cachePath(sourcePath);
+    return self;
+}
+
+- (BOOL)open {
+    if (!raymond::rmesh::open(cachePath, sourcePath, mapping, view)) return NO;
+    if (view.vertexCount > UINT32_MAX || view.faceCount > UINT32_MAX) {
+        mapping.close();
+        return NO;
+    }
+    return YES;
+}
+
+- (unsigned int)vertexCount {
+    return (unsigned int)view.vertexCount;
+}
+
+- (unsigned int)faceCount {
+    return (unsigned int)view.faceCount;
+}
+
+- (BOOL)isOptimized {
+    return view.isOptimized;
+}
+
+- (void)close {
+    mapping.close();
+}
+
+- (void)reopen {
+    /// the cache has already been validated by `open`, so we only need to map it again
+    const raymond::rmesh::MeshView validated = view;
+    if (!raymond::rmesh::map(cachePath, mapping, view) ||
+        view.vertexCount != validated.vertexCount ||
+        view.faceCount != validated.faceCount
+    ) {
+        printf("cache '%s' changed while loading the scene\n", cachePath.c_str());
+        assert(false);
+    }
+    mapping.adviseSequential(0, mapping.size());
+}
+
+- (long)fileSize {
+    return long(mapping.size());
+}
+
+- (void)readVertexElements:(unsigned int)number
+    vertices:(Vertex * _Nonnull)vertices
+    normals:(Normal * _Nonnull)normals
+    texCoords:(TexCoord * _Nonnull)texCoords
+    boundsMin:(simd_float3 *)boundsMin
+    boundsMax:(simd_float3 *)boundsMax
+{
+    assert(number == view.vertexCount);
+    memcpy(vertices, view.vertices, number * sizeof(Vertex));
+    memcpy(normals, view.normals, number * sizeof(Normal));
+    memcpy(texCoords, view.texCoords, number * sizeof(TexCoord));
+    
+    *boundsMin = simd_make_float3(view.boundsMin[0], view.boundsMin[1], view.boundsMin[2]);
+    *boundsMax = simd_make_float3(view.boundsMax[0], view.boundsMax[1], view.boundsMax[2]);
+}
+
+- (void)readFaces:(unsigned int)number
+    indices:(IndexTriplet * _Nonnull)indices
+    materials:(MaterialIndex * _Nonnull)materials
+    fromPalette:(const MaterialIndex *)palette
+    paletteSize:(unsigned int)paletteSize
+{
+    assert(number == view.faceCount);
+    memcpy(indices, view.indices, number * sizeof(IndexTriplet));
+    
+    const bool isSamePalette = paletteSize == view.paletteSize &&
+        memcmp(palette, view.palette, paletteSize * sizeof(MaterialIndex)) == 0;
+    if (isSamePalette) {
+        memcpy(materials, view.materials, number * sizeof(MaterialIndex));
+        return;
+    }
+    
+    /// Material slots of a shape are resolved by name, so equal indices in the old palette belong to the same
+    /// material and can be mapped through the first slot that used them.
+    for (unsigned int i = 0; i < number; i++) {
+        const MaterialIndex cached = view.materials[i];
+        size_t slot = 0;
+        while (slot < view.paletteSize && view.palette[slot] != cached) slot++;
+        assert(slot < paletteSize && "shape has fewer materials than when it was cached");
+        materials[i] = palette[slot];
+    }
+}
+
+- (BOOL)writeVertices:(const Vertex * _Nonnull)vertices
+    normals:(const Normal * _Nonnull)normals
+    texCoords:(const TexCoord * _Nonnull)texCoords
+    vertexCount:(unsigned int)vertexCount
+    indices:(const IndexTriplet * _Nonnull)indices
+    materials:(const MaterialIndex * _Nonnull)materials
+    faceCount:(unsigned int)faceCount
+    palette:(const MaterialIndex * _Nonnull)palette
+    paletteSize:(unsigned int)paletteSize
+    boundsMin:(simd_float3)boundsMin
+    boundsMax:(simd_float3)boundsMax
+    optimized:(BOOL)optimized
+{
+    raymond::rmesh::MeshView mesh;
+    mesh.vertices = vertices;
+    mesh.normals = normals;
+    mesh.texCoords = texCoords;
+    mesh.vertexCount = vertexCount;
+    mesh.indices = indices;
+    mesh.materials = materials;
+    mesh.faceCount = faceCount;
+    mesh.palette = palette;
+    mesh.paletteSize = paletteSize;
+    for (int dim = 0; dim < 3; dim++) {
+        mesh.boundsMin[dim] = boundsMin[dim];
+        mesh.boundsMax[dim] = boundsMax[dim];
+    }
+    mesh.isOptimized = optimized;
+    
+    return raymond::rmesh::write(cachePath, sourcePath, mesh);
+}
+
+@end
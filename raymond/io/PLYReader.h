@@ -7,26 +7,45 @@ NS_ASSUME_NONNULL_BEGIN
 @interface PLYReader : NSObject
 
 - (instancetype)initWithURL:(NSURL *)url;
-- (void)assertLine:(NSString *)string;
-- (void)assertToken:(NSString *)string;
-- (void)readLine;
-- (int)readInt;
+
+/**
+ * Parses the header and works out how vertex and face properties map to our buffers.
+ * Properties may come in any order and with any type, unknown properties and elements are skipped.
+ * @returns NO if the file cannot be read or does not describe a triangle mesh
+ */
+- (BOOL)readHeader;
+
+/// Number of vertices declared in the header
+@property (readonly) unsigned int vertexCount;
+/// Number of faces declared in the header
+@property (readonly) unsigned int faceCount;
 
 - (void)close;
-- (void)reopen;
+/// @returns NO if the file can no longer be mapped
+- (BOOL)reopen;
 
-- (void)readVertexElements:(unsigned int)number
+/// Size of the file in bytes, only valid while the file is open for reading elements
+@property (readonly) long fileSize;
+
+/// @returns NO if the vertex data is truncated or malformed
+- (BOOL)readVertexElements:(unsigned int)number
     vertices:(Vertex * _Nonnull)vertices
     normals:(Normal * _Nonnull)normals
     texCoords:(TexCoord * _Nonnull)texCoords
     boundsMin:(simd_float3 *)boundsMin
     boundsMax:(simd_float3 *)boundsMax;
 
-- (void)readFaces:(unsigned int)number
+/**
+ * Reads the faces and, if the file does not provide normals, computes smooth normals from them
+ * @returns NO if the face data is truncated, malformed or has faces that are not triangles
+ */
+- (BOOL)readFaces:(unsigned int)number
     vertices:(Vertex * _Nonnull)vertices
+    normals:(Normal * _Nonnull)normals
     indices:(IndexTriplet * _Nonnull)indices
     materials:(MaterialIndex * _Nonnull)materials
-    fromPalette:(const MaterialIndex * _Nonnull)palette;
+    fromPalette:(const MaterialIndex * _Nonnull)palette
+    paletteSize:(unsigned int)paletteSize;
 
 @end
 
@@ -0,0 +1,193 @@
+#import "PLYReader.h"
+#include <stdio.h>
+
+#include "MappedFile.hpp"
+#include "ply/PlyAscii.hpp"
+#include "ply/PlyBinary.hpp"
+#include "ply/PlyHeader.hpp"
+#include "../utils/ThreadPool.hpp"
+
+@implementation PLYReader {
+    NSString *path;
+    long offset;
+    
+    raymond::MappedFile mapping;
+    raymond::ply::Header header;
+    raymond::ply::VertexLayout vertexLayout;
+    raymond::ply::FaceLayout faceLayout;
+    
+    int vertexElement;
+    int faceElement;
+    /// index of the element that starts at `offset`
+    int nextElement;
+}
+
+- (instancetype)initWithURL:(NSURL *)url {
+    self = [super init];
+    if (!self) return self;
+    
+    path = url.relativePath;
+    return self;
+}
+
+- (BOOL)readHeader {
+    const char *cpath = [path cStringUsingEncoding:NSASCIIStringEncoding];
+    if (!mapping.open(cpath)) {
+        printf("could not open '%s'\n", cpath);
+        return NO;
+    }
+    
+    if (!raymond::ply::parseHeader(mapping.data(), mapping.end(), header)) {
+        printf("malformed PLY header in '%s'\n", cpath);
+        return NO;
+    }
+    
+    if (header.format == raymond::ply::Format::BinaryBigEndian) {
+        printf("unsupported PLY format 'binary_big_endian' in '%s'\n", cpath);
+        return NO;
+    }
+    
+    vertexElement = header.find("vertex");
+    faceElement = header.find("face");
+    if (vertexElement < 0 || faceElement < vertexElement) {
+        /// elements are decoded in a single pass over the file, so vertices need to come first
+        printf("PLY file '%s' needs a vertex element followed by a face element\n", cpath);
+        return NO;
+    }
+    
+    const auto &vertices = header.elements[vertexElement];
+    const auto &faces = header.elements[faceElement];
+    if (vertices.count > UINT32_MAX || faces.count > UINT32_MAX) {
+        printf("too many elements in '%s'\n", cpath);
+        return NO;
+    }
+    
+    if (!raymond::ply::resolveVertexLayout(vertices, vertexLayout)) {
+        printf("vertex element in '%s' has no positions\n", cpath);
+        return NO;
+    }
+    
+    if (!raymond::ply::resolveFaceLayout(faces, faceLayout)) {
+        printf("face element in '%s' has no vertex indices\n", cpath);
+        return NO;
+    }
+    
+    offset = long(header.dataOffset);
+    nextElement = 0;
+    return YES;
+}
+
+- (unsigned int)vertexCount {
+    return (unsigned int)header.elements[vertexElement].count;
+}
+
+- (unsigned int)faceCount {
+    return (unsigned int)header.elements[faceElement].count;
+}
+
+- (void)close {
+    mapping.close();
+}
+
+- (BOOL)reopen {
+    /// element data is read straight from a memory mapping of the file
+    const char *cpath = [path cStringUsingEncoding:NSASCIIStringEncoding];
+    if (!mapping.open(cpath)) {
+        printf("could not map '%s'\n", cpath);
+        return NO;
+    }
+    mapping.adviseSequential(offset, mapping.size() - offset);
+    return YES;
+}
+
+- (long)fileSize {
+    return long(mapping.size());
+}
+
+/**
+ * Advances `offset` to the start of the given element, skipping over all elements in between
+ * @returns NO if an element in between is truncated
+ */
+- (BOOL)skipToElement:(int)element {
+    for (; nextElement < element; nextElement++) {
+        const char *data = mapping.data() + offset;
+        const char *end = header.format == raymond::ply::Format::Ascii ?
+            raymond::ply::skipAsciiElement(data, mapping.end(), header.elements[nextElement]) :
+            raymond::ply::skipBinaryElement(data, mapping.end(), header.elements[nextElement]);
+        if (end == nullptr) {
+            printf("truncated element data in '%s'\n", [path cStringUsingEncoding:NSASCIIStringEncoding]);
+            return NO;
+        }
+        offset = end - mapping.data();
+    }
+    return YES;
+}
+
+- (BOOL)readVertexElements:(unsigned int)number
+    vertices:(Vertex * _Nonnull)vertices
+    normals:(Normal * _Nonnull)normals
+    texCoords:(TexCoord * _Nonnull)texCoords
+    boundsMin:(simd_float3 *)boundsMin
+    boundsMax:(simd_float3 *)boundsMax
+{
+    if (![self skipToElement:vertexElement]) return NO;
+    
+    const auto &element = header.elements[vertexElement];
+    assert(number == element.count);
+    
+    raymond::ply::VertexOutput output { vertices, normals, texCoords };
+    for (int dim = 0; dim < 3; dim++) {
+        output.bounds.min[dim] = (*boundsMin)[dim];
+        output.bounds.max[dim] = (*boundsMax)[dim];
+    }
+    
+    const char *data = mapping.data() + offset;
+    const char *end = header.format == raymond::ply::Format::Ascii ?
+        raymond::ply::readAsciiVertices(data, mapping.end(), element, vertexLayout, output, raymond::ThreadPool::shared()) :
+        raymond::ply::readBinaryVertices(data, mapping.end(), element, vertexLayout, output);
+    if (end == nullptr) {
+        printf("malformed vertex data in '%s'\n", [path cStringUsingEncoding:NSASCIIStringEncoding]);
+        return NO;
+    }
+    offset = end - mapping.data();
+    nextElement = vertexElement + 1;
+    
+    *boundsMin = simd_make_float3(output.bounds.min[0], output.bounds.min[1], output.bounds.min[2]);
+    *boundsMax = simd_make_float3(output.bounds.max[0], output.bounds.max[1], output.bounds.max[2]);
+    return YES;
+}
+
+- (BOOL)readFaces:(unsigned int)number
+    vertices:(Vertex * _Nonnull)vertices
+    normals:(Normal * _Nonnull)normals
+    indices:(IndexTriplet * _Nonnull)indices
+    materials:(uint16_t * _Nonnull)materials
+    fromPalette:(const uint16_t *)palette
+    paletteSize:(unsigned int)paletteSize
+{
+    if (![self skipToElement:faceElement]) return NO;
+    
+    const auto &element = header.elements[faceElement];
+    assert(number == element.count);
+    
+    raymond::ply::FaceOutput output { indices, materials, palette, paletteSize, self.vertexCount };
+    
+    const char *data = mapping.data() + offset;
+    const char *end = header.format == raymond::ply::Format::Ascii ?
+        raymond::ply::readAsciiFaces(data, mapping.end(), element, faceLayout, output, raymond::ThreadPool::shared()) :
+        raymond::ply::readBinaryFaces(data, mapping.end(), element, faceLayout, output);
+    if (end == nullptr) {
+        printf("malformed face data in '%s' (only triangles are supported)\n",
+            [path cStringUsingEncoding:NSASCIIStringEncoding]);
+        return NO;
+    }
+    offset = end - mapping.data();
+    nextElement = faceElement + 1;
+    
+    if (!vertexLayout.hasNormals) {
+        raymond::ply::computeVertexNormals(vertices, normals, self.vertexCount, indices, number);
+    }
+    return YES;
+}
+
+@end
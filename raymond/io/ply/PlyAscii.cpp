@@ -0,0 +1,328 @@
+#include "PlyAscii.hpp"
+
+#include <io/FloatParser.hpp>
+#include <utils/ThreadPool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace raymond::ply {
+
+namespace {
+
+/// Large enough to amortize scheduling, small enough to balance the load across threads
+constexpr size_t ChunkSize = 1 << 20;
+
+struct Chunk {
+    const char *begin;
+    const char *end;
+    size_t firstLine;
+};
+
+size_t countLines(const char *begin, const char *end) {
+    size_t lines = std::count(begin, end, '\n');
+    if (begin < end && end[-1] != '\n') lines++; // last line of the file without trailing newline
+    return lines;
+}
+
+/// Returns a pointer past the `n`-th newline in `[begin, end)`, or `end` if there are fewer lines
+const char *skipLines(const char *begin, const char *end, size_t n) {
+    while (n-- > 0 && begin < end) {
+        const char *newline = (const char *)std::memchr(begin, '\n', end - begin);
+        begin = newline ? newline + 1 : end;
+    }
+    return begin;
+}
+
+/**
+ * Splits the data into newline aligned chunks that together contain exactly `count` lines.
+ * Lines are counted in waves of chunks, so that we do not scan beyond the section we were asked for.
+ * @returns false if the data contains fewer than `count` lines
+ */
+bool makeChunks(const char *data, const char *end, size_t count, ThreadPool &pool, std::vector<Chunk> &chunks) {
+    const size_t waveSize = 4 * pool.concurrency();
+    
+    size_t lines = 0;
+    const char *head = data;
+    while (lines < count) {
+        if (head >= end) return false;
+        
+        const size_t waveBegin = chunks.size();
+        for (size_t i = 0; i < waveSize && head < end; i++) {
+            const char *chunkEnd = head + std::min(ChunkSize, size_t(end - head));
+            chunkEnd = skipLines(chunkEnd, end, chunkEnd < end && chunkEnd[-1] != '\n' ? 1 : 0);
+            chunks.push_back({ head, chunkEnd, 0 });
+            head = chunkEnd;
+        }
+        
+        std::vector<size_t> lineCounts(chunks.size() - waveBegin);
+        pool.parallelFor(lineCounts.size(), [&](size_t i) {
+            const Chunk &chunk = chunks[waveBegin + i];
+            lineCounts[i] = countLines(chunk.begin, chunk.end);
+        });
+        
+        for (size_t i = 0; i < lineCounts.size(); i++) {
+            Chunk &chunk = chunks[waveBegin + i];
+            chunk.firstLine = lines;
+            
+            if (lines + lineCounts[i] >= count) {
+                /// the section ends within this chunk
+                chunk.end = skipLines(chunk.begin, chunk.end, count - lines);
+                chunks.resize(waveBegin + i + 1);
+                return true;
+            }
+            
+            lines += lineCounts[i];
+        }
+    }
+    
+    return true;
+}
+
+inline const char *skipSpaces(const char *head, const char *end) {
+    while (head < end && *head == ' ') head++;
+    return head;
+}
+
+inline bool isSeparator(char chr) {
+    return chr == ' ' || chr == '\n' || chr == '\r';
+}
+
+bool parseFloat(const char *&head, const char *end, float &value) {
+    head = raymond::parseFloat(skipSpaces(head, end), end, value);
+    return head && (head == end || isSeparator(*head));
+}
+
+bool parseUInt(const char *&head, const char *end, uint32_t &value) {
+    head = skipSpaces(head, end);
+    
+    const char *begin = head;
+    uint64_t result = 0;
+    for (; head < end && *head >= '0' && *head <= '9'; head++) {
+        result = 10 * result + (*head - '0');
+        if (result > UINT32_MAX) return false;
+    }
+    
+    value = uint32_t(result);
+    return head > begin && (head == end || isSeparator(*head));
+}
+
+/// Checks that nothing but whitespace remains on the line and advances to the start of the next line
+bool finishLine(const char *&head, const char *end) {
+    while (head < end && (*head == ' ' || *head == '\r')) head++;
+    if (head == end) return true;
+    if (*head != '\n') return false;
+    head++;
+    return true;
+}
+
+/// Skips over a single value of a property we are not interested in
+bool skipToken(const char *&head, const char *end) {
+    head = skipSpaces(head, end);
+    const char *begin = head;
+    while (head < end && !isSeparator(*head)) head++;
+    return head > begin;
+}
+
+bool skipList(const char *&head, const char *end) {
+    uint32_t length;
+    if (!parseUInt(head, end, length)) return false;
+    while (length-- > 0) {
+        if (!skipToken(head, end)) return false;
+    }
+    return true;
+}
+
+/// Parses a vertex index list, which must contain exactly three valid indices
+bool parseTriangle(const char *&head, const char *end, IndexTriplet &indices, size_t vertexCount) {
+    uint32_t length;
+    if (!parseUInt(head, end, length) || length != 3) return false;
+    for (int i = 0; i < 3; i++) {
+        if (!parseUInt(head, end, indices.elements[i]) || indices.elements[i] >= vertexCount) return false;
+    }
+    return true;
+}
+
+inline bool assignMaterial(FaceOutput &output, size_t index, uint32_t paletteId) {
+    if (paletteId >= output.paletteSize) return false;
+    output.materials[index] = output.palette[paletteId];
+    return true;
+}
+
+/// Upper limit on the number of vertex properties, so that a line can be parsed into an array on the stack
+constexpr size_t MaxColumns = 64;
+
+/// Parses `x y z nx ny nz s t` without looking at the schema
+struct CanonicalVertexParser {
+    VertexOutput &output;
+    
+    bool operator()(const char *&head, const char *lineEnd, size_t index) const {
+        Vertex &vertex = output.vertices[index];
+        Normal &normal = output.normals[index];
+        TexCoord &texCoord = output.texCoords[index];
+        
+        float uv[2];
+        const bool success =
+            parseFloat(head, lineEnd, vertex.x) &&
+            parseFloat(head, lineEnd, vertex.y) &&
+            parseFloat(head, lineEnd, vertex.z) &&
+            parseFloat(head, lineEnd, normal.x) &&
+            parseFloat(head, lineEnd, normal.y) &&
+            parseFloat(head, lineEnd, normal.z) &&
+            parseFloat(head, lineEnd, uv[0]) &&
+            parseFloat(head, lineEnd, uv[1]);
+        texCoord.x = uv[0];
+        texCoord.y = uv[1];
+        return success;
+    }
+};
+
+/// Parses all columns of a line and picks the attributes we need according to the layout
+template<bool HasNormals, bool HasTexCoords>
+struct VertexParser {
+    const Element &element;
+    const VertexLayout &layout;
+    VertexOutput &output;
+    
+    bool operator()(const char *&head, const char *lineEnd, size_t index) const {
+        float columns[MaxColumns];
+        for (size_t property = 0; property < element.properties.size(); property++) {
+            const bool success = element.properties[property].isList ?
+                skipList(head, lineEnd) :
+                parseFloat(head, lineEnd, columns[property]);
+            if (!success) return false;
+        }
+        
+        Vertex &vertex = output.vertices[index];
+        Normal &normal = output.normals[index];
+        for (int dim = 0; dim < 3; dim++) {
+            vertex.elements[dim] = columns[layout.position[dim].property];
+            normal.elements[dim] = HasNormals ? columns[layout.normal[dim].property] : 0;
+        }
+        
+        TexCoord &texCoord = output.texCoords[index];
+        texCoord.x = HasTexCoords ? columns[layout.texCoord[0].property] : 0;
+        texCoord.y = HasTexCoords ? columns[layout.texCoord[1].property] : 0;
+        return true;
+    }
+};
+
+/**
+ * Runs `parseLine(head, end, lineIndex, chunkIndex)` for `count` lines in parallel.
+ * @returns pointer past the last line, or `nullptr` if the data is truncated or any line fails to parse
+ */
+template<typename ParseLine>
+const char *parseLines(
+    const char *data, const char *end, size_t count, ThreadPool &pool,
+    std::vector<Chunk> &chunks, ParseLine parseLine
+) {
+    if (count == 0) return data;
+    if (!makeChunks(data, end, count, pool, chunks)) return nullptr;
+    
+    std::atomic<bool> failed { false };
+    pool.parallelFor(chunks.size(), [&](size_t chunkIndex) {
+        const Chunk &chunk = chunks[chunkIndex];
+        const char *head = chunk.begin;
+        for (size_t line = chunk.firstLine; head < chunk.end; line++) {
+            if (!parseLine(head, chunk.end, line, chunkIndex) || !finishLine(head, chunk.end)) {
+                failed.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    });
+    
+    return failed ? nullptr : chunks.back().end;
+}
+
+}
+
+const char *readAsciiVertices(
+    const char *data, const char *end,
+    const Element &element, const VertexLayout &layout, VertexOutput &output, ThreadPool &pool
+) {
+    if (element.properties.size() > MaxColumns) return nullptr;
+    
+    std::vector<Chunk> chunks;
+    std::vector<Bounds> chunkBounds;
+    
+    /// every chunk tracks its own bounds, which are merged at the end
+    chunkBounds.resize((end - data) / ChunkSize + 1);
+    auto parse = [&](auto parseVertex) {
+        return parseLines(data, end, element.count, pool, chunks,
+            [&](const char *&head, const char *lineEnd, size_t index, size_t chunkIndex) {
+                const bool success = parseVertex(head, lineEnd, index);
+                chunkBounds[chunkIndex].extend(output.vertices[index]);
+                return success;
+            });
+    };
+    
+    const char *result;
+    if (layout.isCanonical) {
+        result = parse(CanonicalVertexParser { output });
+    } else if (layout.hasNormals && layout.hasTexCoords) {
+        result = parse(VertexParser<true, true> { element, layout, output });
+    } else if (layout.hasNormals) {
+        result = parse(VertexParser<true, false> { element, layout, output });
+    } else if (layout.hasTexCoords) {
+        result = parse(VertexParser<false, true> { element, layout, output });
+    } else {
+        result = parse(VertexParser<false, false> { element, layout, output });
+    }
+    
+    for (size_t i = 0; i < chunks.size(); i++) {
+        output.bounds.extend(chunkBounds[i]);
+    }
+    
+    return result;
+}
+
+const char *readAsciiFaces(
+    const char *data, const char *end,
+    const Element &element, const FaceLayout &layout, FaceOutput &output, ThreadPool &pool
+) {
+    const bool isCanonical = layout.hasMaterial &&
+        element.properties.size() == 2 && layout.indices.property == 0 && layout.material.property == 1;
+    
+    std::vector<Chunk> chunks;
+    if (isCanonical) {
+        return parseLines(data, end, element.count, pool, chunks,
+            [&](const char *&head, const char *lineEnd, size_t index, size_t) {
+                uint32_t paletteId;
+                return
+                    parseTriangle(head, lineEnd, output.indices[index], output.vertexCount) &&
+                    parseUInt(head, lineEnd, paletteId) &&
+                    assignMaterial(output, index, paletteId);
+            });
+    }
+    
+    return parseLines(data, end, element.count, pool, chunks,
+        [&](const char *&head, const char *lineEnd, size_t index, size_t) {
+            uint32_t paletteId = 0;
+            for (int property = 0; property < int(element.properties.size()); property++) {
+                bool success;
+                if (property == layout.indices.property) {
+                    success = parseTriangle(head, lineEnd, output.indices[index], output.vertexCount);
+                } else if (property == layout.material.property) {
+                    success = parseUInt(head, lineEnd, paletteId);
+                } else if (element.properties[property].isList) {
+                    success = skipList(head, lineEnd);
+                } else {
+                    success = skipToken(head, lineEnd);
+                }
+                if (!success) return false;
+            }
+            return assignMaterial(output, index, paletteId);
+        });
+}
+
+const char *skipAsciiElement(const char *data, const char *end, const Element &element) {
+    for (size_t i = 0; i < element.count; i++) {
+        if (data >= end) return nullptr;
+        data = skipLines(data, end, 1);
+    }
+    return data;
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PlyData.hpp"
+#include "PlyHeader.hpp"
+
+namespace raymond {
+class ThreadPool;
+}
+
+namespace raymond::ply {
+
+/**
+ * Parses the vertex lines of an `ascii 1.0` file, picking attributes from the columns given by the layout.
+ * The data is split into newline aligned chunks that are parsed in parallel directly into the output arrays,
+ * the bounds of all chunks are merged into `output.bounds`.
+ * @returns pointer past the last line that was read, or `nullptr` if the data is malformed
+ */
+const char *readAsciiVertices(
+    const char *data, const char *end,
+    const Element &element, const VertexLayout &layout, VertexOutput &output, ThreadPool &pool);
+
+/**
+ * Parses the face lines of an `ascii 1.0` file in parallel, all faces need to be triangles.
+ * @returns pointer past the last line that was read, or `nullptr` if the data is malformed
+ */
+const char *readAsciiFaces(
+    const char *data, const char *end,
+    const Element &element, const FaceLayout &layout, FaceOutput &output, ThreadPool &pool);
+
+/**
+ * Skips over all lines of an element we are not interested in.
+ * @returns pointer past the last line, or `nullptr` if the data is truncated
+ */
+const char *skipAsciiElement(const char *data, const char *end, const Element &element);
+
+}
@@ -0,0 +1,271 @@
+#include "PlyBinary.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "binary PLY decoding assumes a little endian host"
+#endif
+
+namespace raymond::ply {
+
+namespace {
+
+template<typename T>
+inline T load(const char *data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+double loadScalar(const char *data, ScalarType type) {
+    switch (type) {
+    case ScalarType::Int8: return load<int8_t>(data);
+    case ScalarType::UInt8: return load<uint8_t>(data);
+    case ScalarType::Int16: return load<int16_t>(data);
+    case ScalarType::UInt16: return load<uint16_t>(data);
+    case ScalarType::Int32: return load<int32_t>(data);
+    case ScalarType::UInt32: return load<uint32_t>(data);
+    case ScalarType::Float32: return load<float>(data);
+    case ScalarType::Float64: return load<double>(data);
+    }
+    return 0;
+}
+
+/// Only valid for the integer types, which is checked when the layout is resolved
+int64_t loadInteger(const char *data, ScalarType type) {
+    switch (type) {
+    case ScalarType::Int8: return load<int8_t>(data);
+    case ScalarType::UInt8: return load<uint8_t>(data);
+    case ScalarType::Int16: return load<int16_t>(data);
+    case ScalarType::UInt16: return load<uint16_t>(data);
+    case ScalarType::Int32: return load<int32_t>(data);
+    case ScalarType::UInt32: return load<uint32_t>(data);
+    default: return -1;
+    }
+}
+
+/**
+ * Locates all properties of the record at `data`, which is required for elements that contain lists.
+ * @returns pointer past the record, or `nullptr` if the data is truncated
+ */
+const char *locateProperties(const char *data, const char *end, const Element &element, const char **properties) {
+    for (size_t i = 0; i < element.properties.size(); i++) {
+        const Property &property = element.properties[i];
+        properties[i] = data;
+        
+        size_t size = sizeOf(property.type);
+        if (property.isList) {
+            if (size_t(end - data) < sizeOf(property.countType)) return nullptr;
+            const int64_t length = loadInteger(data, property.countType);
+            if (length < 0) return nullptr;
+            size = sizeOf(property.countType) + size_t(length) * size;
+        }
+        
+        if (size_t(end - data) < size) return nullptr;
+        data += size;
+    }
+    return data;
+}
+
+const char *readCanonicalVertices(const char *data, size_t count, VertexOutput &output) {
+    constexpr size_t RecordSize = 8 * sizeof(float);
+    
+    /// The file interleaves all attributes while our buffers are separate, so aliasing the mapping is not
+    /// possible. A single streaming pass that splits each record is as close to a plain copy as it gets.
+    Bounds bounds = output.bounds;
+    for (size_t i = 0; i < count; i++, data += RecordSize) {
+        float record[8];
+        std::memcpy(record, data, RecordSize);
+        
+        Vertex &vertex = output.vertices[i];
+        vertex.x = record[0];
+        vertex.y = record[1];
+        vertex.z = record[2];
+        bounds.extend(vertex);
+        
+        Normal &normal = output.normals[i];
+        normal.x = record[3];
+        normal.y = record[4];
+        normal.z = record[5];
+        
+        output.texCoords[i].x = record[6];
+        output.texCoords[i].y = record[7];
+    }
+    
+    output.bounds = bounds;
+    return data;
+}
+
+/// Decodes records with `float` attributes at fixed offsets, skipping over any other properties
+template<bool HasNormals, bool HasTexCoords>
+const char *readFloatVertices(const char *data, size_t count, size_t stride, const VertexLayout &layout, VertexOutput &output) {
+    Bounds bounds = output.bounds;
+    for (size_t i = 0; i < count; i++, data += stride) {
+        Vertex &vertex = output.vertices[i];
+        for (int dim = 0; dim < 3; dim++) {
+            vertex.elements[dim] = load<float>(data + layout.position[dim].offset);
+        }
+        bounds.extend(vertex);
+        
+        Normal &normal = output.normals[i];
+        for (int dim = 0; dim < 3; dim++) {
+            normal.elements[dim] = HasNormals ? load<float>(data + layout.normal[dim].offset) : 0;
+        }
+        
+        TexCoord &texCoord = output.texCoords[i];
+        texCoord.x = HasTexCoords ? load<float>(data + layout.texCoord[0].offset) : 0;
+        texCoord.y = HasTexCoords ? load<float>(data + layout.texCoord[1].offset) : 0;
+    }
+    
+    output.bounds = bounds;
+    return data;
+}
+
+const char *readGenericVertices(const char *data, const char *end, const Element &element, const VertexLayout &layout, VertexOutput &output) {
+    std::vector<const char *> properties(element.properties.size());
+    auto get = [&](const Attribute &attribute) {
+        return float(loadScalar(properties[attribute.property], attribute.type));
+    };
+    
+    for (size_t i = 0; i < element.count; i++) {
+        if (!(data = locateProperties(data, end, element, properties.data()))) return nullptr;
+        
+        Vertex &vertex = output.vertices[i];
+        Normal &normal = output.normals[i];
+        for (int dim = 0; dim < 3; dim++) {
+            vertex.elements[dim] = get(layout.position[dim]);
+            normal.elements[dim] = layout.hasNormals ? get(layout.normal[dim]) : 0;
+        }
+        output.bounds.extend(vertex);
+        
+        TexCoord &texCoord = output.texCoords[i];
+        texCoord.x = layout.hasTexCoords ? get(layout.texCoord[0]) : 0;
+        texCoord.y = layout.hasTexCoords ? get(layout.texCoord[1]) : 0;
+    }
+    
+    return data;
+}
+
+template<typename Index>
+inline bool isValidIndex(Index index, size_t vertexCount) {
+    if constexpr (std::is_signed_v<Index>) {
+        if (index < 0) return false;
+    }
+    return size_t(index) < vertexCount;
+}
+
+/// Decodes triangle records of fixed size with indices of type `Index` and an optional `uchar` material index
+template<typename Count, typename Index, bool HasMaterial>
+const char *readTriangleFaces(const char *data, size_t count, size_t stride, const FaceLayout &layout, FaceOutput &output) {
+    for (size_t i = 0; i < count; i++, data += stride) {
+        if (load<Count>(data + layout.count.offset) != 3) return nullptr;
+        
+        Index indices[3];
+        std::memcpy(indices, data + layout.indices.offset, sizeof(indices));
+        for (int j = 0; j < 3; j++) {
+            if (!isValidIndex(indices[j], output.vertexCount)) return nullptr;
+            output.indices[i].elements[j] = uint32_t(indices[j]);
+        }
+        
+        const uint8_t paletteId = HasMaterial ? load<uint8_t>(data + layout.material.offset) : 0;
+        if (paletteId >= output.paletteSize) return nullptr;
+        output.materials[i] = output.palette[paletteId];
+    }
+    
+    return data;
+}
+
+const char *readGenericFaces(const char *data, const char *end, const Element &element, const FaceLayout &layout, FaceOutput &output) {
+    std::vector<const char *> properties(element.properties.size());
+    const size_t indexSize = sizeOf(layout.indices.type);
+    
+    for (size_t i = 0; i < element.count; i++) {
+        if (!(data = locateProperties(data, end, element, properties.data()))) return nullptr;
+        
+        const char *list = properties[layout.indices.property];
+        if (loadInteger(list, layout.count.type) != 3) return nullptr;
+        list += sizeOf(layout.count.type);
+        
+        for (int j = 0; j < 3; j++) {
+            const int64_t index = loadInteger(list + j * indexSize, layout.indices.type);
+            if (index < 0 || uint64_t(index) >= output.vertexCount) return nullptr;
+            output.indices[i].elements[j] = uint32_t(index);
+        }
+        
+        const int64_t paletteId = layout.hasMaterial ?
+            loadInteger(properties[layout.material.property], layout.material.type) : 0;
+        if (paletteId < 0 || uint64_t(paletteId) >= output.paletteSize) return nullptr;
+        output.materials[i] = output.palette[paletteId];
+    }
+    
+    return data;
+}
+
+}
+
+const char *readBinaryVertices(
+    const char *data, const char *end,
+    const Element &element, const VertexLayout &layout, VertexOutput &output
+) {
+    const size_t stride = element.recordSize;
+    if (stride > 0 && size_t(end - data) / stride < element.count) return nullptr;
+    
+    if (layout.isCanonical) return readCanonicalVertices(data, element.count, output);
+    if (layout.isFloat) {
+        if (layout.hasNormals && layout.hasTexCoords)
+            return readFloatVertices<true, true>(data, element.count, stride, layout, output);
+        if (layout.hasNormals)
+            return readFloatVertices<true, false>(data, element.count, stride, layout, output);
+        if (layout.hasTexCoords)
+            return readFloatVertices<false, true>(data, element.count, stride, layout, output);
+        return readFloatVertices<false, false>(data, element.count, stride, layout, output);
+    }
+    
+    return readGenericVertices(data, end, element, layout, output);
+}
+
+const char *readBinaryFaces(
+    const char *data, const char *end,
+    const Element &element, const FaceLayout &layout, FaceOutput &output
+) {
+    const size_t stride = layout.triangleRecordSize;
+    const bool isSpecialized = stride > 0 &&
+        layout.count.type == ScalarType::UInt8 &&
+        (layout.indices.type == ScalarType::Int32 || layout.indices.type == ScalarType::UInt32) &&
+        (!layout.hasMaterial || layout.material.type == ScalarType::UInt8);
+    
+    if (isSpecialized) {
+        /// non-triangles will fail the length check before we read past a record
+        if (size_t(end - data) / stride < element.count) return nullptr;
+        
+        const size_t count = element.count;
+        if (layout.indices.type == ScalarType::UInt32) {
+            return layout.hasMaterial ?
+                readTriangleFaces<uint8_t, uint32_t, true>(data, count, stride, layout, output) :
+                readTriangleFaces<uint8_t, uint32_t, false>(data, count, stride, layout, output);
+        }
+        return layout.hasMaterial ?
+            readTriangleFaces<uint8_t, int32_t, true>(data, count, stride, layout, output) :
+            readTriangleFaces<uint8_t, int32_t, false>(data, count, stride, layout, output);
+    }
+    
+    return readGenericFaces(data, end, element, layout, output);
+}
+
+const char *skipBinaryElement(const char *data, const char *end, const Element &element) {
+    if (element.recordSize > 0) {
+        if (size_t(end - data) / element.recordSize < element.count) return nullptr;
+        return data + element.count * element.recordSize;
+    }
+    
+    std::vector<const char *> properties(element.properties.size());
+    for (size_t i = 0; i < element.count && data; i++) {
+        data = locateProperties(data, end, element, properties.data());
+    }
+    return data;
+}
+
+}
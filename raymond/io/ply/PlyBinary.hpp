@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PlyData.hpp"
+#include "PlyHeader.hpp"
+
+namespace raymond::ply {
+
+/**
+ * Reads the vertex records of a `binary_little_endian 1.0` file. Layouts that consist of `float` attributes at
+ * fixed offsets (most notably `x y z nx ny nz s t`) are decoded by specialized loops, all others by a generic
+ * decoder that converts property by property.
+ * @returns pointer past the last record that was read, or `nullptr` if the data is truncated
+ */
+const char *readBinaryVertices(
+    const char *data, const char *end,
+    const Element &element, const VertexLayout &layout, VertexOutput &output);
+
+/**
+ * Reads the face records of a `binary_little_endian 1.0` file. Triangles with `uchar` lengths, `int` or `uint`
+ * indices and an optional `uchar` material index are decoded by specialized loops, all others by a generic decoder.
+ * @returns pointer past the last record that was read, or `nullptr` if the data is malformed
+ */
+const char *readBinaryFaces(
+    const char *data, const char *end,
+    const Element &element, const FaceLayout &layout, FaceOutput &output);
+
+/**
+ * Skips over all records of an element we are not interested in.
+ * @returns pointer past the last record, or `nullptr` if the data is truncated
+ */
+const char *skipBinaryElement(const char *data, const char *end, const Element &element);
+
+}
@@ -0,0 +1,46 @@
+#include "PlyData.hpp"
+
+namespace raymond::ply {
+
+void computeVertexNormals(
+    const Vertex *vertices, Normal *normals, size_t vertexCount,
+    const IndexTriplet *indices, size_t faceCount
+) {
+    for (size_t i = 0; i < vertexCount; i++) {
+        normals[i].x = normals[i].y = normals[i].z = 0;
+    }
+    
+    for (size_t face = 0; face < faceCount; face++) {
+        const Vertex &a = vertices[indices[face].x];
+        const Vertex &b = vertices[indices[face].y];
+        const Vertex &c = vertices[indices[face].z];
+        
+        const float e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+        const float e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+        
+        /// the length of the cross product is twice the area of the face, which gives us the weighting for free
+        const float n[3] = {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0],
+        };
+        
+        for (int corner = 0; corner < 3; corner++) {
+            Normal &normal = normals[indices[face].elements[corner]];
+            for (int dim = 0; dim < 3; dim++) normal.elements[dim] += n[dim];
+        }
+    }
+    
+    for (size_t i = 0; i < vertexCount; i++) {
+        Normal &normal = normals[i];
+        const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length > 0 && std::isfinite(length)) {
+            for (int dim = 0; dim < 3; dim++) normal.elements[dim] /= length;
+        } else {
+            normal.x = normal.y = 0;
+            normal.z = 1;
+        }
+    }
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <bridge/common.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+namespace raymond::ply {
+
+/// Axis aligned bounds of the vertex positions that have been read
+struct Bounds {
+    float min[3] = { +INFINITY, +INFINITY, +INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+    
+    void extend(const Vertex &vertex) {
+        for (int dim = 0; dim < 3; dim++) {
+            min[dim] = std::fmin(min[dim], vertex.elements[dim]);
+            max[dim] = std::fmax(max[dim], vertex.elements[dim]);
+        }
+    }
+    
+    void extend(const Bounds &other) {
+        for (int dim = 0; dim < 3; dim++) {
+            min[dim] = std::fmin(min[dim], other.min[dim]);
+            max[dim] = std::fmax(max[dim], other.max[dim]);
+        }
+    }
+};
+
+/// Destination of vertex elements, usually slices of the buffers that `ShapeBuilder.build` allocates
+struct VertexOutput {
+    Vertex *vertices;
+    Normal *normals;
+    TexCoord *texCoords;
+    Bounds bounds;
+};
+
+/// Destination of face elements, with material ids being translated through the palette of the shape
+struct FaceOutput {
+    IndexTriplet *indices;
+    MaterialIndex *materials;
+    const MaterialIndex *palette;
+    size_t paletteSize;
+    /// faces referencing vertices beyond this count are rejected
+    size_t vertexCount;
+};
+
+/**
+ * Computes smooth normals for meshes that do not come with their own, by averaging the normals of adjacent faces
+ * weighted by their area. Vertices that are not part of any (non-degenerate) face receive `(0, 0, 1)`.
+ */
+void computeVertexNormals(
+    const Vertex *vertices, Normal *normals, size_t vertexCount,
+    const IndexTriplet *indices, size_t faceCount);
+
+}
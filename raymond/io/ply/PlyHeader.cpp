@@ -0,0 +1,263 @@
+#include "PlyHeader.hpp"
+
+#include <cstring>
+#include <sstream>
+
+namespace raymond::ply {
+
+namespace {
+
+bool parseScalarType(const std::string &name, ScalarType &type) {
+    static const struct {
+        const char *names[2];
+        ScalarType type;
+    } types[] = {
+        { { "char", "int8" }, ScalarType::Int8 },
+        { { "uchar", "uint8" }, ScalarType::UInt8 },
+        { { "short", "int16" }, ScalarType::Int16 },
+        { { "ushort", "uint16" }, ScalarType::UInt16 },
+        { { "int", "int32" }, ScalarType::Int32 },
+        { { "uint", "uint32" }, ScalarType::UInt32 },
+        { { "float", "float32" }, ScalarType::Float32 },
+        { { "double", "float64" }, ScalarType::Float64 },
+    };
+    
+    for (const auto &entry : types) {
+        if (name == entry.names[0] || name == entry.names[1]) {
+            type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isInteger(ScalarType type) {
+    return type != ScalarType::Float32 && type != ScalarType::Float64;
+}
+
+/// Computes property offsets and record sizes, lists are assumed to have `listLength` entries
+size_t layoutRecord(const Element &element, size_t listLength, std::vector<size_t> *offsets) {
+    size_t offset = 0;
+    for (const Property &property : element.properties) {
+        if (offsets) offsets->push_back(offset);
+        offset += property.isList ?
+            sizeOf(property.countType) + listLength * sizeOf(property.type) :
+            sizeOf(property.type);
+    }
+    return offset;
+}
+
+Attribute makeAttribute(const Element &element, int property) {
+    Attribute attribute;
+    attribute.property = property;
+    if (property >= 0) {
+        attribute.type = element.properties[property].type;
+        attribute.offset = element.properties[property].offset;
+    }
+    return attribute;
+}
+
+/** @returns true if all names could be found, in which case `attributes` will be filled */
+template<int N>
+bool findAttributes(const Element &element, const char *const (&names)[N], Attribute *attributes) {
+    int properties[N];
+    for (int i = 0; i < N; i++) {
+        properties[i] = element.find(names[i]);
+        if (properties[i] < 0 || element.properties[properties[i]].isList) return false;
+    }
+    
+    for (int i = 0; i < N; i++) attributes[i] = makeAttribute(element, properties[i]);
+    return true;
+}
+
+}
+
+size_t sizeOf(ScalarType type) {
+    switch (type) {
+    case ScalarType::Int8:
+    case ScalarType::UInt8: return 1;
+    case ScalarType::Int16:
+    case ScalarType::UInt16: return 2;
+    case ScalarType::Int32:
+    case ScalarType::UInt32:
+    case ScalarType::Float32: return 4;
+    case ScalarType::Float64: return 8;
+    }
+    return 0;
+}
+
+int Element::find(const char *name) const {
+    for (size_t i = 0; i < properties.size(); i++) {
+        if (properties[i].name == name) return int(i);
+    }
+    return -1;
+}
+
+int Header::find(const char *name) const {
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (elements[i].name == name) return int(i);
+    }
+    return -1;
+}
+
+bool parseHeader(const char *data, const char *end, Header &header) {
+    header = Header();
+    
+    bool hasFormat = false;
+    const char *head = data;
+    for (int lineNumber = 0;; lineNumber++) {
+        const char *lineEnd = (const char *)std::memchr(head, '\n', end - head);
+        if (!lineEnd) return false;
+        
+        std::string line(head, lineEnd);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        head = lineEnd + 1;
+        
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        
+        if (lineNumber == 0) {
+            if (keyword != "ply") return false;
+        } else if (keyword == "format") {
+            std::string format, version;
+            tokens >> format >> version;
+            if (version != "1.0") return false;
+            
+            if (format == "ascii") header.format = Format::Ascii;
+            else if (format == "binary_little_endian") header.format = Format::BinaryLittleEndian;
+            else if (format == "binary_big_endian") header.format = Format::BinaryBigEndian;
+            else return false;
+            hasFormat = true;
+        } else if (keyword == "comment" || keyword == "obj_info" || keyword.empty()) {
+            continue;
+        } else if (keyword == "element") {
+            Element element;
+            long long count = -1;
+            if (!(tokens >> element.name >> count) || count < 0) return false;
+            
+            element.count = size_t(count);
+            header.elements.push_back(std::move(element));
+        } else if (keyword == "property") {
+            if (header.elements.empty()) return false;
+            
+            Property property;
+            std::string type;
+            if (!(tokens >> type)) return false;
+            
+            if (type == "list") {
+                std::string countType;
+                tokens >> countType >> type;
+                if (!parseScalarType(countType, property.countType) || !isInteger(property.countType)) return false;
+                property.isList = true;
+            }
+            
+            if (!parseScalarType(type, property.type) || !(tokens >> property.name)) return false;
+            header.elements.back().properties.push_back(std::move(property));
+        } else if (keyword == "end_header") {
+            break;
+        } else {
+            return false;
+        }
+    }
+    
+    if (!hasFormat) return false;
+    header.dataOffset = head - data;
+    
+    for (Element &element : header.elements) {
+        std::vector<size_t> offsets;
+        layoutRecord(element, 0, &offsets);
+        
+        bool isVariable = false;
+        for (size_t i = 0; i < element.properties.size(); i++) {
+            Property &property = element.properties[i];
+            property.offset = isVariable ? VariableOffset : offsets[i];
+            isVariable |= property.isList;
+        }
+        
+        element.recordSize = isVariable ? 0 : layoutRecord(element, 0, nullptr);
+    }
+    
+    return true;
+}
+
+bool resolveVertexLayout(const Element &element, VertexLayout &layout) {
+    layout = VertexLayout();
+    
+    static const char *const positionNames[] = { "x", "y", "z" };
+    static const char *const normalNames[] = { "nx", "ny", "nz" };
+    static const char *const texCoordNames[][2] = {
+        { "s", "t" },
+        { "u", "v" },
+        { "texture_u", "texture_v" },
+        { "texture_s", "texture_t" },
+    };
+    
+    if (!findAttributes(element, positionNames, layout.position)) return false;
+    layout.hasNormals = findAttributes(element, normalNames, layout.normal);
+    for (const auto &names : texCoordNames) {
+        if ((layout.hasTexCoords = findAttributes(element, names, layout.texCoord))) break;
+    }
+    
+    layout.isFloat = element.recordSize > 0;
+    auto checkFloat = [&](const Attribute *attributes, int count) {
+        for (int i = 0; i < count; i++) layout.isFloat &= attributes[i].type == ScalarType::Float32;
+    };
+    checkFloat(layout.position, 3);
+    if (layout.hasNormals) checkFloat(layout.normal, 3);
+    if (layout.hasTexCoords) checkFloat(layout.texCoord, 2);
+    
+    layout.isCanonical = layout.isFloat && layout.hasNormals && layout.hasTexCoords &&
+        element.properties.size() == 8 && element.recordSize == 8 * sizeof(float);
+    const Attribute *canonicalOrder[] = {
+        &layout.position[0], &layout.position[1], &layout.position[2],
+        &layout.normal[0], &layout.normal[1], &layout.normal[2],
+        &layout.texCoord[0], &layout.texCoord[1],
+    };
+    for (int i = 0; i < 8 && layout.isCanonical; i++) {
+        layout.isCanonical = canonicalOrder[i]->property == i;
+    }
+    
+    return true;
+}
+
+bool resolveFaceLayout(const Element &element, FaceLayout &layout) {
+    layout = FaceLayout();
+    
+    int indices = element.find("vertex_indices");
+    if (indices < 0) indices = element.find("vertex_index");
+    if (indices < 0) return false;
+    
+    const Property &indexProperty = element.properties[indices];
+    if (!indexProperty.isList || !isInteger(indexProperty.type)) return false;
+    
+    const int material = element.find("material_index");
+    layout.hasMaterial = material >= 0;
+    if (layout.hasMaterial) {
+        const Property &materialProperty = element.properties[material];
+        if (materialProperty.isList || !isInteger(materialProperty.type)) return false;
+    }
+    
+    /// if the index list is the only list, triangle records have a fixed size and fixed offsets
+    int listCount = 0;
+    for (const Property &property : element.properties) listCount += property.isList;
+    
+    std::vector<size_t> offsets;
+    const size_t recordSize = layoutRecord(element, 3, &offsets);
+    
+    layout.indices = makeAttribute(element, indices);
+    layout.count = layout.indices;
+    layout.count.type = indexProperty.countType;
+    if (layout.hasMaterial) layout.material = makeAttribute(element, material);
+    
+    if (listCount == 1) {
+        layout.triangleRecordSize = recordSize;
+        layout.count.offset = offsets[indices];
+        layout.indices.offset = offsets[indices] + sizeOf(indexProperty.countType);
+        if (layout.hasMaterial) layout.material.offset = offsets[material];
+    }
+    
+    return true;
+}
+
+}
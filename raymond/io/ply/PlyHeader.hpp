@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace raymond::ply {
+
+enum class Format {
+    Ascii,
+    BinaryLittleEndian,
+    BinaryBigEndian,
+};
+
+enum class ScalarType : uint8_t {
+    Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64,
+};
+
+/** @returns size of the type in bytes when stored in a binary file */
+size_t sizeOf(ScalarType type);
+
+/// Marks a property offset that depends on the length of a preceding list
+constexpr size_t VariableOffset = SIZE_MAX;
+
+struct Property {
+    std::string name;
+    ScalarType type;
+    
+    bool isList = false;
+    /// type of the length prefix of list properties
+    ScalarType countType = ScalarType::UInt8;
+    
+    /// byte offset within a binary record, or `VariableOffset` if a list comes before this property
+    size_t offset = 0;
+};
+
+struct Element {
+    std::string name;
+    size_t count;
+    std::vector<Property> properties;
+    
+    /// size of a binary record, or zero if the element contains lists
+    size_t recordSize = 0;
+    
+    /** @returns index of the property with the given name, or -1 if the element has no such property */
+    int find(const char *name) const;
+};
+
+struct Header {
+    Format format;
+    std::vector<Element> elements;
+    
+    /// offset of the first byte after `end_header`
+    size_t dataOffset;
+    
+    /** @returns index of the element with the given name, or -1 if the file has no such element */
+    int find(const char *name) const;
+};
+
+/**
+ * Parses the header at the start of a PLY file (`ply`, `format`, `comment`, `obj_info`, `element`, `property`
+ * and `end_header` lines) into a schema of its elements.
+ * @returns false if the header is malformed
+ */
+bool parseHeader(const char *data, const char *end, Header &header);
+
+/// Where to find one component of an attribute in a vertex record
+struct Attribute {
+    /// index of the property within the element (and column within an ascii line)
+    int property = -1;
+    ScalarType type = ScalarType::Float32;
+    size_t offset = 0;
+};
+
+/// Maps vertex properties to our attributes, the canonical layout being `x y z nx ny nz s t` as written by our exporter
+struct VertexLayout {
+    Attribute position[3];
+    Attribute normal[3];
+    Attribute texCoord[2];
+    bool hasNormals = false;
+    bool hasTexCoords = false;
+    
+    /// every attribute that is present is a `float` at a fixed offset
+    bool isFloat = false;
+    /// the record is exactly `x y z nx ny nz s t` in this order, all of type `float`
+    bool isCanonical = false;
+};
+
+/// Maps face properties to our attributes, the canonical layout being `list uchar uint vertex_indices, uchar material_index`
+struct FaceLayout {
+    Attribute count;
+    Attribute indices;
+    Attribute material;
+    bool hasMaterial = false;
+    
+    /// size of a binary record under the assumption that the face is a triangle, or zero if the size varies
+    size_t triangleRecordSize = 0;
+};
+
+/**
+ * Finds positions, normals (`nx ny nz`) and texture coordinates (`s t`, `u v`, `texture_u texture_v` or
+ * `texture_s texture_t`) among the properties of the vertex element. Unknown properties are skipped when decoding.
+ * @returns false if positions are missing or stored as lists
+ */
+bool resolveVertexLayout(const Element &element, VertexLayout &layout);
+
+/**
+ * Finds the index list (`vertex_indices` or `vertex_index`) and the optional `material_index` of the face element.
+ * @returns false if there is no integer index list
+ */
+bool resolveFaceLayout(const Element &element, FaceLayout &layout);
+
+}
@@ -0,0 +1,231 @@
+#include "RBvh.hpp"
+
+#include <io/MappedFile.hpp>
+#include <utils/Hash.hpp>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace raymond::rbvh {
+
+namespace {
+
+constexpr char Magic[8] = { 'R', 'B', 'V', 'H', 0, 0, 0, 0 };
+/// needs to be bumped whenever the layout of the file, the stored types or the output of the builders changes
+constexpr uint32_t Version = 2;
+/// arrays start at aligned offsets, so that `read` can copy them out of the mapping with aligned loads
+constexpr size_t Alignment = 16;
+
+enum ArrayIndex {
+    ArrayNodes,
+    ArrayPrimitives,
+    ArrayCount
+};
+
+/// Everything that influences the output of the builders, all fields are four bytes so that there is no padding
+struct SettingsKey {
+    uint32_t quality;
+    int32_t binCount;
+    uint32_t maxLeafSize;
+    float traversalCost;
+    float intersectionCost;
+    float spatialSplitBudget;
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    
+    /// sizes of the stored types, which guards against changes to the node layout
+    uint32_t typeSizes[ArrayCount];
+    
+    uint64_t geometryHash;
+    SettingsKey settings;
+    
+    /// statistics of the original build
+    float sahCost;
+    uint32_t maxDepth;
+    uint64_t leafCount;
+    
+    uint64_t counts[ArrayCount];
+    uint64_t offsets[ArrayCount];
+    uint64_t fileSize;
+};
+
+constexpr uint32_t TypeSizes[ArrayCount] = {
+    sizeof(bvh::Node), sizeof(uint32_t),
+};
+
+SettingsKey settingsKey(const bvh::BuildSettings &settings) {
+    return {
+        uint32_t(settings.quality), settings.binCount, settings.maxLeafSize,
+        settings.traversalCost, settings.intersectionCost, settings.spatialSplitBudget,
+    };
+}
+
+size_t alignUp(size_t offset) {
+    return (offset + Alignment - 1) / Alignment * Alignment;
+}
+
+/// triangles whose corners are gathered before hashing them as one block
+constexpr size_t HashChunkSize = 4096;
+
+}
+
+std::string cachePath(const std::string &sourcePath) {
+    return sourcePath + ".rbvh";
+}
+
+uint64_t geometryHash(const bvh::Mesh &mesh) {
+    std::vector<Vertex> corners(3 * HashChunkSize);
+    uint64_t hash = hash64(&mesh.faceCount, sizeof(mesh.faceCount));
+    for (size_t chunk = 0; chunk < mesh.faceCount; chunk += HashChunkSize) {
+        const size_t end = std::min<size_t>(mesh.faceCount, chunk + HashChunkSize);
+        for (size_t face = chunk; face < end; face++) {
+            Vertex *corner = &corners[3 * (face - chunk)];
+            mesh.corners(FaceIndex(face), corner[0], corner[1], corner[2]);
+        }
+        hash = hash64(corners.data(), 3 * sizeof(Vertex) * (end - chunk), hash);
+    }
+    return hash;
+}
+
+bool read(const std::string &cachePath, uint64_t geometryHash, const bvh::BuildSettings &settings, bvh::Bvh &bvh,
+          bvh::BuildStats *stats) {
+    MappedFile file;
+    if (!file.open(cachePath)) return false;
+    
+    FileHeader header;
+    if (file.size() < sizeof(header)) return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+        header.version != Version ||
+        header.headerSize != sizeof(FileHeader) ||
+        std::memcmp(header.typeSizes, TypeSizes, sizeof(TypeSizes)) != 0 ||
+        header.fileSize != file.size()
+    ) {
+        return false;
+    }
+    
+    const SettingsKey expectedSettings = settingsKey(settings);
+    if (header.geometryHash != geometryHash ||
+        std::memcmp(&header.settings, &expectedSettings, sizeof(SettingsKey)) != 0
+    ) {
+        return false;
+    }
+    
+    for (int i = 0; i < ArrayCount; i++) {
+        /// protects against truncated or corrupted files
+        if (header.offsets[i] % Alignment != 0 || header.offsets[i] > file.size()) return false;
+        if (header.counts[i] > (file.size() - header.offsets[i]) / TypeSizes[i]) return false;
+    }
+    
+    /// the arrays are copied out of the mapping, so that the hierarchy does not depend on the file staying around
+    file.adviseSequential(0, file.size());
+    const bvh::Node *nodes = (const bvh::Node *)(file.data() + header.offsets[ArrayNodes]);
+    const uint32_t *primitives = (const uint32_t *)(file.data() + header.offsets[ArrayPrimitives]);
+    bvh.nodes.assign(nodes, nodes + header.counts[ArrayNodes]);
+    bvh.primitives.assign(primitives, primitives + header.counts[ArrayPrimitives]);
+    
+    if (stats) {
+        stats->sahCost = header.sahCost;
+        stats->nodeCount = bvh.nodes.size();
+        stats->leafCount = size_t(header.leafCount);
+        stats->maxDepth = header.maxDepth;
+    }
+    return true;
+}
+
+bool write(const std::string &cachePath, uint64_t geometryHash, const bvh::BuildSettings &settings, const bvh::Bvh &bvh,
+           const bvh::BuildStats &stats) {
+    FileHeader header = FileHeader(); // zero initializes padding, so cache files are reproducible
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.headerSize = sizeof(FileHeader);
+    std::memcpy(header.typeSizes, TypeSizes, sizeof(TypeSizes));
+    
+    header.geometryHash = geometryHash;
+    header.settings = settingsKey(settings);
+    header.sahCost = stats.sahCost;
+    header.maxDepth = stats.maxDepth;
+    header.leafCount = stats.leafCount;
+    
+    const void *arrays[ArrayCount] = { bvh.nodes.data(), bvh.primitives.data() };
+    header.counts[ArrayNodes] = bvh.nodes.size();
+    header.counts[ArrayPrimitives] = bvh.primitives.size();
+    
+    size_t offset = sizeof(FileHeader);
+    for (int i = 0; i < ArrayCount; i++) {
+        offset = alignUp(offset);
+        header.offsets[i] = offset;
+        offset += header.counts[i] * TypeSizes[i];
+    }
+    header.fileSize = offset;
+    
+    /// unique per write, since shapes that share a source file can be written concurrently by `ShapeBuilder`
+    std::string temporaryPath = cachePath + ".tmpXXXXXX";
+    const int descriptor = mkstemp(temporaryPath.data());
+    if (descriptor < 0) return false;
+    
+    /// `mkstemp` creates files that only the owner can read
+    fchmod(descriptor, 0644);
+    FILE *file = fdopen(descriptor, "wb");
+    if (!file) {
+        close(descriptor);
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+    
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t position = sizeof(header);
+    static const char padding[Alignment] = {};
+    for (int i = 0; i < ArrayCount && success; i++) {
+        success &= fwrite(padding, 1, header.offsets[i] - position, file) == header.offsets[i] - position;
+        
+        const size_t size = header.counts[i] * TypeSizes[i];
+        success &= size == 0 || fwrite(arrays[i], size, 1, file) == 1;
+        position = header.offsets[i] + size;
+    }
+    
+    success &= fclose(file) == 0;
+    success = success && rename(temporaryPath.c_str(), cachePath.c_str()) == 0;
+    if (!success) unlink(temporaryPath.c_str());
+    return success;
+}
+
+bvh::Bvh readOrBuildBlas(const std::string &cachePath, const bvh::Mesh &mesh, const bvh::BuildSettings &settings,
+                         bvh::BuildStats *stats) {
+    const auto startTime = std::chrono::steady_clock::now();
+    const uint64_t hash = geometryHash(mesh);
+    
+    bvh::Bvh bvh;
+    bvh::BuildStats cachedStats;
+    /// spatial splits reference some faces more than once
+    const auto hasAllFaces = [&]() {
+        return settings.quality == bvh::BuildQuality::Spatial ?
+            bvh.primitives.size() >= mesh.faceCount :
+            bvh.primitives.size() == mesh.faceCount;
+    };
+    if (read(cachePath, hash, settings, bvh, &cachedStats) && hasAllFaces()) {
+        cachedStats.buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (stats) *stats = cachedStats;
+        return bvh;
+    }
+    
+    bvh::BuildStats buildStats;
+    bvh = bvh::buildBlas(mesh, settings, &buildStats);
+    /// a cache that cannot be written (e.g. in a read-only directory) only means that the next launch builds again
+    write(cachePath, hash, settings, bvh, buildStats);
+    
+    if (stats) *stats = buildStats;
+    return bvh;
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <bvh/Bvh.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace raymond::rbvh {
+
+/** @returns path of the hierarchy cache that belongs to the given source file, next to its mesh cache */
+std::string cachePath(const std::string &sourcePath);
+
+/**
+ * Hashes the corners of every triangle in face order, which is all that the builders see of a mesh. Materials, normals
+ * and texture coordinates are left out, so that shapes which only differ in those share the cache of their source.
+ */
+uint64_t geometryHash(const bvh::Mesh &mesh);
+
+/**
+ * Maps a cache file and reads the hierarchy stored in it, as long as it was built from geometry with the given hash
+ * (see `geometryHash`) and with the same build settings.
+ * @returns false if there is no cache, it was written by an incompatible version or it is out of date
+ */
+bool read(const std::string &cachePath, uint64_t geometryHash, const bvh::BuildSettings &settings, bvh::Bvh &bvh,
+          bvh::BuildStats *stats = nullptr);
+
+/**
+ * Writes a cache file for a hierarchy, together with the statistics of its build so that cache hits can report them.
+ * The file is written under a temporary name first and then renamed, so concurrent readers never see a partially
+ * written cache.
+ * @returns false if the cache could not be written
+ */
+bool write(const std::string &cachePath, uint64_t geometryHash, const bvh::BuildSettings &settings, const bvh::Bvh &bvh,
+           const bvh::BuildStats &stats);
+
+/**
+ * Reads the bottom level hierarchy of a mesh from its cache, or builds it with `buildBlas` and updates the cache.
+ * The `buildTime` of the statistics is the time spent hashing and reading if the cache was used.
+ */
+bvh::Bvh readOrBuildBlas(const std::string &cachePath, const bvh::Mesh &mesh, const bvh::BuildSettings &settings,
+                         bvh::BuildStats *stats = nullptr);
+
+}
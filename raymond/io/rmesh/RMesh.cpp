@@ -0,0 +1,231 @@
+#include "RMesh.hpp"
+
+#include <io/MappedFile.hpp>
+#include <utils/Hash.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace raymond::rmesh {
+
+namespace {
+
+constexpr char Magic[8] = { 'R', 'M', 'E', 'S', 'H', 0, 0, 0 };
+/// needs to be bumped whenever the layout of the file or of the stored types changes
+constexpr uint32_t Version = 2;
+/// arrays are aligned so that they can be read in place
+constexpr size_t Alignment = 16;
+
+/// bits of `FileHeader::flags`
+constexpr uint32_t FlagOptimized = 1 << 0;
+
+enum ArrayIndex {
+    ArrayVertices,
+    ArrayNormals,
+    ArrayTexCoords,
+    ArrayIndices,
+    ArrayMaterials,
+    ArrayPalette,
+    ArrayCount
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t flags;
+    uint32_t reserved;
+    
+    /// sizes of the stored types, which guards against changes to the shared structs
+    uint32_t typeSizes[ArrayCount];
+    
+    SourceKey source;
+    
+    uint64_t vertexCount;
+    uint64_t faceCount;
+    uint64_t paletteSize;
+    float boundsMin[3];
+    float boundsMax[3];
+    
+    uint64_t offsets[ArrayCount];
+    uint64_t fileSize;
+};
+
+constexpr uint32_t TypeSizes[ArrayCount] = {
+    sizeof(Vertex), sizeof(Normal), sizeof(TexCoord), sizeof(IndexTriplet), sizeof(MaterialIndex), sizeof(MaterialIndex),
+};
+
+size_t alignUp(size_t offset) {
+    return (offset + Alignment - 1) / Alignment * Alignment;
+}
+
+bool statSource(const std::string &path, SourceKey &key) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return false;
+    
+    key.size = uint64_t(info.st_size);
+#ifdef __APPLE__
+    key.mtime = int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    key.mtime = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+bool hashSource(const std::string &path, SourceKey &key) {
+    MappedFile source;
+    if (!source.open(path)) return false;
+    
+    source.adviseSequential(0, source.size());
+    key.hash = hash64(source.data(), source.size());
+    return true;
+}
+
+/// Stores the new modification time, so that we do not need to hash the source again next time
+void refreshSourceKey(const std::string &cachePath, const SourceKey &key) {
+    const int fd = ::open(cachePath.c_str(), O_WRONLY);
+    if (fd < 0) return;
+    
+    pwrite(fd, &key, sizeof(key), offsetof(FileHeader, source));
+    ::close(fd);
+}
+
+}
+
+std::string cachePath(const std::string &sourcePath) {
+    return sourcePath + ".rmesh";
+}
+
+bool map(const std::string &cachePath, MappedFile &file, MeshView &view) {
+    if (!file.open(cachePath)) return false;
+    
+    FileHeader header;
+    if (file.size() < sizeof(header)) return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+        header.version != Version ||
+        header.headerSize != sizeof(FileHeader) ||
+        std::memcmp(header.typeSizes, TypeSizes, sizeof(TypeSizes)) != 0 ||
+        header.fileSize != file.size()
+    ) {
+        return false;
+    }
+    
+    const uint64_t counts[ArrayCount] = {
+        header.vertexCount, header.vertexCount, header.vertexCount,
+        header.faceCount, header.faceCount,
+        header.paletteSize,
+    };
+    for (int i = 0; i < ArrayCount; i++) {
+        /// protects against truncated or corrupted files
+        if (header.offsets[i] % Alignment != 0 || header.offsets[i] > file.size()) return false;
+        if (counts[i] > (file.size() - header.offsets[i]) / TypeSizes[i]) return false;
+    }
+    
+    const char *data = file.data();
+    view.vertices = (const Vertex *)(data + header.offsets[ArrayVertices]);
+    view.normals = (const Normal *)(data + header.offsets[ArrayNormals]);
+    view.texCoords = (const TexCoord *)(data + header.offsets[ArrayTexCoords]);
+    view.vertexCount = size_t(header.vertexCount);
+    view.indices = (const IndexTriplet *)(data + header.offsets[ArrayIndices]);
+    view.materials = (const MaterialIndex *)(data + header.offsets[ArrayMaterials]);
+    view.faceCount = size_t(header.faceCount);
+    view.palette = (const MaterialIndex *)(data + header.offsets[ArrayPalette]);
+    view.paletteSize = size_t(header.paletteSize);
+    std::memcpy(view.boundsMin, header.boundsMin, sizeof(view.boundsMin));
+    std::memcpy(view.boundsMax, header.boundsMax, sizeof(view.boundsMax));
+    view.isOptimized = header.flags & FlagOptimized;
+    return true;
+}
+
+bool open(const std::string &cachePath, const std::string &sourcePath, MappedFile &file, MeshView &view) {
+    SourceKey current;
+    if (!statSource(sourcePath, current) || !map(cachePath, file, view)) {
+        file.close();
+        return false;
+    }
+    
+    SourceKey cached;
+    std::memcpy(&cached, file.data() + offsetof(FileHeader, source), sizeof(cached));
+    
+    bool isValid = cached.size == current.size;
+    if (isValid && cached.mtime != current.mtime) {
+        /// the file was touched, but its contents might still be the same (e.g. after a checkout or copy)
+        isValid = hashSource(sourcePath, current) && cached.hash == current.hash;
+        if (isValid) refreshSourceKey(cachePath, current);
+    }
+    
+    if (!isValid) file.close();
+    return isValid;
+}
+
+bool write(const std::string &cachePath, const std::string &sourcePath, const MeshView &mesh) {
+    FileHeader header = FileHeader(); // zero initializes padding, so cache files are reproducible
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.headerSize = sizeof(FileHeader);
+    header.flags = mesh.isOptimized ? FlagOptimized : 0;
+    std::memcpy(header.typeSizes, TypeSizes, sizeof(TypeSizes));
+    
+    if (!statSource(sourcePath, header.source) || !hashSource(sourcePath, header.source)) return false;
+    
+    header.vertexCount = mesh.vertexCount;
+    header.faceCount = mesh.faceCount;
+    header.paletteSize = mesh.paletteSize;
+    std::memcpy(header.boundsMin, mesh.boundsMin, sizeof(header.boundsMin));
+    std::memcpy(header.boundsMax, mesh.boundsMax, sizeof(header.boundsMax));
+    
+    const void *arrays[ArrayCount] = {
+        mesh.vertices, mesh.normals, mesh.texCoords, mesh.indices, mesh.materials, mesh.palette,
+    };
+    const uint64_t counts[ArrayCount] = {
+        mesh.vertexCount, mesh.vertexCount, mesh.vertexCount,
+        mesh.faceCount, mesh.faceCount,
+        mesh.paletteSize,
+    };
+    
+    size_t offset = sizeof(FileHeader);
+    for (int i = 0; i < ArrayCount; i++) {
+        offset = alignUp(offset);
+        header.offsets[i] = offset;
+        offset += counts[i] * TypeSizes[i];
+    }
+    header.fileSize = offset;
+    
+    /// unique per write, since shapes that share a source file can be written concurrently by `ShapeBuilder`
+    std::string temporaryPath = cachePath + ".tmpXXXXXX";
+    const int descriptor = mkstemp(temporaryPath.data());
+    if (descriptor < 0) return false;
+    
+    /// `mkstemp` creates files that only the owner can read
+    fchmod(descriptor, 0644);
+    FILE *file = fdopen(descriptor, "wb");
+    if (!file) {
+        close(descriptor);
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+    
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t position = sizeof(header);
+    static const char padding[Alignment] = {};
+    for (int i = 0; i < ArrayCount && success; i++) {
+        success &= fwrite(padding, 1, header.offsets[i] - position, file) == header.offsets[i] - position;
+        
+        const size_t size = counts[i] * TypeSizes[i];
+        success &= size == 0 || fwrite(arrays[i], size, 1, file) == 1;
+        position = header.offsets[i] + size;
+    }
+    
+    success &= fclose(file) == 0;
+    success = success && rename(temporaryPath.c_str(), cachePath.c_str()) == 0;
+    if (!success) unlink(temporaryPath.c_str());
+    return success;
+}
+
+}
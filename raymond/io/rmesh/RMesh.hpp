@@ -0,0 +1,68 @@
+#pragma once
+
+#include <bridge/common.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace raymond {
+class MappedFile;
+}
+
+namespace raymond::rmesh {
+
+/// Identifies the contents of a source file, the hash is only computed when size and modification time are not enough
+struct SourceKey {
+    uint64_t size = 0;
+    int64_t mtime = 0; // nanoseconds since the epoch
+    uint64_t hash = 0;
+};
+
+/// Mesh arrays in the layout that `ShapeBuilder` uploads, either pointing into a mapped cache file or into buffers to be written
+struct MeshView {
+    const Vertex *vertices = nullptr;
+    const Normal *normals = nullptr;
+    const TexCoord *texCoords = nullptr;
+    size_t vertexCount = 0;
+    
+    const IndexTriplet *indices = nullptr;
+    /// material indices resolved through `palette`
+    const MaterialIndex *materials = nullptr;
+    size_t faceCount = 0;
+    
+    /// material index of every material slot of the shape at the time the cache was written
+    const MaterialIndex *palette = nullptr;
+    size_t paletteSize = 0;
+    
+    float boundsMin[3];
+    float boundsMax[3];
+    
+    /// whether the mesh has been through `optimize_mesh`
+    bool isOptimized = false;
+};
+
+/** @returns path of the cache file that belongs to the given source file */
+std::string cachePath(const std::string &sourcePath);
+
+/**
+ * Maps a cache file without checking whether it is still up to date.
+ * @returns false if the file does not exist or was written by an incompatible version
+ */
+bool map(const std::string &cachePath, MappedFile &file, MeshView &view);
+
+/**
+ * Maps a cache file and checks that it was created from the current contents of the source file.
+ * Size and modification time are compared first, the source is only hashed if its modification time changed.
+ * @returns false if there is no cache or it is out of date
+ */
+bool open(const std::string &cachePath, const std::string &sourcePath, MappedFile &file, MeshView &view);
+
+/**
+ * Writes a cache file for the mesh that was parsed from the given source. The file is written under a temporary
+ * name first and then renamed, so concurrent readers never see a partially written cache.
+ * @returns false if the cache could not be written
+ */
+bool write(const std::string &cachePath, const std::string &sourcePath, const MeshView &mesh);
+
+}
@@ -1,6 +1,7 @@
 #include "logging.h"
 
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -31,6 +32,9 @@ struct Logger *logger_create(const char *subsystem) {
 }
 
 void logger_log(struct Logger *logger, LogLevel level, const char *text) {
+    /// shapes are loaded on multiple threads, keep their messages from interleaving
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
     for (const auto &callback : callbacks()) {
         callback.first(level, logger->name.c_str(), text, callback.second);
     }
@@ -0,0 +1,186 @@
+#include "PagedGeometry.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+namespace raymond {
+
+namespace {
+
+size_t elementSize(PagedGeometry::Stream stream) {
+    switch (stream) {
+    case PagedGeometry::Stream::Vertices: return sizeof(Vertex);
+    case PagedGeometry::Stream::Normals: return sizeof(Normal);
+    case PagedGeometry::Stream::TexCoords: return sizeof(TexCoord);
+    case PagedGeometry::Stream::Indices: return sizeof(IndexTriplet);
+    case PagedGeometry::Stream::Materials: return sizeof(MaterialIndex);
+    }
+    return 0;
+}
+
+bool isFaceStream(PagedGeometry::Stream stream) {
+    return stream == PagedGeometry::Stream::Indices || stream == PagedGeometry::Stream::Materials;
+}
+
+std::atomic<uint64_t> nextGeometryId { 0 };
+
+}
+
+PagedGeometry::PagedGeometry(size_t memoryBudget)
+    : m_id(nextGeometryId.fetch_add(1)), m_memoryBudget(memoryBudget),
+      m_residentBytes(std::make_shared<std::atomic<size_t>>(0)) {}
+
+bool PagedGeometry::addShape(const std::string &cachePath, const MaterialIndex *palette, size_t paletteSize) {
+    Shape shape;
+    if (!rmesh::map(cachePath, shape.file, shape.view)) return false;
+    if (m_vertexCount + shape.view.vertexCount > UINT32_MAX || m_faceCount + shape.view.faceCount > UINT32_MAX) {
+        return false;
+    }
+    
+    shape.range.vertexOffset = m_vertexCount;
+    shape.range.vertexCount = VertexIndex(shape.view.vertexCount);
+    shape.range.faceOffset = m_faceCount;
+    shape.range.faceCount = FaceIndex(shape.view.faceCount);
+    shape.palette.assign(palette, palette + paletteSize);
+    
+    /// pages that straddle the end of the previous shape need to be loaded again to include the new one
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_lru.begin(); it != m_lru.end();) {
+        const uint64_t key = *it++;
+        const Stream stream = Stream(key >> 56);
+        const size_t end = ((key & ((uint64_t(1) << 56) - 1)) + 1) * PageElements;
+        if (end > (isFaceStream(stream) ? m_faceCount : m_vertexCount)) {
+            m_lru.erase(m_pages.at(key).lru);
+            m_pages.erase(key);
+        }
+    }
+    
+    m_vertexCount += shape.range.vertexCount;
+    m_faceCount += shape.range.faceCount;
+    m_shapes.push_back(std::move(shape));
+    return true;
+}
+
+size_t PagedGeometry::residentBytes() const {
+    return m_residentBytes->load();
+}
+
+size_t PagedGeometry::pageFaults() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pageFaults;
+}
+
+PagedGeometry::Reader &PagedGeometry::threadReader() {
+    struct Entry {
+        uint64_t id;
+        std::unique_ptr<Reader> reader;
+    };
+    /// a thread rarely alternates between geometries, so only the reader of the last one is kept
+    thread_local Entry entry { ~uint64_t(0), nullptr };
+    if (entry.id != m_id) {
+        entry.reader = std::make_unique<Reader>(*this);
+        entry.id = m_id;
+    }
+    return *entry.reader;
+}
+
+PagedGeometry::PinnedPage PagedGeometry::pin(Stream stream, size_t page) {
+    const uint64_t key = pageKey(stream, page);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (auto it = m_pages.find(key); it != m_pages.end(); it = m_pages.find(key)) {
+        if (it->second.data) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+            return it->second.data;
+        }
+        /// another thread is loading the page, which cannot be evicted before it is complete
+        m_loaded.wait(lock);
+    }
+    
+    /// only pages that nobody holds free memory when they are evicted, the others stay in the cache
+    const size_t size = PageElements * elementSize(stream);
+    for (auto it = m_lru.end(); it != m_lru.begin() && m_residentBytes->load() + size > m_memoryBudget;) {
+        --it;
+        /// readers only obtain handles under the lock, so a stale count can only keep a page that could go
+        if (m_pages.at(*it).data.use_count() > 1) continue;
+        m_pages.erase(*it);
+        it = m_lru.erase(it);
+    }
+    
+    /// the page that is being requested is always admitted, even if it exceeds the budget
+    m_pages.emplace(key, Page());
+    m_pageFaults++;
+    *m_residentBytes += size;
+    lock.unlock();
+    
+    char *buffer = new char[size];
+    load(stream, page, buffer);
+    const std::shared_ptr<std::atomic<size_t>> residentBytes = m_residentBytes;
+    const PinnedPage data(buffer, [residentBytes, size](const char *buffer) {
+        delete[] buffer;
+        *residentBytes -= size;
+    });
+    
+    lock.lock();
+    Page &resident = m_pages.at(key);
+    resident.data = data;
+    m_lru.push_front(key);
+    resident.lru = m_lru.begin();
+    lock.unlock();
+    m_loaded.notify_all();
+    return data;
+}
+
+void PagedGeometry::load(Stream stream, size_t page, char *output) const {
+    const bool isFace = isFaceStream(stream);
+    const size_t total = isFace ? m_faceCount : m_vertexCount;
+    const size_t begin = page * PageElements;
+    const size_t end = std::min(begin + PageElements, total);
+    assert(begin < end && "page index out of range");
+    
+    const size_t stride = elementSize(stream);
+    auto shapeBegin = [&](const Shape &shape) -> size_t {
+        return isFace ? shape.range.faceOffset : shape.range.vertexOffset;
+    };
+    auto shapeEnd = [&](const Shape &shape) -> size_t {
+        return isFace ?
+            shape.range.faceOffset + shape.range.faceCount :
+            shape.range.vertexOffset + shape.range.vertexCount;
+    };
+    
+    /// find the first shape that overlaps the page, shapes are sorted by their offsets
+    auto shape = std::upper_bound(m_shapes.begin(), m_shapes.end(), begin, [&](size_t index, const Shape &shape) {
+        return index < shapeEnd(shape);
+    });
+    
+    for (size_t index = begin; index < end; shape++) {
+        assert(shape != m_shapes.end());
+        const size_t local = index - shapeBegin(*shape);
+        const size_t count = std::min(end, shapeEnd(*shape)) - index;
+        char *destination = output + (index - begin) * stride;
+        
+        const rmesh::MeshView &view = shape->view;
+        switch (stream) {
+        case Stream::Vertices: memcpy(destination, view.vertices + local, count * stride); break;
+        case Stream::Normals: memcpy(destination, view.normals + local, count * stride); break;
+        case Stream::TexCoords: memcpy(destination, view.texCoords + local, count * stride); break;
+        case Stream::Indices: memcpy(destination, view.indices + local, count * stride); break;
+        case Stream::Materials: {
+            /// same resolution as `MeshCache`, equal indices in the cached palette belong to the same slot
+            MaterialIndex *materials = reinterpret_cast<MaterialIndex *>(destination);
+            for (size_t i = 0; i < count; i++) {
+                const MaterialIndex cached = view.materials[local + i];
+                size_t slot = 0;
+                while (slot < view.paletteSize && view.palette[slot] != cached) slot++;
+                assert(slot < shape->palette.size() && "shape has fewer materials than when it was cached");
+                materials[i] = shape->palette[slot];
+            }
+            break;
+        }
+        }
+        index += count;
+    }
+}
+
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <bridge/common.hpp>
+#include <io/MappedFile.hpp>
+#include <io/rmesh/RMesh.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace raymond {
+
+/**
+ * Scene geometry that does not need to fit in memory. Shapes stay in their memory mapped `.rmesh` caches and are
+ * copied into fixed-size pages on first access. Pages live in the same global index space as the buffers built by
+ * `ShapeBuilder` (indices are relative to the vertex offset of their shape), and the least recently used pages are
+ * evicted once the resident pages exceed the memory budget.
+ *
+ * Consumers pin whole pages, which stay valid while they are held even if they are evicted meanwhile. Element access
+ * goes through a `Reader`, which keeps the last pages it used pinned so that the hot paths (`bvh::Mesh` during
+ * traversal and `cpu::Scene` during shading) only take the lock of the geometry when they move on to another page.
+ * Pages are loaded outside of the lock, so threads that miss different pages load them concurrently, while threads
+ * that miss the same page wait for the first one to load it. Shapes need to be added before any page is read.
+ *
+ * Pinned pages count against the budget until the last handle is released, and only pages that nobody holds are
+ * evicted. The budget is therefore only exceeded if the pages pinned at the same time do not fit in it by themselves,
+ * which are at most `Reader::SlotCount` pages per reading thread (3 MB per thread for pages of 12 byte elements).
+ */
+class PagedGeometry {
+public:
+    /// Number of elements per page, which is the granularity of loading and eviction
+    static constexpr size_t PageElements = 4096;
+    
+    enum class Stream : uint8_t {
+        Vertices, Normals, TexCoords, Indices, Materials,
+    };
+    
+    /// Location of a shape in the global index space
+    struct ShapeRange {
+        VertexIndex vertexOffset;
+        VertexIndex vertexCount;
+        FaceIndex faceOffset;
+        FaceIndex faceCount;
+    };
+    
+    /// Elements `[first, first + PageElements)` of a stream (fewer for the last page), kept alive by the handle
+    using PinnedPage = std::shared_ptr<const char[]>;
+    
+    /// Cache of pinned pages for one thread, element accessors return by value
+    class Reader {
+    public:
+        /// direct mapped, enough for the three vertices of a few neighboring triangles to hit
+        static constexpr size_t SlotCount = 64;
+        
+        explicit Reader(PagedGeometry &geometry) : m_geometry(geometry) {}
+        
+        Vertex vertex(VertexIndex index) { return get<Vertex>(Stream::Vertices, index); }
+        Normal normal(VertexIndex index) { return get<Normal>(Stream::Normals, index); }
+        TexCoord texCoord(VertexIndex index) { return get<TexCoord>(Stream::TexCoords, index); }
+        IndexTriplet indices(FaceIndex index) { return get<IndexTriplet>(Stream::Indices, index); }
+        MaterialIndex material(FaceIndex index) { return get<MaterialIndex>(Stream::Materials, index); }
+    
+    private:
+        
+        struct Slot {
+            uint64_t key = ~uint64_t(0);
+            PinnedPage page;
+        };
+        
+        template<typename T>
+        T get(Stream stream, size_t index) {
+            const size_t page = index / PageElements;
+            const uint64_t key = pageKey(stream, page);
+            Slot &slot = m_slots[(page * 8 + size_t(stream)) % SlotCount];
+            if (slot.key != key) {
+                slot.page = m_geometry.pin(stream, page);
+                slot.key = key;
+            }
+            return reinterpret_cast<const T *>(slot.page.get())[index % PageElements];
+        }
+        
+        PagedGeometry &m_geometry;
+        Slot m_slots[SlotCount];
+    };
+    
+    explicit PagedGeometry(size_t memoryBudget);
+    PagedGeometry(const PagedGeometry &) = delete;
+    PagedGeometry &operator=(const PagedGeometry &) = delete;
+    
+    /**
+     * Appends a shape from its (already validated) cache file, material indices are resolved through `palette`
+     * in the same way as `MeshCache` does.
+     * @returns false if the cache cannot be mapped
+     */
+    bool addShape(const std::string &cachePath, const MaterialIndex *palette, size_t paletteSize);
+    
+    size_t shapeCount() const { return m_shapes.size(); }
+    const ShapeRange &shape(size_t index) const { return m_shapes[index].range; }
+    
+    /**
+     * @returns the given page, loading it (and evicting others) if it is not resident, or waiting for the thread
+     * that is already loading it
+     */
+    PinnedPage pin(Stream stream, size_t page);
+    
+    /// Reader of the calling thread, which is reused by all accesses of this thread to this geometry
+    Reader &threadReader();
+    
+    size_t memoryBudget() const { return m_memoryBudget; }
+    /// Bytes of all pages in memory, which includes pages that readers still hold after they have been evicted
+    size_t residentBytes() const;
+    /// Number of pages that had to be loaded, including those that were loaded again after eviction
+    size_t pageFaults() const;
+
+private:
+    struct Shape {
+        ShapeRange range;
+        MappedFile file;
+        rmesh::MeshView view;
+        std::vector<MaterialIndex> palette;
+    };
+    
+    struct Page {
+        /// empty while the page is being loaded
+        PinnedPage data;
+        /// only valid once the page is loaded, pages are not evictable before
+        std::list<uint64_t>::iterator lru;
+    };
+    
+    static uint64_t pageKey(Stream stream, size_t page) {
+        return uint64_t(stream) << 56 | uint64_t(page);
+    }
+    
+    void load(Stream stream, size_t page, char *output) const;
+    
+    /// distinguishes geometries in the thread local readers, even if one is allocated where another one used to be
+    const uint64_t m_id;
+    size_t m_memoryBudget;
+    std::vector<Shape> m_shapes;
+    VertexIndex m_vertexCount = 0;
+    FaceIndex m_faceCount = 0;
+    
+    mutable std::mutex m_mutex;
+    /// signaled whenever a page has been loaded
+    std::condition_variable m_loaded;
+    std::unordered_map<uint64_t, Page> m_pages;
+    /// keys of loaded pages in the cache, most recently used first
+    std::list<uint64_t> m_lru;
+    /// bytes of all pages in memory, shared with the pages since readers may release them after the geometry is gone
+    std::shared_ptr<std::atomic<size_t>> m_residentBytes;
+    size_t m_pageFaults = 0;
+};
+
+}
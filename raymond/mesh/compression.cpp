@@ -0,0 +1,137 @@
+extern "C" {
+#include "compression.h"
+}
+
+#include <utils/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+/// Large enough to amortize scheduling
+constexpr size_t ChunkSize = 1 << 16;
+
+template<typename Function>
+void parallelChunks(size_t count, Function function) {
+    const size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    raymond::ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        const size_t begin = chunk * ChunkSize;
+        function(begin, std::min(begin + ChunkSize, count));
+    });
+}
+
+inline float signNotZero(float value) {
+    return value >= 0 ? 1.f : -1.f;
+}
+
+inline float snorm16ToFloat(int16_t value) {
+    return std::max(float(value) / 32767.f, -1.f);
+}
+
+/// Mirrors `decodeOctahedral` in ShadingContext.metal
+void decodeOctahedral(int16_t ex, int16_t ey, float normal[3]) {
+    normal[0] = snorm16ToFloat(ex);
+    normal[1] = snorm16ToFloat(ey);
+    normal[2] = 1 - std::abs(normal[0]) - std::abs(normal[1]);
+    if (normal[2] < 0) {
+        const float x = normal[0];
+        normal[0] = (1 - std::abs(normal[1])) * signNotZero(x);
+        normal[1] = (1 - std::abs(x)) * signNotZero(normal[1]);
+    }
+    
+    const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    for (int i = 0; i < 3; i++) normal[i] /= length;
+}
+
+PackedNormal encodeOctahedral(const Normal &normal) {
+    float n[3] = { normal.x, normal.y, normal.z };
+    const float l1 = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+    if (!(l1 > 0) || !std::isfinite(l1)) {
+        n[0] = n[1] = 0;
+        n[2] = 1;
+    } else {
+        for (int i = 0; i < 3; i++) n[i] /= l1;
+    }
+    
+    float e[2] = { n[0], n[1] };
+    if (n[2] < 0) {
+        /// fold the lower hemisphere over the diagonals
+        e[0] = (1 - std::abs(n[1])) * signNotZero(n[0]);
+        e[1] = (1 - std::abs(n[0])) * signNotZero(n[1]);
+    }
+    
+    /// try all four roundings and keep the one that decodes closest to the original direction
+    const float scaled[2] = { std::clamp(e[0], -1.f, 1.f) * 32767, std::clamp(e[1], -1.f, 1.f) * 32767 };
+    int16_t best[2] = { 0, 0 };
+    float bestDot = -INFINITY;
+    for (int candidate = 0; candidate < 4; candidate++) {
+        const int16_t q[2] = {
+            int16_t(candidate & 1 ? std::ceil(scaled[0]) : std::floor(scaled[0])),
+            int16_t(candidate & 2 ? std::ceil(scaled[1]) : std::floor(scaled[1])),
+        };
+        
+        float decoded[3];
+        decodeOctahedral(q[0], q[1], decoded);
+        const float dot = decoded[0] * n[0] + decoded[1] * n[1] + decoded[2] * n[2];
+        if (dot > bestDot) {
+            bestDot = dot;
+            best[0] = q[0];
+            best[1] = q[1];
+        }
+    }
+    
+    /// same layout as `pack_float_to_snorm2x16` in Metal, with x in the low bits
+    return PackedNormal(uint16_t(best[0])) | (PackedNormal(uint16_t(best[1])) << 16);
+}
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+    
+    if (magnitude >= 0x7F800000) {
+        /// infinity stays infinity, NaN stays (quiet) NaN
+        return uint16_t(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+    }
+    if (magnitude >= 0x477FF000) {
+        /// rounds to a value beyond the largest finite half
+        return uint16_t(sign | 0x7C00);
+    }
+    if (magnitude < 0x38800000) {
+        /// subnormal half: add the implicit one and shift into place, rounding to nearest even
+        if (magnitude < 0x33000000) return uint16_t(sign);
+        const uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        const int shift = 126 - int(magnitude >> 23);
+        const uint32_t halfway = 1u << (shift - 1);
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t result = mantissa >> shift;
+        if (rest > halfway || (rest == halfway && (result & 1))) result++;
+        return uint16_t(sign | result);
+    }
+    
+    /// normal half: rebias the exponent and round the mantissa to 10 bits
+    uint32_t result = magnitude - 0x38000000;
+    result += 0xFFF + ((result >> 13) & 1);
+    return uint16_t(sign | (result >> 13));
+}
+
+}
+
+void compress_normals(const Normal *normals, PackedNormal *output, uint32_t count) {
+    parallelChunks(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) output[i] = encodeOctahedral(normals[i]);
+    });
+}
+
+void compress_texcoords(const TexCoord *texCoords, PackedTexCoord *output, uint32_t count) {
+    parallelChunks(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            output[i].x = floatToHalf(texCoords[i].x);
+            output[i].y = floatToHalf(texCoords[i].y);
+        }
+    });
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include "../bridge/common.hpp"
+
+/**
+ * Encodes unit normals with the octahedral mapping into two snorm16 values, picking the rounding that minimizes
+ * the angular error (well below 0.01 degrees).
+ */
+void compress_normals(const Normal *normals, PackedNormal *output, uint32_t count);
+
+/**
+ * Converts texture coordinates to half precision (round to nearest even). Note that this leaves 11 bits of precision,
+ * i.e. coordinates in [0.5, 1) are off by up to 1/4096, which is visible on very high resolution textures.
+ */
+void compress_texcoords(const TexCoord *texCoords, PackedTexCoord *output, uint32_t count);
@@ -0,0 +1,21 @@
+extern "C" {
+#include "hashing.h"
+}
+
+#include <utils/Hash.hpp>
+
+uint64_t hash_mesh(
+    const Vertex *vertices, const void *normals, size_t normalStride,
+    const void *texCoords, size_t texCoordStride, uint32_t vertexCount,
+    const IndexTriplet *indices, const MaterialIndex *materials, uint32_t faceCount
+) {
+    /// counts are mixed in first so that a shape cannot collide with a prefix of another
+    const uint64_t counts = uint64_t(vertexCount) << 32 | faceCount;
+    uint64_t hash = raymond::hash64(&counts, sizeof(counts));
+    hash = raymond::hash64(vertices, sizeof(Vertex) * vertexCount, hash);
+    hash = raymond::hash64(normals, normalStride * vertexCount, hash);
+    hash = raymond::hash64(texCoords, texCoordStride * vertexCount, hash);
+    hash = raymond::hash64(indices, sizeof(IndexTriplet) * faceCount, hash);
+    hash = raymond::hash64(materials, sizeof(MaterialIndex) * faceCount, hash);
+    return hash;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../bridge/common.hpp"
+
+/**
+ * Hashes the contents of a shape as stored in the scene buffers, so that shapes with identical geometry and materials
+ * can be found regardless of which file they came from. Normals and texture coordinates are hashed as raw bytes,
+ * since their element size depends on whether compact vertex attributes are used.
+ */
+uint64_t hash_mesh(
+    const Vertex *vertices, const void *normals, size_t normalStride,
+    const void *texCoords, size_t texCoordStride, uint32_t vertexCount,
+    const IndexTriplet *indices, const MaterialIndex *materials, uint32_t faceCount);
@@ -0,0 +1,146 @@
+extern "C" {
+#include "optimize.h"
+}
+
+#include <utils/Hash.hpp>
+#include <utils/Morton.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t Unassigned = UINT32_MAX;
+
+/// The attributes that make up the identity of a vertex
+struct VertexKey {
+    float values[8];
+    
+    VertexKey(const Vertex &vertex, const Normal &normal, const TexCoord &texCoord)
+        : values { vertex.x, vertex.y, vertex.z, normal.x, normal.y, normal.z, texCoord.x, texCoord.y } {}
+    
+    bool operator==(const VertexKey &other) const {
+        return std::memcmp(values, other.values, sizeof(values)) == 0;
+    }
+};
+
+/**
+ * Maps every vertex to the first vertex with identical attributes, using an open addressing hash table.
+ * @returns for every vertex the index of its representative
+ */
+std::vector<uint32_t> weldVertices(
+    const Vertex *vertices, const Normal *normals, const TexCoord *texCoords, uint32_t vertexCount
+) {
+    size_t tableSize = 16;
+    while (tableSize < 2 * size_t(vertexCount)) tableSize *= 2;
+    std::vector<uint32_t> table(tableSize, Unassigned);
+    
+    std::vector<uint32_t> representative(vertexCount);
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        const VertexKey key { vertices[i], normals[i], texCoords[i] };
+        size_t slot = raymond::hash64(key.values, sizeof(key.values)) & (tableSize - 1);
+        
+        while (true) {
+            const uint32_t candidate = table[slot];
+            if (candidate == Unassigned) {
+                table[slot] = i;
+                representative[i] = i;
+                break;
+            }
+            
+            if (VertexKey { vertices[candidate], normals[candidate], texCoords[candidate] } == key) {
+                representative[i] = candidate;
+                break;
+            }
+            
+            slot = (slot + 1) & (tableSize - 1);
+        }
+    }
+    return representative;
+}
+
+/** @returns the order in which faces should be stored, following a Morton curve through their centroids */
+std::vector<uint32_t> sortFaces(const Vertex *vertices, const IndexTriplet *indices, uint32_t faceCount) {
+    std::vector<float> centroids(3 * size_t(faceCount));
+    float boundsMin[3] = { +INFINITY, +INFINITY, +INFINITY };
+    float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (uint32_t face = 0; face < faceCount; face++) {
+        for (int dim = 0; dim < 3; dim++) {
+            const float centroid = (
+                vertices[indices[face].x].elements[dim] +
+                vertices[indices[face].y].elements[dim] +
+                vertices[indices[face].z].elements[dim]) / 3;
+            centroids[3 * face + dim] = centroid;
+            boundsMin[dim] = std::fmin(boundsMin[dim], centroid);
+            boundsMax[dim] = std::fmax(boundsMax[dim], centroid);
+        }
+    }
+    
+    std::vector<uint64_t> keys(faceCount);
+    for (uint32_t face = 0; face < faceCount; face++) {
+        uint32_t cell[3];
+        for (int dim = 0; dim < 3; dim++) {
+            const float extent = boundsMax[dim] - boundsMin[dim];
+            const float relative = extent > 0 ? (centroids[3 * face + dim] - boundsMin[dim]) / extent : 0;
+            /// NaN positions end up in cell zero
+            cell[dim] = uint32_t(std::clamp(relative * 1024, 0.f, 1023.f));
+        }
+        const uint32_t code = raymond::morton::encode(cell[0], cell[1], cell[2]);
+        
+        /// the face index in the lower bits makes the sort stable
+        keys[face] = (uint64_t(code) << 32) | face;
+    }
+    
+    std::sort(keys.begin(), keys.end());
+    
+    std::vector<uint32_t> order(faceCount);
+    for (uint32_t i = 0; i < faceCount; i++) order[i] = uint32_t(keys[i]);
+    return order;
+}
+
+template<typename T>
+void gather(T *array, const std::vector<uint32_t> &sources) {
+    std::vector<T> copy(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) copy[i] = array[sources[i]];
+    std::copy(copy.begin(), copy.end(), array);
+}
+
+}
+
+uint32_t optimize_mesh(
+    Vertex *vertices, Normal *normals, TexCoord *texCoords, uint32_t vertexCount,
+    IndexTriplet *indices, MaterialIndex *materials, uint32_t faceCount
+) {
+    const std::vector<uint32_t> representative = weldVertices(vertices, normals, texCoords, vertexCount);
+    for (uint32_t face = 0; face < faceCount; face++) {
+        for (int corner = 0; corner < 3; corner++) {
+            indices[face].elements[corner] = representative[indices[face].elements[corner]];
+        }
+    }
+    
+    const std::vector<uint32_t> faceOrder = sortFaces(vertices, indices, faceCount);
+    gather(indices, faceOrder);
+    gather(materials, faceOrder);
+    
+    /// renumber vertices by first use, which also drops the welded and unreferenced ones
+    std::vector<uint32_t> newIndex(vertexCount, Unassigned);
+    std::vector<uint32_t> vertexOrder;
+    vertexOrder.reserve(vertexCount);
+    for (uint32_t face = 0; face < faceCount; face++) {
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t &index = indices[face].elements[corner];
+            if (newIndex[index] == Unassigned) {
+                newIndex[index] = uint32_t(vertexOrder.size());
+                vertexOrder.push_back(index);
+            }
+            index = newIndex[index];
+        }
+    }
+    
+    gather(vertices, vertexOrder);
+    gather(normals, vertexOrder);
+    gather(texCoords, vertexOrder);
+    return uint32_t(vertexOrder.size());
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include "../bridge/common.hpp"
+
+/**
+ * Improves the memory locality of a shape in place, which makes the vertex gathers of shading far more coherent:
+ *  1. vertices with bitwise identical position, normal and texture coordinate are welded,
+ *  2. faces are sorted along a Morton curve through their centroids (materials are permuted along with them),
+ *  3. vertices are renumbered in the order in which the sorted faces first use them.
+ * Vertices that are not referenced by any face are dropped.
+ * @returns the new number of vertices, which occupy the front of the vertex arrays
+ */
+uint32_t optimize_mesh(
+    Vertex *vertices, Normal *normals, TexCoord *texCoords, uint32_t vertexCount,
+    IndexTriplet *indices, MaterialIndex *materials, uint32_t faceCount);
@@ -0,0 +1,98 @@
+#include "Hash.hpp"
+
+#include <cstring>
+
+namespace raymond {
+
+namespace {
+
+constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t Prime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t read64(const uint8_t *data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint32_t read32(const uint8_t *data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint64_t round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * Prime2;
+    return rotl(accumulator, 31) * Prime1;
+}
+
+inline uint64_t mergeRound(uint64_t accumulator, uint64_t value) {
+    accumulator ^= round(0, value);
+    return accumulator * Prime1 + Prime4;
+}
+
+}
+
+uint64_t hash64(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *head = (const uint8_t *)data;
+    const uint8_t *const end = head + size;
+    uint64_t hash;
+    
+    if (size >= 32) {
+        /// four independent lanes keep the multipliers busy
+        uint64_t v1 = seed + Prime1 + Prime2;
+        uint64_t v2 = seed + Prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - Prime1;
+        
+        for (; end - head >= 32; head += 32) {
+            v1 = round(v1, read64(head + 0));
+            v2 = round(v2, read64(head + 8));
+            v3 = round(v3, read64(head + 16));
+            v4 = round(v4, read64(head + 24));
+        }
+        
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + Prime5;
+    }
+    
+    hash += uint64_t(size);
+    
+    for (; end - head >= 8; head += 8) {
+        hash ^= round(0, read64(head));
+        hash = rotl(hash, 27) * Prime1 + Prime4;
+    }
+    
+    if (end - head >= 4) {
+        hash ^= uint64_t(read32(head)) * Prime1;
+        hash = rotl(hash, 23) * Prime2 + Prime3;
+        head += 4;
+    }
+    
+    for (; head < end; head++) {
+        hash ^= (*head) * Prime5;
+        hash = rotl(hash, 11) * Prime1;
+    }
+    
+    /// avalanche
+    hash ^= hash >> 33;
+    hash *= Prime2;
+    hash ^= hash >> 29;
+    hash *= Prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+}
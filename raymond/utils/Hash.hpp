@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace raymond {
+
+/**
+ * Fast non-cryptographic 64-bit hash of a block of memory (XXH64), used to detect whether file contents changed.
+ * @returns the same value as the reference implementation of XXH64 for the given seed
+ */
+uint64_t hash64(const void *data, size_t size, uint64_t seed = 0);
+
+}
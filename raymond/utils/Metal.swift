@@ -30,12 +30,19 @@ extension MTLDevice {
 }
 
 extension MTLBuffer {
+    /// Copies the first `length` bytes into a new buffer, which releases the slack of conservatively sized buffers
+    func trimmed(to length: Int) -> MTLBuffer {
+        let buffer = device.makeBuffer(bytes: contents(), length: max(length, 1), options: resourceOptions)!
+        buffer.label = label
+        return buffer
+    }
+    
     func toArray<T>(type: T.Type) -> Array<T> {
         let elementCount = self.length / MemoryLayout<T>.stride
         let data = self.contents().bindMemory(to: type, capacity: elementCount)
         return (0..<elementCount).map { data[$0] }
     }
-
+    
     func saveBinary(at url: URL) throws {
         let data = Data(bytesNoCopy: contents(), count: length, deallocator: .none)
         try data.write(to: url)
@@ -0,0 +1,55 @@
+#include "Morton.hpp"
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace raymond::morton {
+
+namespace {
+
+/// keys per task, few enough tasks that the per-chunk histograms stay small
+constexpr size_t ChunkSize = 1 << 14;
+
+constexpr int RadixBits = 8;
+constexpr int RadixSize = 1 << RadixBits;
+
+}
+
+void sortKeys(std::vector<uint64_t> &keys, std::vector<uint64_t> &buffer, size_t count) {
+    const size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    std::vector<std::array<uint32_t, RadixSize>> offsets(chunkCount);
+    
+    for (int shift = 32; shift < 64; shift += RadixBits) {
+        ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+            std::array<uint32_t, RadixSize> &histogram = offsets[chunk];
+            histogram.fill(0);
+            const size_t end = std::min(count, (chunk + 1) * ChunkSize);
+            for (size_t i = chunk * ChunkSize; i < end; i++) histogram[keys[i] >> shift & (RadixSize - 1)]++;
+        });
+        
+        uint32_t sum = 0;
+        bool isUniform = false;
+        for (int digit = 0; digit < RadixSize; digit++) {
+            uint32_t digitCount = 0;
+            for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+                const uint32_t size = offsets[chunk][digit];
+                offsets[chunk][digit] = sum;
+                sum += size;
+                digitCount += size;
+            }
+            if (digitCount == count) isUniform = true;
+        }
+        if (isUniform) continue;
+        
+        ThreadPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+            std::array<uint32_t, RadixSize> &offset = offsets[chunk];
+            const size_t end = std::min(count, (chunk + 1) * ChunkSize);
+            for (size_t i = chunk * ChunkSize; i < end; i++) buffer[offset[keys[i] >> shift & (RadixSize - 1)]++] = keys[i];
+        });
+        keys.swap(buffer);
+    }
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Morton codes and the radix sort that orders keys by them, shared by `buildLbvh` and `sortByOriginAndDirection`
+namespace raymond::morton {
+
+/** @returns the bits of `value` (at most 10) interleaved with two zero bits each */
+inline uint32_t spreadBits3(uint32_t value) {
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+/** @returns the bits of `value` (at most 16) interleaved with one zero bit each */
+inline uint32_t spreadBits2(uint32_t value) {
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
+
+/** @returns 30 bit Morton code of a cell in a grid of at most 1024^3 cells */
+inline uint32_t encode(uint32_t x, uint32_t y, uint32_t z) {
+    return spreadBits3(x) << 2 | spreadBits3(y) << 1 | spreadBits3(z);
+}
+
+/**
+ * Sorts the first `count` keys by their upper 32 bits (the code) with a least significant digit radix sort on
+ * `ThreadPool::shared()`. Every pass histograms chunks in parallel and scatters them to offsets from a prefix sum over
+ * all chunks, which keeps the sort stable. Passes whose digit is the same for all keys would not change the order and
+ * are skipped. `buffer` needs to hold at least `count` keys and is swapped with `keys` by every pass.
+ */
+void sortKeys(std::vector<uint64_t> &keys, std::vector<uint64_t> &buffer, size_t count);
+
+}
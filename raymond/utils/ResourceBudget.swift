@@ -0,0 +1,36 @@
+import Foundation
+
+/// Limits how much of a resource (such as open files or bytes of memory) concurrent tasks may hold at once.
+/// A request that exceeds the whole capacity is granted once nothing else is held, so oversized tasks still run.
+final class ResourceBudget {
+    let capacity: Int
+    private var used = 0
+    private let condition = NSCondition()
+    
+    init(capacity: Int) {
+        self.capacity = max(capacity, 1)
+    }
+    
+    func acquire(_ amount: Int) {
+        condition.lock()
+        while used > 0 && used + amount > capacity {
+            condition.wait()
+        }
+        used += amount
+        condition.unlock()
+    }
+    
+    func release(_ amount: Int) {
+        condition.lock()
+        used -= amount
+        condition.broadcast()
+        condition.unlock()
+    }
+    
+    /// Holds `amount` of the resource for the duration of `body`
+    func using<T>(_ amount: Int, _ body: () throws -> T) rethrows -> T {
+        acquire(amount)
+        defer { release(amount) }
+        return try body()
+    }
+}
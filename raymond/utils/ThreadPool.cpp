@@ -0,0 +1,178 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace raymond {
+
+namespace {
+
+/// Pool and deque of the current thread, only set for workers
+thread_local const ThreadPool *t_pool = nullptr;
+thread_local size_t t_queue = 0;
+
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    /// the thread calling `parallelFor` participates as well
+    threadCount = std::max(threadCount, 1u);
+    for (unsigned int i = 0; i < threadCount; i++) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned int i = 1; i < threadCount; i++) {
+        m_workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_shutdown = true;
+    }
+    m_wakeUp.notify_all();
+    
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::queueIndex() const {
+    return t_pool == this ? t_queue : 0;
+}
+
+void ThreadPool::push(size_t queue, const Range &range) {
+    /// counted before the range becomes visible, so that taking it can never make the counters wrap around
+    range.job->queued.fetch_add(1);
+    m_queuedRanges.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+        m_queues[queue]->ranges.push_back(range);
+    }
+    
+    /// sleepers register before checking for work, so either they see this range or we see them
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wakeUp.notify_all();
+    }
+}
+
+bool ThreadPool::pop(size_t queue, const Job *job, Range &range) {
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+        auto &ranges = m_queues[queue]->ranges;
+        if (ranges.empty() || (job && ranges.back().job != job)) return false;
+        
+        range = ranges.back();
+        ranges.pop_back();
+    }
+    range.job->queued.fetch_sub(1);
+    m_queuedRanges.fetch_sub(1);
+    return true;
+}
+
+bool ThreadPool::steal(size_t thief, const Job *job, Range &range) {
+    for (size_t offset = 1; offset <= m_queues.size(); offset++) {
+        /// threads outside of the pool share a deque, so the thief's own deque is checked last
+        Queue &victim = *m_queues[(thief + offset) % m_queues.size()];
+        
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            auto it = job ?
+                std::find_if(victim.ranges.begin(), victim.ranges.end(), [job](const Range &r) { return r.job == job; }) :
+                victim.ranges.begin();
+            if (it == victim.ranges.end()) continue;
+            
+            range = *it;
+            victim.ranges.erase(it);
+        }
+        range.job->queued.fetch_sub(1);
+        m_queuedRanges.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(size_t queue, Range range) {
+    Job &job = *range.job;
+    
+    /// the lower half stays with this thread, the upper halves wait in our deque in case another thread runs dry
+    while (range.end - range.begin > job.grainSize) {
+        const size_t middle = range.begin + (range.end - range.begin) / 2;
+        push(queue, { &job, middle, range.end });
+        range.end = middle;
+    }
+    
+    (*job.body)(range.begin, range.end);
+    
+    const size_t size = range.end - range.begin;
+    if (job.remaining.fetch_sub(size) == size) {
+        /// the submitting thread might be sleeping while the last ranges were in flight
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wakeUp.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(size_t queue) {
+    t_pool = this;
+    t_queue = queue;
+    
+    while (true) {
+        Range range;
+        if (pop(queue, nullptr, range) || steal(queue, nullptr, range)) {
+            execute(queue, range);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1);
+        m_wakeUp.wait(lock, [this]() { return m_shutdown || m_queuedRanges.load() > 0; });
+        m_sleeping.fetch_sub(1);
+        if (m_shutdown) return;
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void (size_t)> &body) {
+    parallelForRange(count, 1, [&body](size_t begin, size_t end) {
+        for (size_t index = begin; index < end; index++) body(index);
+    });
+}
+
+void ThreadPool::parallelForRange(
+    size_t count, size_t grainSize, const std::function<void (size_t begin, size_t end)> &body
+) {
+    if (count == 0) return;
+    grainSize = std::max<size_t>(grainSize, 1);
+    if (count <= grainSize || m_workers.empty()) {
+        for (size_t begin = 0; begin < count; begin += grainSize) body(begin, std::min(count, begin + grainSize));
+        return;
+    }
+    
+    Job job;
+    job.body = &body;
+    job.grainSize = grainSize;
+    job.remaining = count;
+    
+    const size_t queue = queueIndex();
+    execute(queue, { &job, 0, count });
+    
+    /// only help with ranges of this job: a range of an unrelated job could block (e.g. on a `ResourceBudget`) and
+    /// would keep this loop from returning long after its own work is done
+    while (job.remaining.load() > 0) {
+        Range range;
+        if (pop(queue, &job, range) || steal(queue, &job, range)) {
+            execute(queue, range);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1);
+        m_wakeUp.wait(lock, [&job]() { return job.remaining.load() == 0 || job.queued.load() > 0; });
+        m_sleeping.fetch_sub(1);
+    }
+}
+
+}
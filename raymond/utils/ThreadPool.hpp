@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace raymond {
+
+/// Fixed set of worker threads that execute data parallel loops with work stealing.
+/// Loops are split into ranges that live in per-thread deques: the owner of a deque takes the most recently split
+/// (smallest) range from the back, idle threads steal the oldest (largest) range from the front of another deque.
+/// Loops can be submitted from any thread (including workers, which is how nested loops such as subtree builds stay
+/// on the same threads instead of oversubscribing the machine), the submitting thread helps out until its loop is done.
+class ThreadPool {
+public:
+    /// Pool shared by all loaders and the CPU renderer, sized to the number of hardware threads
+    static ThreadPool &shared();
+    
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+    
+    /// Calls `body(index)` for every index in `[0, count)` and returns once all calls have completed.
+    void parallelFor(size_t count, const std::function<void (size_t)> &body);
+    
+    /// Calls `body(begin, end)` for disjoint ranges that cover `[0, count)`, each at most `grainSize` long, and returns
+    /// once all calls have completed. Ranges are only split as far as needed, so the number of calls adapts to `count`.
+    void parallelForRange(size_t count, size_t grainSize, const std::function<void (size_t begin, size_t end)> &body);
+    
+    /// Number of threads that can work on a loop, including the submitting thread
+    unsigned int concurrency() const { return unsigned(m_workers.size()) + 1; }
+
+private:
+    struct Job {
+        const std::function<void (size_t, size_t)> *body;
+        size_t grainSize;
+        /// indices that have not completed yet
+        std::atomic<size_t> remaining;
+        /// ranges of this job that sit in a deque, lets waiting threads sleep while the rest of the job is in flight
+        std::atomic<size_t> queued { 0 };
+    };
+    
+    /// Indices `[begin, end)` of a job that no thread has started yet
+    struct Range {
+        Job *job;
+        size_t begin;
+        size_t end;
+    };
+    
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+    
+    /// Deque of the calling thread, threads outside of the pool share the first one
+    size_t queueIndex() const;
+    
+    void push(size_t queue, const Range &range);
+    /// Takes the back of `queue` if it belongs to `job` (or any job if `job` is null)
+    bool pop(size_t queue, const Job *job, Range &range);
+    /// Takes the oldest range from another deque that belongs to `job` (or any job if `job` is null)
+    bool steal(size_t thief, const Job *job, Range &range);
+    /// Splits the range in halves until it fits the grain size (pushing the upper halves) and runs what is left
+    void execute(size_t queue, Range range);
+    void workerLoop(size_t queue);
+    
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    
+    /// ranges in all deques, idle workers sleep while there are none
+    std::atomic<size_t> m_queuedRanges { 0 };
+    /// threads blocked on `m_wakeUp`, pushes only need to notify while this is non-zero
+    std::atomic<unsigned int> m_sleeping { 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+    bool m_shutdown = false;
+};
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#import <Foundation/Foundation.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Calls `body(index)` for every index in `[0, count)` on `raymond::ThreadPool::shared()` and returns once all calls
+ * have completed. Use this instead of `DispatchQueue.concurrentPerform` in the scene build, so that loops which run
+ * C++ loaders (PLY parsing, BVH builds) nest into the same threads instead of adding a pool on top of GCD.
+ */
+void parallel_for(NSInteger count, void (NS_NOESCAPE ^ _Nonnull body)(NSInteger index));
+
+#ifdef __cplusplus
+}
+#endif
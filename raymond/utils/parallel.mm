@@ -0,0 +1,9 @@
+#include "parallel.h"
+#include "ThreadPool.hpp"
+
+void parallel_for(NSInteger count, void (NS_NOESCAPE ^body)(NSInteger index)) {
+    if (count <= 0) return;
+    raymond::ThreadPool::shared().parallelFor(size_t(count), [body](size_t index) {
+        body(NSInteger(index));
+    });
+}
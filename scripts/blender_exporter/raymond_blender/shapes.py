@@ -39,7 +39,25 @@ def _write_ascii(fw, ply_verts: list, ply_faces: list) -> None:
         fw(b"\n")
 
 
-def ply_save(filepath, bm: bmesh.types.BMesh, auto_smooth: float):
+def _write_binary(fw, ply_verts: list, ply_faces: list) -> None:
+    from struct import Struct
+
+    # Vertex data
+    # ---------------------------
+
+    vertex_record = Struct("<8f")
+    for v, normal, uv in ply_verts:
+        fw(vertex_record.pack(*v.co[:], *normal[:], *uv))
+
+    # Face data
+    # ---------------------------
+
+    face_record = Struct("<B3IB")
+    for (mat_id,pf) in ply_faces:
+        fw(face_record.pack(len(pf), *pf, mat_id))
+
+
+def ply_save(filepath, bm: bmesh.types.BMesh, auto_smooth: float, use_ascii: bool = False):
     uv_lay = bm.loops.layers.uv.active
 
     normal = uv = None
@@ -93,7 +111,7 @@ def ply_save(filepath, bm: bmesh.types.BMesh, auto_smooth: float):
 
     with open(filepath, "wb") as file:
         fw = file.write
-        file_format = b"ascii"
+        file_format = b"ascii" if use_ascii else b"binary_little_endian"
 
         # Header
         # ---------------------------
@@ -126,7 +144,10 @@ def ply_save(filepath, bm: bmesh.types.BMesh, auto_smooth: float):
         # Geometry
         # ---------------------------
 
-        _write_ascii(fw, ply_verts, ply_faces)
+        if use_ascii:
+            _write_ascii(fw, ply_verts, ply_faces)
+        else:
+            _write_binary(fw, ply_verts, ply_faces)
 
 
 # The following "solidification" does not work due to: